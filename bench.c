@@ -0,0 +1,458 @@
+/**
+* bench.c
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This tool times the data structures the simulator spends its cycles in: the FIFO queue,
+* the priority queue and its starvation check, creating and freeing pcbs, and mutexes and
+* conditional variables with waiting pcbs. Every benchmark runs with several numbers of
+* pcbs in the structure, each repetition runs the same operations from the same state, and
+* the median repetition is reported in ns and allocations per operation:
+*
+*    bench [-n populations] [-i operations] [-r repetitions] [-o json_file] [-b baseline_file]
+*
+* -n takes a comma separated list of numbers of pcbs (default 16,256,4096,65536), -i the
+* operations per repetition (default 1000000) and -r the repetitions (default 5). -o writes
+* the results as JSON, one benchmark per line in a fixed order, and -b reads such a file
+* and prints how much faster every benchmark got since it was written.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "pcb.h"
+#include "queue.h"
+#include "priority_queue.h"
+#include "syn.h"
+
+#define BENCH_MAX_POPULATIONS 16 // max number of populations a run can have
+#define BENCH_MAX_REPETITIONS 101 // max number of repetitions of every benchmark
+#define BENCH_MAX_RESULTS 256 // max number of results a baseline file can have
+#define BENCH_STARVATION_TIME 16 // starvation time of the priority queue of the starvation benchmark
+
+// the allocator of the C library, which the counting versions below pass every call on to
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+extern void __libc_free(void *pointer);
+
+uint64_t allocations; // number of malloc, calloc and realloc calls so far
+
+// This defines the structures a benchmark works on, a benchmark only uses some of them
+typedef struct {
+    PCB_Ptr *pcbs; // population pcbs, all in the structure the benchmark works on
+    int population;
+    Queue_Ptr queue;
+    PriorityQueue_Ptr priorityQueue;
+    Mutex mutex;
+    CondVar condVar;
+    long next; // index of the next pcb the pcb benchmark replaces
+} BenchState;
+
+// This defines a benchmark, setup() puts the pcbs of state into the structure and
+// run() does the given number of operations on it
+typedef struct {
+    const char *name;
+    void (*setup)(BenchState *state);
+    void (*run)(BenchState *state, long operations);
+    void (*teardown)(BenchState *state);
+} Benchmark;
+
+// This defines the result of one benchmark with one population
+typedef struct {
+    char name[64];
+    int population;
+    long operations;
+    double nsPerOp;
+    double allocationsPerOp;
+} BenchResult;
+
+void *malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    allocations++;
+    return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer) {
+    __libc_free(pointer);
+}
+
+/**
+* This returns the time of a monotonic clock in ns
+*/
+uint64_t nowNs(void);
+
+/**
+* This parses a comma separated list of at most BENCH_MAX_POPULATIONS positive numbers
+* into populations, returns their number or 0 when the list isn't valid
+*/
+int parsePopulations(const char *list, int *populations);
+
+/**
+* This reads the results of a JSON file written by -o into results, returns their number
+* or -1 when the file can't be read
+*/
+int readBaseline(const char *fileName, BenchResult *results);
+
+/**
+* This runs one benchmark with one population and fills result with its median repetition
+*/
+void measure(const Benchmark *benchmark, int population, long operations, int repetitions, BenchResult *result);
+
+/**
+* This compares doubles for qsort()
+*/
+int compareDoubles(const void *one, const void *two);
+
+void queueSetup(BenchState *state);
+void queueRun(BenchState *state, long operations);
+void queueTeardown(BenchState *state);
+void priorityQueueSetup(BenchState *state);
+void starvationSetup(BenchState *state);
+void priorityQueueRun(BenchState *state, long operations);
+void starvationRun(BenchState *state, long operations);
+void priorityQueueTeardown(BenchState *state);
+void pcbSetup(BenchState *state);
+void pcbRun(BenchState *state, long operations);
+void pcbTeardown(BenchState *state);
+void mutexSetup(BenchState *state);
+void mutexRun(BenchState *state, long operations);
+void mutexTeardown(BenchState *state);
+void condVarSetup(BenchState *state);
+void condVarRun(BenchState *state, long operations);
+void condVarTeardown(BenchState *state);
+
+// all benchmarks, in the order they are run and reported
+const Benchmark benchmarks[] = {
+    // a dequeue and an enqueue of the same pcb, as when a pcb is dispatched and preempted
+    {"queue_dequeue_enqueue", queueSetup, queueRun, queueTeardown},
+    // the same on a priority queue holding pcbs of every priority
+    {"priority_queue_dequeue_enqueue", priorityQueueSetup, priorityQueueRun, priorityQueueTeardown},
+    // a starvation check per cycle plus a dequeue and an enqueue, heads get promoted every 16 checks
+    {"priority_queue_prevent_starvation", starvationSetup, starvationRun, priorityQueueTeardown},
+    // freeing the oldest of the pcbs and creating a new one
+    {"pcb_destructor_constructor", pcbSetup, pcbRun, pcbTeardown},
+    // the owner unlocking a mutex the other pcbs wait for and locking it again behind them
+    {"mutex_unlock_lock", mutexSetup, mutexRun, mutexTeardown},
+    // signaling a conditional variable the pcbs wait on, and the woken pcb waiting again
+    {"condvar_signal_wait", condVarSetup, condVarRun, condVarTeardown}
+};
+
+uint64_t nowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void queueSetup(BenchState *state) {
+    int i;
+    state->queue = Queue_constructor();
+
+    for (i = 0; i < state->population; i++) {
+        Queue_enqueue(state->queue, state->pcbs[i]);
+    }
+}
+
+void queueRun(BenchState *state, long operations) {
+    long i;
+
+    for (i = 0; i < operations; i++) {
+        Queue_enqueue(state->queue, Queue_dequeue(state->queue));
+    }
+}
+
+void queueTeardown(BenchState *state) {
+    Queue_destructor(state->queue);
+}
+
+void priorityQueueSetup(BenchState *state) {
+    int i;
+    state->priorityQueue = PriorityQueue_constructor(PRIORITY_LEVELS, STARVATION_TIME);
+
+    for (i = 0; i < state->population; i++) {
+        PriorityQueue_enqueue(state->priorityQueue, state->pcbs[i]);
+    }
+}
+
+void starvationSetup(BenchState *state) {
+    priorityQueueSetup(state);
+    PriorityQueue_setStarvationTime(state->priorityQueue, BENCH_STARVATION_TIME);
+}
+
+void priorityQueueRun(BenchState *state, long operations) {
+    long i;
+
+    for (i = 0; i < operations; i++) {
+        PriorityQueue_enqueue(state->priorityQueue, PriorityQueue_dequeue(state->priorityQueue));
+    }
+}
+
+void starvationRun(BenchState *state, long operations) {
+    long i;
+
+    for (i = 0; i < operations; i++) {
+        PriorityQueue_preventStarvation(state->priorityQueue);
+        PriorityQueue_enqueue(state->priorityQueue, PriorityQueue_dequeue(state->priorityQueue));
+    }
+}
+
+void priorityQueueTeardown(BenchState *state) {
+    PriorityQueue_destructor(state->priorityQueue);
+}
+
+void pcbSetup(BenchState *state) {
+    state->next = 0;
+}
+
+void pcbRun(BenchState *state, long operations) {
+    long i;
+
+    for (i = 0; i < operations; i++) {
+        PCB_destructor(state->pcbs[state->next]);
+        state->pcbs[state->next] = PCB_constructor(Compute);
+        state->next = (state->next + 1) % state->population;
+    }
+}
+
+void pcbTeardown(BenchState *state) {
+    // the pcbs are freed by the caller after every benchmark
+    (void) state;
+}
+
+void mutexSetup(BenchState *state) {
+    int i;
+    Mutex_init(&state->mutex);
+
+    for (i = 0; i < state->population; i++) {
+        Mutex_lock(&state->mutex, state->pcbs[i]);
+    }
+}
+
+void mutexRun(BenchState *state, long operations) {
+    PCB_Ptr owner;
+    long i;
+
+    for (i = 0; i < operations; i++) {
+        owner = state->mutex.curPCB;
+        Mutex_unlock(&state->mutex);
+        Mutex_lock(&state->mutex, owner);
+    }
+}
+
+void mutexTeardown(BenchState *state) {
+    Mutex_destroy(&state->mutex);
+}
+
+void condVarSetup(BenchState *state) {
+    int i;
+    Mutex_init(&state->mutex);
+    CondVar_init(&state->condVar);
+
+    for (i = 0; i < state->population; i++) {
+        Mutex_lock(&state->mutex, state->pcbs[i]);
+        CondVar_wait(&state->condVar, &state->mutex);
+    }
+}
+
+void condVarRun(BenchState *state, long operations) {
+    long i;
+
+    // the mutex is free between operations, so the signaled pcb always gets it
+    for (i = 0; i < operations; i++) {
+        CondVar_signal(&state->condVar);
+        CondVar_wait(&state->condVar, &state->mutex);
+    }
+}
+
+void condVarTeardown(BenchState *state) {
+    CondVar_destroy(&state->condVar);
+    Mutex_destroy(&state->mutex);
+}
+
+int compareDoubles(const void *one, const void *two) {
+    double first = *(const double *) one, second = *(const double *) two;
+    return (first > second) - (first < second);
+}
+
+void measure(const Benchmark *benchmark, int population, long operations, int repetitions, BenchResult *result) {
+    double ns[BENCH_MAX_REPETITIONS], allocationCounts[BENCH_MAX_REPETITIONS];
+    BenchState state;
+    uint64_t start, allocated;
+    int i, repetition;
+
+    state.population = population;
+    state.pcbs = malloc(sizeof(PCB_Ptr) * population);
+
+    for (repetition = 0; repetition < repetitions; repetition++) {
+        // every repetition starts from new pcbs in the same order
+        for (i = 0; i < population; i++) {
+            state.pcbs[i] = PCB_constructor(Compute);
+            PCB_setOrigPriority(state.pcbs[i], i % PRIORITY_LEVELS);
+            PCB_setCurPriority(state.pcbs[i], i % PRIORITY_LEVELS);
+        }
+
+        benchmark->setup(&state);
+        // one pass over the population warms up the caches
+        benchmark->run(&state, population);
+        allocated = allocations;
+        start = nowNs();
+        benchmark->run(&state, operations);
+        ns[repetition] = (double) (nowNs() - start) / operations;
+        allocationCounts[repetition] = (double) (allocations - allocated) / operations;
+        benchmark->teardown(&state);
+
+        for (i = 0; i < population; i++) {
+            PCB_destructor(state.pcbs[i]);
+        }
+    }
+
+    free(state.pcbs);
+    qsort(ns, repetitions, sizeof(double), compareDoubles);
+    qsort(allocationCounts, repetitions, sizeof(double), compareDoubles);
+    snprintf(result->name, sizeof(result->name), "%s", benchmark->name);
+    result->population = population;
+    result->operations = operations;
+    result->nsPerOp = ns[repetitions / 2];
+    result->allocationsPerOp = allocationCounts[repetitions / 2];
+}
+
+int parsePopulations(const char *list, int *populations) {
+    int count = 0;
+    char *end;
+    long population;
+
+    do {
+        population = strtol(list, &end, 10);
+
+        if (end == list || population < 1 || population > 1 << 24 || count == BENCH_MAX_POPULATIONS) {
+            return 0;
+        }
+
+        populations[count++] = population;
+        list = end + 1;
+    } while (*end == ',');
+
+    return *end == '\0' ? count : 0;
+}
+
+int readBaseline(const char *fileName, BenchResult *results) {
+    FILE *file = fopen(fileName, "r");
+    char line[256];
+    int count = 0;
+
+    if (file == NULL) {
+        return -1;
+    }
+
+    while (count < BENCH_MAX_RESULTS && fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"population\": %d, \"ops\": %ld, \"ns_per_op\": %lf, \"allocs_per_op\": %lf",
+            results[count].name, &results[count].population, &results[count].operations,
+            &results[count].nsPerOp, &results[count].allocationsPerOp) == 5) {
+            count++;
+        }
+    }
+
+    fclose(file);
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    int populations[BENCH_MAX_POPULATIONS] = {16, 256, 4096, 65536};
+    int count = 4, repetitions = 5, baselineCount = 0, results = 0, option, valid = 1, i, j, k;
+    long operations = 1000000;
+    const char *jsonName = NULL, *baselineName = NULL;
+    BenchResult baseline[BENCH_MAX_RESULTS], *result;
+    BenchResult *all;
+    FILE *json;
+
+    while (valid && (option = getopt(argc, argv, "n:i:r:o:b:")) != -1) {
+        if (option == 'n') {
+            count = parsePopulations(optarg, populations);
+            valid = count > 0;
+        } else if (option == 'i' && atol(optarg) >= 1) {
+            operations = atol(optarg);
+        } else if (option == 'r' && atoi(optarg) >= 1 && atoi(optarg) <= BENCH_MAX_REPETITIONS) {
+            repetitions = atoi(optarg);
+        } else if (option == 'o') {
+            jsonName = optarg;
+        } else if (option == 'b') {
+            baselineName = optarg;
+        } else {
+            valid = 0;
+        }
+    }
+
+    if (!valid || optind != argc) {
+        fprintf(stderr, "usage: %s [-n populations] [-i operations] [-r repetitions] [-o json_file] [-b baseline_file]\n", argv[0]);
+        return 1;
+    }
+
+    if (baselineName != NULL && (baselineCount = readBaseline(baselineName, baseline)) < 0) {
+        perror(baselineName);
+        return 1;
+    }
+
+    all = malloc(sizeof(BenchResult) * count * (sizeof(benchmarks) / sizeof(benchmarks[0])));
+    printf("%-34s %10s %10s %10s %10s\n", "benchmark", "population", "ns/op", "allocs/op", baselineName != NULL ? "speedup" : "");
+
+    for (i = 0; i < (int) (sizeof(benchmarks) / sizeof(benchmarks[0])); i++) {
+        for (j = 0; j < count; j++) {
+            result = &all[results++];
+            measure(&benchmarks[i], populations[j], operations, repetitions, result);
+            printf("%-34s %10d %10.2f %10.4f", result->name, result->population, result->nsPerOp, result->allocationsPerOp);
+
+            // a speedup above 1 means the benchmark got faster than in the baseline
+            for (k = 0; k < baselineCount; k++) {
+                if (strcmp(baseline[k].name, result->name) == 0 && baseline[k].population == result->population) {
+                    printf(" %9.2fx", baseline[k].nsPerOp / result->nsPerOp);
+                }
+            }
+
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+
+    if (jsonName != NULL) {
+        json = fopen(jsonName, "w");
+
+        if (json == NULL) {
+            perror(jsonName);
+            free(all);
+            return 1;
+        }
+
+        fprintf(json, "{\n  \"repetitions\": %d,\n  \"benchmarks\": [\n", repetitions);
+
+        for (i = 0; i < results; i++) {
+            fprintf(json, "    {\"name\": \"%s\", \"population\": %d, \"ops\": %ld, \"ns_per_op\": %.3f, \"allocs_per_op\": %.4f}%s\n",
+                all[i].name, all[i].population, all[i].operations, all[i].nsPerOp, all[i].allocationsPerOp,
+                i + 1 < results ? "," : "");
+        }
+
+        fprintf(json, "  ]\n}\n");
+        fclose(json);
+    }
+
+    free(all);
+    return 0;
+}
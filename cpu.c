@@ -15,18 +15,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
-#include "pcb.h"
-#include "queue.h"
-#include "priority_queue.h"
-#include "syn.h"
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+#include "simulation.h"
 
-#define CYCLES 1000000 // number of cycles we are going to run
 #define MAX_PROC 72 // this includes 4 pairs of PC_PCB, 4 pairs of MR_PCB, and 64 other types of PCBs 
 //#define MAX_PROC_PER_RUN 16 // limit number of PCBs being created below 16 every time
-#define REFILL_FREQUENCY 3 // the cycle for refilling the ready queue
 //#define NEW_PCB_FREQUENCY 1000 // generate new PCBs every 1000 runs
-#define TIMER_QUANTUM 300 // time quantum for cpu timer
 #define PRI_ZERO 4 // number of priority 0 pcbs
 #define PRI_ONE 56 // number of priority 1 pcbs
 #define PRI_TWO 8 // number of priority 2 pcbs
@@ -36,81 +32,77 @@
 #define PC_PCB 4 // 4 pairs of producer consumer pcbs
 #define MR_PCB 4 // 4 pair of mutual resource pcbs
 
+// names of Latency_Metric values, used in the summary
+const char *latencyNames[] = {"turnaround", "response", "ready wait", "blocked", "inversion"};
+
 //define types of interrupts/traps
 typedef enum {Timer_interrupt, IO_completion_interrupt, IO_trap, Termination_trap, Lock_trap, Unlock_trap, Wait_trap, Signal_trap} Interrupt_Type;
 
-//define a type for system stack
-typedef struct {
-    unsigned int pc; // program counter
-    int sw; // state work
-} SysStack;
-
-typedef SysStack *SysStack_Ptr;
-
-int nextPCB_ID = 1; 
-int refillCounter = 0; // a counter for refilling the ready queue
-int swRegister = 0; // state work register
-unsigned int pcRegister = 0; // program counter register
-PCB_Ptr curPCB; // current PCB
-PCB_Ptr idleTask; // an idle task
-SysStack_Ptr sysStack;
-Queue_Ptr newQueue; // a queue holding all newly created PCBs
-PriorityQueue_Ptr readyQueue; // a queue holding all PCBs that are in ready state
-Queue_Ptr terminationQueue; // a queue holding PCBs that are going to be terminated
-Queue_Ptr ioOneWaitQueue; // a wait queue for io device one
-Queue_Ptr ioTwoWaitQueue; // a wait queue for io device two
-unsigned int cpuTime; // a counter used for system time
-int timerCounter; // cpu timer counter
-int ioOneCounter; // io device one timer counter
-int ioTwoCounter; // io device two timer counter
-// 0 and 1 for 1st pair, 2 and 3 for 2nd pair, 4 and 5 for 3rd pair, 6 and 7 for 4th pair, even numbers are for producers
-int pcPairID = 0; 
-// pair ID for mutual resource users, 0 and 1 for 1st pair, 2 and 3 for 2nd pair, 4 and 5 for 3rd pair, 6 and 7 for 4th pair
-// even numbers are for process A type
-int mrPairID = 0;
-Mutex_Ptr mutexArray[4]; // mutexes at index 0, 1, 2, 3 are for 1st, 2nd, 3rd, and 4th pair respectively, only for producer consumer pair
-// only for mutual resource users, mutexes at index 0 and 1 for 1st pair, at index 2 and 3 for 2nd pair, at index 4 and 5 for 3rd pair
-// at index 6 and 7 for 4th pair, mutexes at even indexes are resource 1 for each pair
-Mutex_Ptr mrMutexArray[8]; 
-CondVar_Ptr readCondVars[4]; // conditional variables at index 0, 1, 2, 3 are for 1st, 2nd, 3rd, and 4th pair respectively
-CondVar_Ptr writeCondVars[4]; // conditional variables at index 0, 1, 2, 3 are for 1st, 2nd, 3rd, and 4th pair respectively
-int shareIntArray[4]; // integers at index 0, 1, 2, 3 are for 1st, 2nd, 3rd, and 4th pair respectively
-// flags for the four producer consumer pairs, 1 means the shared integer can be written, 0 means the shared integer can be read
-int writableFlags[4]; 
-// flags are initially -1, index 0 and 1 are for pair 0, 2 and 3 are for pair 1, 4 and 5 are for pair 2, 6 and 7 are for pair 3
-// once deadlock is detected, corresponding indexes will be filled with PIDs.
-int deadLockFlags[8];
+/**
+* Used by mutual resource users to determine which resource should be used
+*/
+int locateResource(Simulation_Ptr sim, int *array);
+
+/**
+* Prints one line of the latency table for the histogram, unless it is empty
+*/
+void printLatency(const char *metric, const char *group, const Histogram *histogram);
+
+/**
+* Fills merged with the latencies of the given metric of all processes
+*/
+void mergeLatency(Simulation_Ptr sim, Latency_Metric metric, Histogram_Ptr merged);
+
+/**
+* Records the deadlock pcb closed by waiting for the mutex with the given index, and breaks
+* it when recovery is on. flag is 1 for mutual resource mutexes.
+*/
+void deadLockFound(Simulation_Ptr sim, PCB_Ptr pcb, int flag, int mutexIndex);
+
+/**
+* Returns the mutex the current pcb locks or unlocks at the pc in array, which is its
+* lockArray or unlockArray, and stores the index the trace knows the mutex by in mutexIndex
+*/
+Mutex_Ptr pairMutex(Simulation_Ptr sim, int *array, int *mutexIndex);
+
+/**
+* Fills the record with the current lengths of the queues and the totals of the counters so far
+*/
+void sampleTotals(Simulation_Ptr sim, SampleRecord *record);
 
 /**
 * Used to initialize a pcb with a given type and priority level
 */
-PCB_Ptr initializePCB(PCB_Type type, int priority) {
-    srand(time(NULL) + nextPCB_ID);
-    PCB_Ptr pcb = PCB_constructor(type);
-    PCB_setCreation(pcb, cpuTime);
-    PCB_setProcessID(pcb, nextPCB_ID++);
+PCB_Ptr initializePCB(Simulation_Ptr sim, PCB_Type type, int priority) {
+    PCB_Ptr pcb = PCBPool_acquire(sim->pcbPool, type);
+    PCB_setCreation(pcb, sim->cpuTime);
+    PCB_setProcessID(pcb, sim->nextPCB_ID++);
     
     if (type == IO || type == Compute) {
-       PCB_setTerminate(pcb, rand() % 15);
-       PCB_setIoTraps(pcb);
+       PCB_setTerminate(pcb, Rng_range(sim->workloadRng, 15));
+       PCB_setIoTraps(pcb, sim->trapRng, sim->config.devices);
+    }
+    
+    // the built-in priorities go down to 3, with fewer levels those pcbs get the lowest one
+    if (priority >= sim->config.levels) {
+       priority = sim->config.levels - 1;
     }
     
     PCB_setCurPriority(pcb, priority);
     PCB_setOrigPriority(pcb, priority);
-    printf("Process created: PID %d at system time %d\n %s\n", nextPCB_ID - 1, cpuTime, PCB_toString(pcb));
+    TRACE_LOG_PCB(sim->trace, sim->cpuTime, pcb);
     return pcb;
 }
 
 /**
 * Generates all priority levels that are needed to create initial pcbs
 */ 
-int *generatePriorities() {
+int *generatePriorities(Simulation_Ptr sim) {
     int *priorities = malloc(sizeof(int) * MAX_PROC);
-    srand(time(NULL));
     int pri, num = 0, priZeroCounter = 0, priOneCounter = 0, priTwoCounter = 0, priThreeCounter = 0;
     
     while (num < MAX_PROC) {
-       pri = rand() % MAX_PROC;
+       pri = Rng_range(sim->workloadRng, MAX_PROC);
       
        if ((pri >= 0 && pri <= 3) && priZeroCounter < PRI_ZERO) {
           priorities[num++] = 0;
@@ -133,55 +125,60 @@ int *generatePriorities() {
 /**
 * Initializes the new queue with certain amount of each type of pcbs
 */
-void initializeNewQueue() {
-    srand(time(NULL));
+void initializeNewQueue(Simulation_Ptr sim) {
     PCB_Ptr pcb;
-    int *priorities = generatePriorities();
+    int *priorities = generatePriorities(sim);
     int type, i, success = 0, ioCounter = 0, compCounter = 0, pcPairCounter = 0, mutPairCounter = 0;
     
     for (i = 0; i < MAX_PROC; i++) {
         if (priorities[i] == 0) {
-            Queue_enqueue(newQueue, initializePCB(Compute, 0));  
+            Queue_enqueue(sim->newQueue, initializePCB(sim, Compute, 0));  
         } else {
             while (!success) {
-                type = rand() % 4;
+                type = Rng_range(sim->workloadRng, 4);
                
                 if (type == IO && ioCounter < IO_PCB) {
-                    Queue_enqueue(newQueue, initializePCB(IO, priorities[i])); 
+                    Queue_enqueue(sim->newQueue, initializePCB(sim, IO, priorities[i])); 
                     ioCounter++;
                     success = 1;
                 } else if (type == Compute && compCounter < COMPUTE_PCB) {
-                    Queue_enqueue(newQueue, initializePCB(Compute, priorities[i])); 
+                    Queue_enqueue(sim->newQueue, initializePCB(sim, Compute, priorities[i])); 
                     compCounter++;
                     success = 1;
                 } else if (type == ProducerConsumer && pcPairCounter < PC_PCB && priorities[i] == 1) {
-                    pcb = initializePCB(ProducerConsumer, priorities[i]);
+                    pcb = initializePCB(sim, ProducerConsumer, priorities[i]);
                     PCB_setSynData(pcb, 350, 800, 450, 1000, 400, 900);
-                    PCB_setIoTraps(pcb);
-                    PCB_setPairID(pcb, pcPairID++);
-                    Queue_enqueue(newQueue, pcb);
+                    PCB_setIoTraps(pcb, sim->trapRng, sim->config.devices);
+                    PCB_setPairID(pcb, sim->pcPairID++);
+                    Queue_enqueue(sim->newQueue, pcb);
                      
-                    pcb = initializePCB(ProducerConsumer, priorities[i]);
+                    pcb = initializePCB(sim, ProducerConsumer, priorities[i]);
                     PCB_setSynData(pcb, 350, 800, 450, 1000, 400, 900);
-                    PCB_setIoTraps(pcb);
-                    PCB_setPairID(pcb, pcPairID++);
-                    Queue_enqueue(newQueue, pcb);
+                    PCB_setIoTraps(pcb, sim->trapRng, sim->config.devices);
+                    PCB_setPairID(pcb, sim->pcPairID++);
+                    Queue_enqueue(sim->newQueue, pcb);
 
                     pcPairCounter++;
                     success = 1;
                 } else if (type == MutualResource && mutPairCounter < MR_PCB && priorities[i] == 1) {
-                    pcb = initializePCB(MutualResource, priorities[i]);
+                    pcb = initializePCB(sim, MutualResource, priorities[i]);
                     PCB_setSynData(pcb, 300, 500, 900, 700, -1, -1);
-                    PCB_setIoTraps(pcb);
-                    PCB_setPairID(pcb, mrPairID++);
-                    Queue_enqueue(newQueue, pcb);
+                    PCB_setIoTraps(pcb, sim->trapRng, sim->config.devices);
+                    PCB_setPairID(pcb, sim->mrPairID++);
+                    Queue_enqueue(sim->newQueue, pcb);
                      
-                    pcb = initializePCB(MutualResource, priorities[i]);
-                    // if want to change to deadlock mode, switch to PCB_setSynData(pcb, 600, 400, 1000, 800, -1, -1);
-                    PCB_setSynData(pcb, 400, 600, 1000, 800, -1, -1);
-                    PCB_setIoTraps(pcb);
-                    PCB_setPairID(pcb, mrPairID++);
-                    Queue_enqueue(newQueue, pcb);
+                    pcb = initializePCB(sim, MutualResource, priorities[i]);
+                    
+                    // locking resource 1 first while the other pcb locks resource 0 first can deadlock
+                    if (sim->config.deadLockProne) {
+                        PCB_setSynData(pcb, 600, 400, 1000, 800, -1, -1);
+                    } else {
+                        PCB_setSynData(pcb, 400, 600, 1000, 800, -1, -1);
+                    }
+                    
+                    PCB_setIoTraps(pcb, sim->trapRng, sim->config.devices);
+                    PCB_setPairID(pcb, sim->mrPairID++);
+                    Queue_enqueue(sim->newQueue, pcb);
                     
                     mutPairCounter++;
                     success = 1;
@@ -191,111 +188,248 @@ void initializeNewQueue() {
             success = 0;
         }
     }
+    
+    free(priorities);
+}
+
+
+/**
+* Creates a pcb as described by a record of the workload file
+*/
+PCB_Ptr workloadPCB(Simulation_Ptr sim, const WorkloadRecord *record, const IoTrap *traps) {
+    PCB_Ptr pcb = PCBPool_acquire(sim->pcbPool, record->type);
+    PCB_setCreation(pcb, sim->cpuTime);
+    PCB_setProcessID(pcb, sim->nextPCB_ID++);
+    PCB_setTerminate(pcb, record->terminate);
+    PCB_setCurPriority(pcb, record->priority);
+    PCB_setOrigPriority(pcb, record->priority);
+    
+    if (record->type == ProducerConsumer || record->type == MutualResource) {
+        PCB_setSynData(pcb, record->lock[0], record->lock[1], record->unlock[0], record->unlock[1], record->wait, record->signal);
+        PCB_setPairID(pcb, record->pairID);
+    }
+    
+    if (record->flags & WORKLOAD_RANDOM_IO) {
+        PCB_setIoTraps(pcb, sim->trapRng, sim->config.devices);
+    } else {
+        PCB_setIoTrapValues(pcb, record->ioCount, traps);
+    }
+    
+    TRACE_LOG_PCB(sim->trace, sim->cpuTime, pcb);
+    return pcb;
+}
+
+/**
+* Puts a pcb for every process of the workload file that arrives by the current
+* system time into the new queue, records the simulation can't run, including
+* those needing more devices than it has, are skipped
+*/
+void admitArrivals(Simulation_Ptr sim) {
+    Workload_Ptr workload = sim->config.workload;
+    const WorkloadRecord *record;
+    const IoTrap *traps;
+    
+    if (workload == NULL) return;
+    
+    while (sim->nextArrival < workload->count && workload->records[sim->nextArrival].arrival <= sim->cpuTime) {
+        record = &workload->records[sim->nextArrival];
+        traps = Workload_traps(workload, record);
+        
+        if (Workload_isValid(record, traps, sim->config.levels) && Workload_devices(record, traps) <= sim->config.devices) {
+            Queue_enqueue(sim->newQueue, workloadPCB(sim, record, traps));
+        }
+        
+        sim->nextArrival++;
+    }
+}
+
+/**
+* Records a latency of the pcb in the histograms of its priority and its type, latencies the
+* histograms can't hold are recorded as UINT32_MAX
+*/
+void recordLatency(Simulation_Ptr sim, PCB_Ptr pcb, Latency_Metric metric, uint64_t cycles) {
+    uint32_t value = cycles < UINT32_MAX ? (uint32_t) cycles : UINT32_MAX;
+    Histogram_record(sim->priorityLatency[metric][PCB_getOrigPriority(pcb)], value);
+    Histogram_record(sim->typeLatency[metric][PCB_getType(pcb)], value);
+}
+
+/**
+* Puts a pcb that is new or was preempted into the ready queue of the current cpu
+*/
+void readyPCB(Simulation_Ptr sim, PCB_Ptr pcb) {
+    PCB_setCurrentState(pcb, Ready);
+    pcb->readyCPU = sim->cpu->id;
+    pcb->readySince = sim->cpuTime;
+    sim->policy->enqueue(sim->cpu->readyQueue, pcb);
+}
+
+/**
+* Puts a pcb that stopped waiting into the ready queue of the current cpu
+*/
+void wakePCB(Simulation_Ptr sim, PCB_Ptr pcb) {
+    PCB_setCurrentState(pcb, Ready);
+    pcb->readyCPU = sim->cpu->id;
+    pcb->blockedTime += sim->cpuTime - pcb->blockedSince;
+    
+    if (pcb->inverted) {
+        pcb->inverted = 0;
+        recordLatency(sim, pcb, Inversion_latency, sim->cpuTime - pcb->invertedSince);
+    }
+    
+    pcb->readySince = sim->cpuTime;
+    sim->policy->onWake(sim->cpu->readyQueue, pcb);
 }
 
+/**
+* Tells the policy the running pcb waits for I/O, a lock or a condition from now on
+*/
+void blockPCB(Simulation_Ptr sim) {
+    sim->cpu->curPCB->blockedSince = sim->cpuTime;
+    sim->policy->onBlock(sim->cpu->readyQueue, sim->cpu->curPCB);
+}
+
+/**
+* Makes a pcb taken from a ready queue the running pcb of the current cpu
+*/
+void runPCB(Simulation_Ptr sim, PCB_Ptr pcb) {
+    sim->cpu->curPCB = pcb;
+    PCB_setCurrentState(pcb, Running);
+    pcb->readyWait += sim->cpuTime - pcb->readySince;
+    
+    if (!pcb->dispatched) {
+        pcb->dispatched = 1;
+        recordLatency(sim, pcb, Response_latency, sim->cpuTime - PCB_getCreation(pcb));
+    }
+}
 
 /**
 * This refilles the ready queue using PCBs in the new queue
 */
-void refillReadyQueue() {
-    PCB_Ptr readyPCB;
+void refillReadyQueue(Simulation_Ptr sim) {
+    while(!Queue_isEmpty(sim->newQueue)) {
+        readyPCB(sim, Queue_dequeue(sim->newQueue));
+    }
+}
 
-    while(!Queue_isEmpty(newQueue)) {
-        readyPCB = Queue_dequeue(newQueue);
-        PCB_setCurrentState(readyPCB, Ready);
-        PriorityQueue_enqueue(readyQueue, readyPCB);
+/**
+* Returns ready queue of the cpu with the most ready PCBs when the current cpu
+* has none, or NULL when there is nothing to steal
+*/
+void *stealFrom(Simulation_Ptr sim) {
+    void *victim = NULL;
+    int i, most = 0;
+    
+    if (sim->policy->size(sim->cpu->readyQueue) > 0) {
+        return NULL;
+    }
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        if (sim->policy->size(sim->cpus[i].readyQueue) > most) {
+            victim = sim->cpus[i].readyQueue;
+            most = sim->policy->size(victim);
+        }
     }
+    
+    return victim;
 }
 
 /**
 * Loads PC and SW values into the SysStack and get next process ready to run
 */
-void dispatcher() {
+void dispatcher(Simulation_Ptr sim) {
 
-    // if ready queue isn't empty, get a PCB from the head of the queue. Otherwise,
-    // get idel task ready to run
-    if (!PriorityQueue_isEmpty(readyQueue)) {
-        curPCB = PriorityQueue_dequeue(readyQueue);
-        PCB_setCurrentState(curPCB, Running);
+    void *victim = stealFrom(sim);
+    PCB_Ptr previous = sim->cpu->curPCB;
+    
+    // if ready queue isn't empty, get the PCB the policy picks from it. Otherwise,
+    // take one from the busiest other cpu, or get idel task ready to run
+    if (sim->policy->size(sim->cpu->readyQueue) > 0) {
+        runPCB(sim, sim->policy->pickNext(sim->cpu->readyQueue));
+    } else if (victim != NULL) {
+        runPCB(sim, sim->policy->pickNext(victim));
+        sim->cpu->steals++;
     } else {
-        curPCB = idleTask;
+        sim->cpu->curPCB = sim->cpu->idleTask;
+    }
+
+    if (PCB_getCurrentState(sim->cpu->curPCB) != Idle) {
+        sim->cpu->timerCounter = sim->policy->timeSlice(sim->cpu->readyQueue, sim->cpu->curPCB, sim->cpu->timerCounter);
+    }
+
+    if (sim->cpu->curPCB != previous) {
+        sim->cpu->switchStall += sim->config.overhead.contextSwitch;
+        sim->cpu->switches++;
     }
 
-    sysStack->pc = PCB_getPC(curPCB);
-    sysStack->sw = PCB_getSW(curPCB);
+    sim->cpu->sysStack.pc = PCB_getPC(sim->cpu->curPCB);
+    sim->cpu->sysStack.sw = PCB_getSW(sim->cpu->curPCB);
+    PCB_seekTrap(sim->cpu->curPCB, sim->cpu->sysStack.pc);
 }
 
 /**
 * Processes passed in interrupt/trap 
 */
-void scheduler(Interrupt_Type type){
+void scheduler(Simulation_Ptr sim, Interrupt_Type type){
     PCB_Ptr pcb;
     
-    if (type == Timer_interrupt && PCB_getCurrentState(curPCB) != Idle) {
-        PCB_setCurrentState(curPCB, Ready);
-        PriorityQueue_enqueue(readyQueue, curPCB);
+    if (type == Timer_interrupt && PCB_getCurrentState(sim->cpu->curPCB) != Idle) {
+        readyPCB(sim, sim->cpu->curPCB);
     } else if (type == Termination_trap) {
-        while (!Queue_isEmpty(terminationQueue)) {
-            pcb = Queue_dequeue(terminationQueue);
-            Queue_enqueue(newQueue, initializePCB(pcb->type, pcb->origPriority));
-            PCB_destructor(pcb);            
+        while (!Queue_isEmpty(sim->terminationQueue)) {
+            pcb = Queue_dequeue(sim->terminationQueue);
+            PCB_Type pcbType = PCB_getType(pcb);
+            int priority = PCB_getOrigPriority(pcb);
+            // release first, so the new pcb reuses memory of the terminated one
+            PCBPool_release(sim->pcbPool, pcb);
+            
+            // a workload file describes every process that will ever run
+            if (sim->config.workload == NULL) {
+                Queue_enqueue(sim->newQueue, initializePCB(sim, pcbType, priority));
+            }
         }
     } else if (type == IO_completion_interrupt) {
         return;
     } else if (type == Unlock_trap) {
-        int pairID = PCB_getPairID(curPCB);
-        PCB_Type type = PCB_getType(curPCB);
-        Mutex_Ptr mutex;
-   
-        if (type == MutualResource) {
-           // (pairID / 2) * 2 is not same as pairID here
-           int mutexIndex = (pairID / 2) * 2 + locateResource(curPCB->unlockArray);
-           mutex = mrMutexArray[mutexIndex];
-        } else { // for producer consumer pair
-           int mutexIndex = pairID / 2;
-           mutex = mutexArray[mutexIndex];
-        }
-
-        PCB_setCurrentState(mutex->curPCB, Ready);
-        PriorityQueue_enqueue(readyQueue, mutex->curPCB);
+        int mutexIndex;
+        Mutex_Ptr mutex = pairMutex(sim, sim->cpu->curPCB->unlockArray, &mutexIndex);
+        wakePCB(sim, mutex->curPCB);
         return;
     } else if (type == Wait_trap) {
-        Mutex_Ptr mutex = mutexArray[PCB_getPairID(curPCB) / 2];
+        Mutex_Ptr mutex = &SyncRegistry_pcPair(sim->sync, PCB_getPairID(sim->cpu->curPCB) / 2)->mutex;
         
         if (mutex->curPCB != NULL) {
-            PCB_setCurrentState(mutex->curPCB, Ready);
-            PriorityQueue_enqueue(readyQueue, mutex->curPCB);
+            wakePCB(sim, mutex->curPCB);
         }
     }
     
     // refill the ready queue when interrupted PCB is for idle task or the counter reaches
     // the point that the ready queue needs to be refilled
-    if (PCB_getCurrentState(curPCB) == Idle || refillCounter == REFILL_FREQUENCY) {
-        refillReadyQueue();
-        refillCounter = 0;
-    } else if (refillCounter < REFILL_FREQUENCY) {
-        refillCounter++;
+    if (PCB_getCurrentState(sim->cpu->curPCB) == Idle || sim->cpu->refillCounter == sim->config.refillFrequency) {
+        refillReadyQueue(sim);
+        sim->cpu->refillCounter = 0;
+    } else if (sim->cpu->refillCounter < sim->config.refillFrequency) {
+        sim->cpu->refillCounter++;
     }
 
-    dispatcher();
+    dispatcher(sim);
 }
 
 /**
 * This is interrupt service routine for timer interrupt.
 */
-void timerInterruptServiceRoutine(){
-    int prePcbID = PCB_getProcessID(curPCB);
-    if (PCB_getCurrentState(curPCB) != Idle) {
-        PCB_setCurrentState(curPCB, Interrupted);
+void timerInterruptServiceRoutine(Simulation_Ptr sim){
+    int prePcbID = PCB_getProcessID(sim->cpu->curPCB);
+    if (PCB_getCurrentState(sim->cpu->curPCB) != Idle) {
+        PCB_setCurrentState(sim->cpu->curPCB, Interrupted);
     }
 
-    PCB_setPC(curPCB, sysStack->pc);
-    PCB_setSW(curPCB, sysStack->sw);
-    scheduler(Timer_interrupt);
-    int curPcbID = PCB_getProcessID(curPCB);
+    PCB_setPC(sim->cpu->curPCB, sim->cpu->sysStack.pc);
+    PCB_setSW(sim->cpu->curPCB, sim->cpu->sysStack.sw);
+    scheduler(sim, Timer_interrupt);
+    int curPcbID = PCB_getProcessID(sim->cpu->curPCB);
     // simulate IRET here
-    pcRegister = sysStack->pc;
-    printf("Timer interrupt: PID %d was running, PID %d dispatched\n", prePcbID, curPcbID);
+    sim->cpu->pcRegister = sim->cpu->sysStack.pc;
+    TRACE_LOG(sim->trace, Timer_event, sim->cpuTime, 0, prePcbID, curPcbID, 0);
 }
 
 /**
@@ -303,152 +437,93 @@ void timerInterruptServiceRoutine(){
 * or reset the timer counter to cpu qutanum value and return 1
 * and 1 means there is a timer interrupt.
 */
-int timer() {
-    if (timerCounter > 0) {
-        timerCounter--;
+int timer(Simulation_Ptr sim) {
+    if (sim->cpu->timerCounter > 0) {
+        sim->cpu->timerCounter--;
         return 0;
     } else {
-        timerCounter = TIMER_QUANTUM;
+        sim->cpu->timerCounter = sim->config.timerQuantum;
         return 1;
     }
 }
 
 /**
-* This is interrupt service routine for I/O completion interrupt.
+* This is interrupt service routine for I/O completion interrupt of the device with the given
+* number, the pcb whose request completed is put into the ready queue
 */
-void ioInterruptServiceRoutine(int deviceNum) {
-    PCB_Ptr blockedPCB;
-    
-    if (deviceNum == 1) {
-        blockedPCB = Queue_dequeue(ioOneWaitQueue);
-        if (!Queue_isEmpty(ioOneWaitQueue)) {
-            srand(time(NULL) + cpuTime);
-            ioOneCounter = (rand() % 3 + 3) * TIMER_QUANTUM;
-        }
-    } else {
-        blockedPCB = Queue_dequeue(ioTwoWaitQueue);
-        if (!Queue_isEmpty(ioTwoWaitQueue)) {
-            srand(time(NULL) + cpuTime);
-            ioTwoCounter = (rand() % 3 + 3) * TIMER_QUANTUM;
-        }
-    }
-    
-    printf("I/O completion interrupt: PID %d is running, PID %d put in ready queue\n",
-        PCB_getProcessID(curPCB), PCB_getProcessID(blockedPCB));
-    PCB_setCurrentState(blockedPCB, Ready);
-    PriorityQueue_enqueue(readyQueue, blockedPCB);
-    scheduler(IO_completion_interrupt);
+void ioInterruptServiceRoutine(Simulation_Ptr sim, int deviceNum, PCB_Ptr blockedPCB) {
+    TRACE_LOG(sim->trace, IO_completion_event, sim->cpuTime, 0, deviceNum, PCB_getProcessID(sim->cpu->curPCB), PCB_getProcessID(blockedPCB));
+    sim->cpu->kernelStall += sim->config.overhead.ioISR;
+    wakePCB(sim, blockedPCB);
+    scheduler(sim, IO_completion_interrupt);
 }
 
 /**
-* This is timer for I/O device 1, returns 1 when I/O completion 
-* interrupt occurs. Otherwise, returns 0.
+* This advances all I/O devices by one cycle and delivers the completion
+* interrupts of the requests that completed
 */
-int ioOneTimer() {
-    
-    if (ioOneCounter > 0) {
-        ioOneCounter--;
-        return 0;
-    } else {
-        if (!Queue_isEmpty(ioOneWaitQueue)) {
-            return 1;
-        } else {
-            return 0;
-        }
-    }
-}
-
-/**
-* This is timer for I/O device 2, returns 1 when I/O completion 
-* interrupt occurs. Otherwise, returns 0.
-*/
-int ioTwoTimer() {
-
-    if (ioTwoCounter > 0) {
-        ioTwoCounter--;
-        return 0;
-    } else {
-        if (!Queue_isEmpty(ioTwoWaitQueue)) {
-            return 1;
-        } else {
-            return 0;
-        }
-    }
-}
-
-/**
-* Compares pc with values in the trap array and return 1 if it needs
-* io device 1, or 2 if it needs io device 2. otherwise, 0.
-*/
-int checkIOTrapDevice(int pc) {
-    int i;
-    int *io_1_trap = PCB_getIo_1_trap(curPCB);
-    int *io_2_trap = PCB_getIo_2_trap(curPCB);
+void ioTimers(Simulation_Ptr sim) {
+    int completed[MAX_DEVICES], i;
+    PCB_Ptr blockedPCB;
     
-    for (i = 0; i < 4; i++) {
-        if (io_1_trap[i] == pc) {
-            return 1;
-        }
+    // every device counts down before any interrupt is delivered
+    for (i = 0; i < sim->config.devices; i++) {
+        completed[i] = Device_tick(sim->devices[i]);
     }
     
-    for (i = 0; i < 4; i++) {
-        if (io_2_trap[i] == pc) {
-            return 2;
+    for (i = 0; i < sim->config.devices; i++) {
+        while (completed[i] && (blockedPCB = Device_complete(sim->devices[i], sim->ioRng, sim->config.timerQuantum)) != NULL) {
+            ioInterruptServiceRoutine(sim, i + 1, blockedPCB);
         }
     }
-
-    return 0;
 }
 
 /*
 * This processes I/O request trap for an I/O device with given device number.
 */ 
-void ioTrapHandler(int deviceNum) {
-    PCB_setCurrentState(curPCB, Blocked);
-    PCB_setPC(curPCB, sysStack->pc);
-    PCB_setSW(curPCB, sysStack->sw);
-    int prePcbID = PCB_getProcessID(curPCB);
-    if (deviceNum == 1) {
-        Queue_enqueue(ioOneWaitQueue, curPCB);
-        
-        if (ioOneCounter == 0) {
-            srand(time(NULL) + cpuTime);
-            ioOneCounter = (rand() % 3 + 3) * TIMER_QUANTUM;
-        }
-    } else {
-        Queue_enqueue(ioTwoWaitQueue, curPCB);
-        
-        if (ioTwoCounter == 0) {
-            srand(time(NULL) + cpuTime);
-            ioTwoCounter = (rand() % 3 + 3) * TIMER_QUANTUM;
-        }
-    }
+void ioTrapHandler(Simulation_Ptr sim, int deviceNum) {
+    Device_Ptr device = sim->devices[deviceNum - 1];
+    sim->cpu->kernelStall += sim->config.overhead.trapEntry;
+    PCB_setCurrentState(sim->cpu->curPCB, Blocked);
+    PCB_setPC(sim->cpu->curPCB, sim->cpu->sysStack.pc);
+    PCB_setSW(sim->cpu->curPCB, sim->cpu->sysStack.sw);
+    int prePcbID = PCB_getProcessID(sim->cpu->curPCB);
+    sim->cpu->curPCB->ioBlock = Rng_range(sim->blockRng, device->spec.blocks);
+    Device_submit(device, sim->cpu->curPCB, sim->ioRng, sim->config.timerQuantum);
     
-    timerCounter = TIMER_QUANTUM;
-    scheduler(IO_trap);
-    int curPcbID = PCB_getProcessID(curPCB);
-    pcRegister = sysStack->pc;
-    printf("I/O trap request: I/O device %d, PID %d put into waiting queue, PID %d dispatched\n",
-        deviceNum, prePcbID, curPcbID);
+    sim->cpu->timerCounter = sim->config.timerQuantum;
+    blockPCB(sim);
+    scheduler(sim, IO_trap);
+    int curPcbID = PCB_getProcessID(sim->cpu->curPCB);
+    sim->cpu->pcRegister = sim->cpu->sysStack.pc;
+    TRACE_LOG(sim->trace, IO_trap_event, sim->cpuTime, 0, deviceNum, prePcbID, curPcbID);
 }
 
 /**
 * This is a trap handler for process termination trap
 */
-void terminationTrapHandler() {
-    PCB_setCurrentState(curPCB, Terminated);
-    printf("Process terminated: PID %d at system time %d\n", PCB_getProcessID(curPCB), cpuTime);
-    Queue_enqueue(terminationQueue, curPCB);
-    scheduler(Termination_trap);
-    pcRegister = sysStack->pc;
+void terminationTrapHandler(Simulation_Ptr sim) {
+    sim->cpu->kernelStall += sim->config.overhead.trapEntry;
+    PCB_setCurrentState(sim->cpu->curPCB, Terminated);
+    PCB_setTermination(sim->cpu->curPCB, sim->cpuTime);
+    sim->completed++;
+    sim->turnaroundTime += sim->cpuTime - PCB_getCreation(sim->cpu->curPCB);
+    recordLatency(sim, sim->cpu->curPCB, Turnaround_latency, sim->cpuTime - PCB_getCreation(sim->cpu->curPCB));
+    recordLatency(sim, sim->cpu->curPCB, Wait_latency, sim->cpu->curPCB->readyWait);
+    recordLatency(sim, sim->cpu->curPCB, Blocked_latency, sim->cpu->curPCB->blockedTime);
+    TRACE_LOG(sim->trace, Process_terminated, sim->cpuTime, 0, PCB_getProcessID(sim->cpu->curPCB), 0, 0);
+    Queue_enqueue(sim->terminationQueue, sim->cpu->curPCB);
+    scheduler(sim, Termination_trap);
+    sim->cpu->pcRegister = sim->cpu->sysStack.pc;
 }
 
 /**
 * Used by mutual resource users to determine which resource should be used, return 0 when
 * resource 1 is going to be used, return 1 when resource 2 is going to be used
 */
-int locateResource(int *array) {
-   if (pcRegister == array[0]) {
+int locateResource(Simulation_Ptr sim, int *array) {
+   // pcs in the array are never negative
+   if (sim->cpu->pcRegister == (unsigned int) array[0]) {
       return 0;
    } else {
       return 1;
@@ -458,57 +533,169 @@ int locateResource(int *array) {
 /**
 * Print a message when no deadlock happens and both resources of a mutual resource user pair are used
 */
-void printMutualResourceTrace(int *array) {
-   int max;
+void printMutualResourceTrace(Simulation_Ptr sim, int *array) {
+   unsigned int max;
    
    if (array[0] > array[1]) {
-      max = array[0];
+      max = (unsigned int) array[0];
    } else {
-      max = array[1];
+      max = (unsigned int) array[1];
    }
    
-   if (max == pcRegister) {
-      printf("both resources of mutual resource user pair %d are used\n", PCB_getPairID(curPCB) / 2);
+   if (max == sim->cpu->pcRegister) {
+      TRACE_LOG(sim->trace, Resources_used_event, sim->cpuTime, 0, PCB_getPairID(sim->cpu->curPCB) / 2, 0, 0);
    }
 }
 
+Mutex_Ptr pairMutex(Simulation_Ptr sim, int *array, int *mutexIndex) {
+   int pairID = PCB_getPairID(sim->cpu->curPCB);
+   int resource;
+   
+   if (PCB_getType(sim->cpu->curPCB) == MutualResource) {
+      // (pairID / 2) * 2 is not same as pairID here
+      resource = locateResource(sim, array);
+      *mutexIndex = (pairID / 2) * 2 + resource;
+      return &SyncRegistry_mrPair(sim->sync, pairID / 2)->resources[resource];
+   }
+   
+   // for producer consumer pair
+   *mutexIndex = pairID / 2;
+   return &SyncRegistry_pcPair(sim->sync, pairID / 2)->mutex;
+}
+
 /**
-* This is a handler for lock
+* Sets the current priority of the pcb, moving it in the ready queue that holds it
 */
-void lockTrapHandler() {
-   int pairID = PCB_getPairID(curPCB);
-   PCB_Type type = PCB_getType(curPCB);
-   int mutexIndex;
-   Mutex_Ptr mutex;
+void changePriority(Simulation_Ptr sim, PCB_Ptr pcb, int priority) {
+   if (PCB_getCurrentState(pcb) == Ready) {
+      sim->policy->reprioritize(sim->cpus[pcb->readyCPU].readyQueue, pcb, priority);
+   } else {
+      PCB_setCurPriority(pcb, priority);
+   }
+}
+
+/**
+* Stores the mutexes the pcb holds in mutexes and returns their number, a pcb can
+* only hold the mutexes of its own pair
+*/
+int heldMutexes(Simulation_Ptr sim, PCB_Ptr pcb, Mutex_Ptr *mutexes) {
+   MRPair_Ptr mrPair;
+   int i, held = 0;
    
-   if (type == MutualResource) {
-      // (pairID / 2) * 2 is not same as pairID here
-      mutexIndex = (pairID / 2) * 2 + locateResource(curPCB->lockArray);
-      mutex = mrMutexArray[mutexIndex];
-   } else { // for producer consumer pair
-      mutexIndex = pairID / 2;
-      mutex = mutexArray[mutexIndex];
+   if (PCB_getType(pcb) == MutualResource) {
+      mrPair = SyncRegistry_mrPair(sim->sync, PCB_getPairID(pcb) / 2);
+      
+      for (i = 0; i < 2; i++) {
+         if (mrPair->resources[i].curPCB == pcb) {
+            mutexes[held++] = &mrPair->resources[i];
+         }
+      }
+   } else if (PCB_getType(pcb) == ProducerConsumer) {
+      mutexes[0] = &SyncRegistry_pcPair(sim->sync, PCB_getPairID(pcb) / 2)->mutex;
+      held = mutexes[0]->curPCB == pcb;
    }
    
-   int locked = Mutex_lock(mutex, curPCB);
-   int processID = PCB_getProcessID(curPCB);
+   return held;
+}
 
-   if (!locked) {
-      PCB_setPC(curPCB, pcRegister);
-      scheduler(Lock_trap);
-      pcRegister = sysStack->pc;
+/**
+* Called when the pcb blocked on a mutex. When the owner has a lower priority, the wait is
+* a priority inversion, and with priority inheritance the owner, and the owners it waits
+* for in turn, run with the priority of the pcb until they release their mutexes
+*/
+void inheritPriority(Simulation_Ptr sim, PCB_Ptr pcb) {
+   int priority = PCB_getCurPriority(pcb);
+   PCB_Ptr owner = pcb->waitingOn->curPCB;
+   
+   if (PCB_getCurPriority(owner) <= priority) {
+      return;
+   }
+   
+   pcb->inverted = 1;
+   pcb->invertedSince = sim->cpuTime;
+   sim->inversions++;
+   
+   if (!sim->config.priorityInheritance) {
+      return;
+   }
+   
+   // priorities only go up along the chain, so it ends even when it is a cycle
+   while (owner != NULL && PCB_getCurPriority(owner) > priority) {
+      if (owner->boostedFrom < 0) {
+         owner->boostedFrom = PCB_getCurPriority(owner);
+      }
       
-      if (type == MutualResource) {
-         printf("PID %d: requested lock on mutual resource mutex %d - blocked by PID %d\n", processID, mutexIndex, PCB_getProcessID(mutex->curPCB));
-      } else {
-         printf("PID %d: requested lock on producer consumer mutex %d - blocked by PID %d\n", processID, mutexIndex, PCB_getProcessID(mutex->curPCB));
-      } 
+      changePriority(sim, owner, priority);
+      sim->boosts++;
+      TRACE_LOG(sim->trace, Inherit_event, sim->cpuTime, 0, PCB_getProcessID(owner), priority, PCB_getProcessID(pcb));
+      owner = owner->waitingOn != NULL ? owner->waitingOn->curPCB : NULL;
+   }
+}
+
+/**
+* Called when the pcb released a mutex or a pcb stopped waiting for one of its mutexes,
+* it keeps the highest priority of the pcbs still waiting for its mutexes or gets back
+* the one it had before it was boosted
+*/
+void restorePriority(Simulation_Ptr sim, PCB_Ptr pcb) {
+   Mutex_Ptr mutexes[2];
+   PCB_Ptr waiter;
+   int i, j, held, priority;
+   
+   if (pcb->boostedFrom < 0) {
+      return;
+   }
+   
+   held = heldMutexes(sim, pcb, mutexes);
+   priority = pcb->boostedFrom;
+   
+   for (i = 0; i < held; i++) {
+      for (j = 0; j < Queue_size(mutexes[i]->waitingQueue); j++) {
+         waiter = Queue_at(mutexes[i]->waitingQueue, j);
+         
+         if (PCB_getCurPriority(waiter) < priority) {
+            priority = PCB_getCurPriority(waiter);
+         }
+      }
+   }
+   
+   if (priority == pcb->boostedFrom) {
+      pcb->boostedFrom = -1;
+   }
+   
+   if (priority != PCB_getCurPriority(pcb)) {
+      changePriority(sim, pcb, priority);
+   }
+}
+
+/**
+* This is a handler for lock
+*/
+void lockTrapHandler(Simulation_Ptr sim) {
+   PCB_Type type = PCB_getType(sim->cpu->curPCB);
+   int mutexIndex;
+   Mutex_Ptr mutex = pairMutex(sim, sim->cpu->curPCB->lockArray, &mutexIndex);
+   PCB_Ptr pcb = sim->cpu->curPCB;
+   int locked = Mutex_lock(mutex, pcb);
+   int processID = PCB_getProcessID(pcb);
+
+   if (locked != MUTEX_LOCKED) {
+      PCB_setPC(pcb, sim->cpu->pcRegister);
+      blockPCB(sim);
+      inheritPriority(sim, pcb);
+      scheduler(sim, Lock_trap);
+      sim->cpu->pcRegister = sim->cpu->sysStack.pc;
+      
+      TRACE_LOG(sim->trace, Lock_event, sim->cpuTime, type == MutualResource, processID, mutexIndex, PCB_getProcessID(mutex->curPCB));
+      
+      if (locked == MUTEX_DEADLOCKED) {
+         deadLockFound(sim, pcb, type == MutualResource, mutexIndex);
+      }
    } else {
+      TRACE_LOG(sim->trace, Lock_event, sim->cpuTime, type == MutualResource, processID, mutexIndex, -1);
+      
       if (type == MutualResource) {
-         printf("PID %d: requested lock on mutual resource mutex %d - succeeded\n", processID, mutexIndex);
-         printMutualResourceTrace(curPCB->lockArray);
-      } else {
-         printf("PID %d: requested lock on producer consumer mutex %d - succeeded\n", processID, mutexIndex);
+         printMutualResourceTrace(sim, pcb->lockArray);
       }
    }
 }
@@ -516,306 +703,1104 @@ void lockTrapHandler() {
 /**
 * This is a handler for unlock
 */
-void unlockTrapHandler() {
-   int pairID = PCB_getPairID(curPCB);
-   PCB_Type type = PCB_getType(curPCB);
+void unlockTrapHandler(Simulation_Ptr sim) {
+   PCB_Type type = PCB_getType(sim->cpu->curPCB);
    int mutexIndex;
-   Mutex_Ptr mutex;
-   
-   if (type == MutualResource) {
-      // (pairID / 2) * 2 is not same as pairID here
-      mutexIndex = (pairID / 2) * 2 + locateResource(curPCB->unlockArray);
-      mutex = mrMutexArray[mutexIndex];
-   } else { // for producer consumer pair
-      mutexIndex = pairID / 2;
-      mutex = mutexArray[mutexIndex];
-   }
-   
+   Mutex_Ptr mutex = pairMutex(sim, sim->cpu->curPCB->unlockArray, &mutexIndex);
    PCB_Ptr waitingPCB = Mutex_unlock(mutex);
-   int processID = PCB_getProcessID(curPCB);
+   int processID = PCB_getProcessID(sim->cpu->curPCB);
+   restorePriority(sim, sim->cpu->curPCB);
    
    if (waitingPCB != NULL) {
-      scheduler(Unlock_trap);
+      scheduler(sim, Unlock_trap);
    }
    
-   if (type == MutualResource) {
-      printf("PID %d: requested unlock on mutual resource mutex %d\n", processID, mutexIndex);
-   } else {
-      printf("PID %d: requested unlock on producer consumer mutex %d\n", processID, mutexIndex);
-   }
+   TRACE_LOG(sim->trace, Unlock_event, sim->cpuTime, type == MutualResource, processID, mutexIndex, 0);
 }
 
 /**
 * This is a handler for wait
 */
-void waitTrapHandler() {
-   int pairID = PCB_getPairID(curPCB);
-   int processID = PCB_getProcessID(curPCB);
-   Mutex_Ptr mutex = mutexArray[pairID / 2];
+void waitTrapHandler(Simulation_Ptr sim) {
+   int pairID = PCB_getPairID(sim->cpu->curPCB);
+   int processID = PCB_getProcessID(sim->cpu->curPCB);
+   PCPair_Ptr pair = SyncRegistry_pcPair(sim->sync, pairID / 2);
+   Mutex_Ptr mutex = &pair->mutex;
    CondVar_Ptr condVar;
    // producer ID is an even number, consumer ID is an odd number
    if (pairID % 2 == 0) {
-      condVar = writeCondVars[pairID / 2];
-      printf("PID %d requested condition wait on cond_write %d with mutex %d\n", processID, pairID / 2, pairID / 2);
+      condVar = &pair->writeCondVar;
+   } else {
+      condVar = &pair->readCondVar;
+   }
+   
+   if (pair->slots != NULL) {
+      // the producer only waits when the buffer is full, the consumer when it is empty
+      if (Semaphore_wait(pairID % 2 == 0 ? &pair->freeSlots : &pair->items, mutex)) {
+         return;
+      }
+      
+      TRACE_LOG(sim->trace, Buffer_wait_event, sim->cpuTime, pairID % 2, processID, pairID / 2, 0);
+   } else {
+      TRACE_LOG(sim->trace, Wait_event, sim->cpuTime, pairID % 2, processID, pairID / 2, 0);
+      CondVar_wait(condVar, mutex);
+   }
+   
+   if (pairID % 2 == 0) {
+      pair->producerBlocks++;
    } else {
-      condVar = readCondVars[pairID / 2];
-      printf("PID %d requested condition wait on cond_read %d with mutex %d\n", processID, pairID / 2, pairID / 2);
+      pair->consumerBlocks++;
    }
    
-   PCB_setPC(curPCB, pcRegister);
-   CondVar_wait(condVar, mutex);
-   scheduler(Wait_trap);
-   pcRegister = sysStack->pc;
+   PCB_setPC(sim->cpu->curPCB, sim->cpu->pcRegister);
+   restorePriority(sim, sim->cpu->curPCB);
+   blockPCB(sim);
+   scheduler(sim, Wait_trap);
+   sim->cpu->pcRegister = sim->cpu->sysStack.pc;
 }
 
 /**
 * This is a handler for signal
 */
-void signalTrapHandler() {
-   int pairID = PCB_getPairID(curPCB);
-   int processID = PCB_getProcessID(curPCB);
+void signalTrapHandler(Simulation_Ptr sim) {
+   int pairID = PCB_getPairID(sim->cpu->curPCB);
+   int processID = PCB_getProcessID(sim->cpu->curPCB);
+   PCPair_Ptr pair = SyncRegistry_pcPair(sim->sync, pairID / 2);
+   PCB_Ptr signaled = NULL;
+   Semaphore_Ptr semaphore = NULL;
    CondVar_Ptr condVar;
+   int locked;
    // producer ID is an even number, consumer ID is an odd number
    if (pairID % 2 == 0) {
-      condVar = readCondVars[pairID / 2];
-      printf("PID %d sent signal on cond_read %d\n", processID, pairID /2);
+      condVar = &pair->readCondVar;
    } else {
-      condVar = writeCondVars[pairID / 2];
-      printf("PID %d sent signal on cond_write %d\n", processID, pairID / 2);
+      condVar = &pair->writeCondVar;
+   }
+   
+   if (pair->slots != NULL) {
+      semaphore = pairID % 2 == 0 ? &pair->items : &pair->freeSlots;
+      condVar = &semaphore->waiters;
+      TRACE_LOG(sim->trace, Buffer_post_event, sim->cpuTime, pairID % 2 == 0, processID, pairID / 2, 0);
+   } else {
+      TRACE_LOG(sim->trace, Signal_event, sim->cpuTime, pairID % 2 == 0, processID, pairID / 2, 0);
+   }
+   
+   if (condVar->size > 0) {
+      signaled = condVar->head->thisPCB;
+   }
+   
+   locked = semaphore != NULL ? Semaphore_post(semaphore) : CondVar_signal(condVar);
+   
+   if (locked != MUTEX_LOCKED) {
+      inheritPriority(sim, signaled);
    }
    
-   CondVar_signal(condVar);
+   if (locked == MUTEX_DEADLOCKED) {
+      deadLockFound(sim, signaled, 0, pairID / 2);
+   }
 }
 
 /**
-* Used to determine whether or not a synchronizing trap handler should be called
+* Returns 1 when pcb one costs less to roll back than pcb two: it has a lower original
+* priority, or the same one and made less progress, or also the same progress and is younger
 */
-int synchronize(int pc) {
-   int i, found = 0;
+int cheaperVictim(PCB_Ptr one, PCB_Ptr two) {
+   uint64_t progressOne = (uint64_t) PCB_getTermCount(one) * MAX_PC + PCB_getPC(one);
+   uint64_t progressTwo = (uint64_t) PCB_getTermCount(two) * MAX_PC + PCB_getPC(two);
    
-   for (i = 0; i < 2; i++) {
-      if (curPCB->lockArray[i] == pc) {
-         found = 1;
-         lockTrapHandler();
-      }  
+   if (PCB_getOrigPriority(one) != PCB_getOrigPriority(two)) {
+      return PCB_getOrigPriority(one) > PCB_getOrigPriority(two);
    }
    
-   if (!found) {
-      for (i = 0; i < 2; i++) {
-         if (curPCB->unlockArray[i] == pc) {
-            found = 1;
-            unlockTrapHandler();
-         }
+   if (progressOne != progressTwo) {
+      return progressOne < progressTwo;
+   }
+   
+   return PCB_getProcessID(one) > PCB_getProcessID(two);
+}
+
+/**
+* Gives a mutex the victim holds to the next pcb waiting for it
+*/
+void releaseVictimMutex(Simulation_Ptr sim, Mutex_Ptr mutex, PCB_Ptr victim) {
+   if (mutex->curPCB == victim && Mutex_unlock(mutex) != NULL) {
+      wakePCB(sim, mutex->curPCB);
+   }
+}
+
+/**
+* Breaks the deadlock pcb closed: the cheapest pcb of the cycle stops waiting, releases
+* every mutex it holds, goes back to the pc before its first lock and is put into the
+* ready queue of the current cpu
+*/
+void recoverDeadLock(Simulation_Ptr sim, PCB_Ptr pcb) {
+   PCB_Ptr member = pcb, victim = pcb, holder;
+   unsigned int rollback, lost;
+   int i;
+   
+   do {
+      member->deadLocked = 0;
+      
+      if (cheaperVictim(member, victim)) {
+         victim = member;
       }
+      
+      member = member->waitingOn->curPCB;
+   } while (member != pcb);
+   
+   holder = victim->waitingOn->curPCB;
+   Mutex_cancel(victim);
+   
+   // a pcb can only hold the mutexes of its own pair
+   if (PCB_getType(victim) == MutualResource) {
+      releaseVictimMutex(sim, &SyncRegistry_mrPair(sim->sync, PCB_getPairID(victim) / 2)->resources[0], victim);
+      releaseVictimMutex(sim, &SyncRegistry_mrPair(sim->sync, PCB_getPairID(victim) / 2)->resources[1], victim);
+   } else {
+      releaseVictimMutex(sim, &SyncRegistry_pcPair(sim->sync, PCB_getPairID(victim) / 2)->mutex, victim);
    }
    
-   if (!found && curPCB->wait == pc) {
-       found = 1;
-       int pairID = PCB_getPairID(curPCB);
-       // producer ID is an even number, consumer ID is an odd number
-       if ((pairID % 2 == 0 && writableFlags[pairID / 2] == 0) || 
-         (pairID % 2 == 1 && writableFlags[pairID / 2] == 1)) {
-           waitTrapHandler();
-       }   
+   restorePriority(sim, holder);
+   restorePriority(sim, victim);
+   
+   // the lock at the rollback pc + 1 is taken again when the victim runs
+   rollback = PCB_getPC(victim);
+   
+   for (i = 0; i < 2; i++) {
+      if (victim->lockArray[i] > 0 && (unsigned int) victim->lockArray[i] - 1 < rollback) {
+         rollback = victim->lockArray[i] - 1;
+      }
    }
    
-   if (!found && curPCB->signal == pc) {
-       found = 1;
-       int pairID = PCB_getPairID(curPCB);
+   lost = PCB_getPC(victim) - rollback;
+   PCB_setPC(victim, rollback);
+   sim->recoveries++;
+   sim->lostWork += lost;
+   wakePCB(sim, victim);
+   TRACE_LOG(sim->trace, Recovery_event, sim->cpuTime, 0, PCB_getProcessID(victim), lost, 0);
+}
+
+void deadLockFound(Simulation_Ptr sim, PCB_Ptr pcb, int flag, int mutexIndex) {
+   SyncRegistry_noteDeadLock(sim->sync, pcb, sim->cpuTime);
+   TRACE_LOG(sim->trace, Deadlock_event, sim->cpuTime, flag, PCB_getProcessID(pcb), mutexIndex,
+      sim->sync->deadLocks[sim->sync->deadLockCount - 1].length);
+   
+   if (sim->config.deadLockRecovery) {
+      recoverDeadLock(sim, pcb);
+   }
+}
+
+/**
+* Used to determine whether or not a synchronizing trap handler should be called,
+* traps are the kinds of traps at the current pc
+*/
+int synchronize(Simulation_Ptr sim, int traps) {
+   if (traps & SYN_POINTS) {
+      sim->cpu->kernelStall += sim->config.overhead.trapEntry;
+   }
+   
+   if (traps & Lock_point) {
+      lockTrapHandler(sim);
+   } else if (traps & Unlock_point) {
+      unlockTrapHandler(sim);
+   } else if (traps & Wait_point) {
+       int pairID = PCB_getPairID(sim->cpu->curPCB);
+       PCPair_Ptr pair = SyncRegistry_pcPair(sim->sync, pairID / 2);
+       // producer ID is an even number, consumer ID is an odd number, with slots
+       // the semaphores of the buffer decide whether the pcb waits
+       if (pair->slots != NULL || (pairID % 2 == 0 && pair->writable == 0) || 
+         (pairID % 2 == 1 && pair->writable == 1)) {
+           waitTrapHandler(sim);
+       }   
+   } else if (traps & Signal_point) {
+       int pairID = PCB_getPairID(sim->cpu->curPCB);
        int index = pairID / 2;
+       PCPair_Ptr pair = SyncRegistry_pcPair(sim->sync, index);
+       int slots = sim->sync->bufferSlots;
        
-       if (pairID % 2 == 0) {
-           shareIntArray[index]++;
-           printf("Producer of pair %d wrote %d to the share space %d\n", index, shareIntArray[index], index);
-           writableFlags[index] = 0;
+       if (pair->slots != NULL) {
+           // a rolled back deadlock victim can reach its signal again without waiting
+           if (pairID % 2 == 0 && pair->count < slots) {
+               pair->sharedInt++;
+               pair->slots[(pair->head + pair->count++) % slots] = pair->sharedInt;
+               TRACE_LOG(sim->trace, Produce_event, sim->cpuTime, 0, index, pair->sharedInt, 0);
+           } else if (pairID % 2 == 1 && pair->count > 0) {
+               TRACE_LOG(sim->trace, Consume_event, sim->cpuTime, 0, index, pair->slots[pair->head], 0);
+               pair->head = (pair->head + 1) % slots;
+               pair->count--;
+               pair->consumed++;
+           }
+       } else if (pairID % 2 == 0) {
+           pair->sharedInt++;
+           TRACE_LOG(sim->trace, Produce_event, sim->cpuTime, 0, index, pair->sharedInt, 0);
+           pair->writable = 0;
        } else {
-           printf("Consumer of pair %d read %d from the share space %d\n", index, shareIntArray[index], index);
-           writableFlags[index] = 1;
+           TRACE_LOG(sim->trace, Consume_event, sim->cpuTime, 0, index, pair->sharedInt, 0);
+           pair->writable = 1;
+           pair->consumed++;
        }
        
-       signalTrapHandler();
+       signalTrapHandler(sim);
    }
    
-   return found;
+   return traps & SYN_POINTS;
+}
+
+void Simulation_printStats(Simulation_Ptr sim) {
+    printf("\nSimulation summary\n\n");
+    int i, j, metric, pairs;
+    char group[24];
+    DeadLock_Ptr deadLock;
+    uint64_t consumed, producerBlocks, consumerBlocks;
+    Stats stats;
+    
+    for (i = 0; i < sim->sync->deadLockCount; i++) {
+        deadLock = &sim->sync->deadLocks[i];
+        printf("deadlock detected at system time %" PRIu64 " for processes", deadLock->time);
+        
+        for (j = 0; j < deadLock->length; j++) {
+            printf("%s PID %d", j == 0 ? "" : j == deadLock->length - 1 ? " and" : ",", deadLock->PIDs[j]);
+        }
+        
+        printf("\n");
+    }
+    
+    if (sim->sync->deadLockCount == 0) {
+        printf("no deadlock detected\n");
+    }
+    
+    if (sim->config.deadLockRecovery) {
+        printf("%d deadlocks recovered, %llu cycles of work rolled back\n", sim->recoveries,
+            (unsigned long long) sim->lostWork);
+    }
+    
+    SyncRegistry_bufferTotals(sim->sync, &consumed, &producerBlocks, &consumerBlocks);
+    pairs = sim->sync->pcPairs;
+    printf("%llu items consumed, %.1f per million cycles, %.2f producer and %.2f consumer blocks per pair\n",
+        (unsigned long long) consumed, sim->cpuTime ? consumed * 1e6 / sim->cpuTime : 0.0,
+        pairs ? (double) producerBlocks / pairs : 0.0, pairs ? (double) consumerBlocks / pairs : 0.0);
+    printf("%d priority inversions", sim->inversions);
+    
+    if (sim->config.priorityInheritance) {
+        printf(", %d priorities inherited", sim->boosts);
+    }
+    
+    printf("\n");
+    Simulation_getStats(sim, &stats);
+    printf("cpu utilization: %.1f%% user, %.1f%% kernel, %.1f%% switching, %.1f%% idle\n", stats.userShare,
+        stats.kernelShare, stats.switchShare, stats.idleShare);
+    
+    printf("Random seed: %llu\n", (unsigned long long) sim->config.seed);
+    printf("Scheduling policy: %s\n", sim->policy->name);
+    printf("Total number of processes run: %d\n", sim->nextPCB_ID);
+    printf("%d processes completed, mean turnaround %.1f cycles\n", sim->completed,
+        sim->completed ? (double) sim->turnaroundTime / sim->completed : 0.0);
+    printf("%d processes in new queue\n", Queue_size(sim->newQueue));
+    int ready = 0;
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        ready += sim->policy->size(sim->cpus[i].readyQueue);
+    }
+    
+    printf("%d processes in ready queue\n", ready);
+    printf("%d processes in termination queue\n", Queue_size(sim->terminationQueue));
+    
+    for (i = 0; i < sim->config.devices; i++) {
+        printf("%d processes in IO waiting queue #%d\n", Device_size(sim->devices[i]), i + 1);
+    }
+    
+    for (i = 0; i < sim->config.devices; i++) {
+        printf("I/O device %d: %s, %llu requests served, mean service time %.1f cycles\n", i + 1,
+            Device_schedulerNames[sim->devices[i]->spec.scheduler], (unsigned long long) sim->devices[i]->served,
+            sim->devices[i]->served ? (double) sim->devices[i]->serviceTime / sim->devices[i]->served : 0.0);
+    }
+    
+    if (sim->config.cpus > 1) {
+        for (i = 0; i < sim->config.cpus; i++) {
+            printf("CPU %d: %d processes in ready queue, %d processes stolen\n", i,
+                sim->policy->size(sim->cpus[i].readyQueue), sim->cpus[i].steals);
+        }
+    }
+    
+    printf("\n%-27s %8s %10s %10s %10s %10s\n", "Latency in cycles", "count", "p50", "p99", "p99.9", "max");
+    
+    for (metric = 0; metric < LATENCY_METRICS; metric++) {
+        for (i = 0; i < sim->config.levels; i++) {
+            snprintf(group, sizeof(group), "priority %d", i);
+            printLatency(latencyNames[metric], group, sim->priorityLatency[metric][i]);
+        }
+        
+        for (i = 0; i < PCB_TYPES; i++) {
+            printLatency(latencyNames[metric], PCB_typeNames[i], sim->typeLatency[metric][i]);
+        }
+    }
+}
+
+void printLatency(const char *metric, const char *group, const Histogram *histogram) {
+    if (histogram->total == 0) {
+        return;
+    }
+    
+    printf("%-10s %-16s %8llu %10u %10u %10u %10u\n", metric, group, (unsigned long long) histogram->total,
+        Histogram_percentile(histogram, 50), Histogram_percentile(histogram, 99),
+        Histogram_percentile(histogram, 99.9), histogram->max);
+}
+
+void mergeLatency(Simulation_Ptr sim, Latency_Metric metric, Histogram_Ptr merged) {
+    int i;
+    Histogram_reset(merged);
+    
+    // every process is in exactly one type histogram
+    for (i = 0; i < PCB_TYPES; i++) {
+        Histogram_add(merged, sim->typeLatency[metric][i]);
+    }
+}
+
+void Config_default(Config_Ptr config, uint64_t seed) {
+    config->cycles = CYCLES;
+    config->timerQuantum = TIMER_QUANTUM;
+    config->starvationTime = STARVATION_TIME;
+    config->levels = PRIORITY_LEVELS;
+    config->refillFrequency = REFILL_FREQUENCY;
+    config->cpus = 1;
+    config->seed = seed;
+    config->engine = Event_engine;
+    config->workload = NULL;
+    config->policy = MLFQ_policy;
+    config->deadLockProne = 0;
+    config->deadLockRecovery = 0;
+    config->priorityInheritance = 0;
+    config->bufferSlots = 0;
+    config->devices = 2;
+    DeviceSpec_default(&config->deviceSpecs[0]);
+    DeviceSpec_default(&config->deviceSpecs[1]);
+    config->overhead.contextSwitch = 0;
+    config->overhead.timerISR = 0;
+    config->overhead.ioISR = 0;
+    config->overhead.trapEntry = 0;
+}
+
+int Overhead_parse(Overhead_Ptr overhead, const char *list) {
+    const char *keys[] = {"switch", "timer", "io", "trap"};
+    int *costs[] = {&overhead->contextSwitch, &overhead->timerISR, &overhead->ioISR, &overhead->trapEntry};
+    char *end;
+    size_t length;
+    unsigned long cost;
+    int i, found;
+    
+    *costs[0] = *costs[1] = *costs[2] = *costs[3] = 0;
+    
+    do {
+        length = strcspn(list, "=");
+        found = 0;
+        
+        for (i = 0; i < 4; i++) {
+            if (list[length] == '=' && strlen(keys[i]) == length && strncmp(list, keys[i], length) == 0) {
+                found = 1;
+                list += length + 1;
+                cost = strtoul(list, &end, 10);
+                
+                if (end == list || *list == '-' || cost > MAX_OVERHEAD || (*end != ',' && *end != '\0')) {
+                    return 0;
+                }
+                
+                *costs[i] = cost;
+            }
+        }
+        
+        if (!found) {
+            return 0;
+        }
+        
+        list = end + 1;
+    } while (*end == ',');
+    
+    return 1;
 }
 
 /**
-* Checks whether or not deadlock has happened
+* Creates a simulation with the given parameters and no processes
 */
-void deadLockMonitor() {
-    int i;
-    Mutex_Ptr mutexOne, mutexTwo;
-    PCB_Ptr pcbOne, pcbTwo;
-    
-    for (i = 0; i < 4; i++) {
-        mutexOne = mrMutexArray[2 * i];
-        mutexTwo = mrMutexArray[2 * i + 1];
-        pcbOne = mutexOne->curPCB;
-        pcbTwo = mutexTwo->curPCB;
+Simulation_Ptr createSimulation(const Config *config, Trace_Ptr trace) {
+    Simulation_Ptr sim = malloc(sizeof(Simulation));
+    int i, metric;
+    sim->config = *config;
+    sim->trace = trace;
+    sim->sampler = NULL;
+    // resolved once, every scheduling decision goes straight to the hooks of the policy
+    sim->policy = &Policy_table[sim->config.policy];
+    sim->nextPCB_ID = 1;
+    sim->completed = 0;
+    sim->turnaroundTime = 0;
+    sim->recoveries = 0;
+    sim->lostWork = 0;
+    sim->inversions = 0;
+    sim->boosts = 0;
+    sim->pcPairID = 0;
+    sim->mrPairID = 0;
+    sim->cpuTime = 0;
+    sim->cpus = malloc(sizeof(CPU) * sim->config.cpus);
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        sim->cpu = &sim->cpus[i];
+        sim->cpu->id = i;
+        sim->cpu->refillCounter = 0;
+        sim->cpu->steals = 0;
+        sim->cpu->kernelStall = 0;
+        sim->cpu->switchStall = 0;
+        sim->cpu->switches = 0;
+        sim->cpu->userCycles = 0;
+        sim->cpu->kernelCycles = 0;
+        sim->cpu->switchCycles = 0;
+        sim->cpu->idleCycles = 0;
+        sim->cpu->timerCounter = sim->config.timerQuantum;
+        // start every cpu with its own idle task
+        sim->cpu->idleTask = PCB_constructor(Compute);
+        PCB_setCurrentState(sim->cpu->idleTask, Idle);
+        sim->cpu->curPCB = sim->cpu->idleTask;
+        sim->cpu->pcRegister = PCB_getPC(sim->cpu->curPCB);
+        sim->cpu->swRegister = PCB_getSW(sim->cpu->curPCB);
+    }
+
+    sim->cpu = &sim->cpus[0];
+    sim->workloadRng = Rng_constructor(sim->config.seed, Workload_stream);
+    sim->trapRng = Rng_constructor(sim->config.seed, Trap_stream);
+    sim->ioRng = Rng_constructor(sim->config.seed, IO_stream);
+    sim->blockRng = Rng_constructor(sim->config.seed, Block_stream);
+    sim->pcbPool = PCBPool_constructor();
+    sim->newQueue = Queue_constructor();
+    sim->nextArrival = 0;
+    sim->sync = SyncRegistry_constructor(config->bufferSlots);
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        sim->cpus[i].readyQueue = sim->policy->constructor(sim->config.levels, sim->config.starvationTime);
+    }
+    
+    sim->terminationQueue = Queue_constructor();
+    
+    for (i = 0; i < sim->config.devices; i++) {
+        sim->devices[i] = Device_constructor(&sim->config.deviceSpecs[i]);
+    }
+    
+    for (metric = 0; metric < LATENCY_METRICS; metric++) {
+        sim->priorityLatency[metric] = malloc(sizeof(Histogram_Ptr) * sim->config.levels);
+        
+        for (i = 0; i < sim->config.levels; i++) {
+            sim->priorityLatency[metric][i] = Histogram_constructor();
+        }
         
-        if ((pcbOne != NULL && pcbTwo != NULL) && pcbOne != pcbTwo) {
-            deadLockFlags[2 * i] = PCB_getProcessID(pcbOne);
-            deadLockFlags[2 * i + 1] = PCB_getProcessID(pcbTwo);
-        } 
+        for (i = 0; i < PCB_TYPES; i++) {
+            sim->typeLatency[metric][i] = Histogram_constructor();
+        }
     }
+    
+    return sim;
+}
+
+Simulation_Ptr Simulation_constructor(const Config *config, Trace_Ptr trace) {
+    Simulation_Ptr sim = createSimulation(config, trace);
+    
+    if (sim->config.workload == NULL) {
+        initializeNewQueue(sim);
+    } else {
+        admitArrivals(sim);
+    }
+    
+    return sim;
 }
 
 /**
-* Prints out statistics for this simulation
+* Fills fingerprint with whether the workload exists, its number of records and a hash of
+* them and of their io traps, so a snapshot is only restored with the workload file it was
+* taken with
 */
-void stats() {
-    printf("\nSimulation summary\n\n");
-    int i, flagOne, flagTwo, hasDeadLock = 0;
+void workloadFingerprint(Workload_Ptr workload, uint64_t *fingerprint) {
+    const unsigned char *bytes;
+    uint64_t i, length;
     
-    for (i = 0; i < 4; i++) {
-        flagOne = deadLockFlags[2 * i];
-        flagTwo = deadLockFlags[2 * i + 1];
-        
-        if (flagOne != -1) {
-            printf("deadlock detected for processes PID %d and PID %d\n", flagOne, flagTwo);
-            hasDeadLock = 1;
+    fingerprint[0] = workload != NULL;
+    fingerprint[1] = workload != NULL ? workload->count : 0;
+    fingerprint[2] = 14695981039346656037ULL;
+    bytes = workload != NULL ? (const unsigned char *) workload->records : NULL;
+    // the io traps follow the records in the mapping
+    length = workload != NULL ? workload->count * sizeof(WorkloadRecord) + workload->trapCount * sizeof(IoTrap) : 0;
+    
+    // FNV-1a
+    for (i = 0; i < length; i++) {
+        fingerprint[2] = (fingerprint[2] ^ bytes[i]) * 1099511628211ULL;
+    }
+}
+
+/**
+* Returns 1 if a simulation can be created with the config read from a snapshot
+*/
+int validConfig(const Config *config) {
+    int i;
+    
+    if (config->cpus < 1 || config->cpus > MAX_CPUS || config->policy >= POLICIES || config->timerQuantum < 1
+        || config->levels < 1 || config->levels > MAX_PRIORITY_LEVELS
+        || config->refillFrequency < 0 || config->bufferSlots < 0 || config->bufferSlots > SYNC_MAX_SLOTS
+        || config->devices < 1 || config->devices > MAX_DEVICES || (config->engine != Cycle_engine && config->engine != Event_engine)) {
+        return 0;
+    }
+    
+    for (i = 0; i < config->devices; i++) {
+        if (config->deviceSpecs[i].depth < 1 || config->deviceSpecs[i].depth > DEVICE_MAX_DEPTH
+            || config->deviceSpecs[i].scheduler >= DEVICE_SCHEDULERS) {
+            return 0;
         }
     }
     
-    if (!hasDeadLock) {
-        printf("no deadlock detected\n");
+    return 1;
+}
+
+/**
+* Writes or reads the counters of the simulation that aren't in any other structure, depending on the
+* given function
+*/
+void transferCounters(Simulation_Ptr sim, Snapshot_Ptr snapshot, void (*transfer)(Snapshot_Ptr, void *, size_t)) {
+    int i, metric;
+    
+    transfer(snapshot, &sim->nextPCB_ID, sizeof(sim->nextPCB_ID));
+    transfer(snapshot, &sim->completed, sizeof(sim->completed));
+    transfer(snapshot, &sim->turnaroundTime, sizeof(sim->turnaroundTime));
+    transfer(snapshot, &sim->recoveries, sizeof(sim->recoveries));
+    transfer(snapshot, &sim->lostWork, sizeof(sim->lostWork));
+    transfer(snapshot, &sim->inversions, sizeof(sim->inversions));
+    transfer(snapshot, &sim->boosts, sizeof(sim->boosts));
+    transfer(snapshot, &sim->cpuTime, sizeof(sim->cpuTime));
+    transfer(snapshot, &sim->nextArrival, sizeof(sim->nextArrival));
+    transfer(snapshot, &sim->pcPairID, sizeof(sim->pcPairID));
+    transfer(snapshot, &sim->mrPairID, sizeof(sim->mrPairID));
+    transfer(snapshot, sim->workloadRng, sizeof(Rng));
+    transfer(snapshot, sim->trapRng, sizeof(Rng));
+    transfer(snapshot, sim->ioRng, sizeof(Rng));
+    transfer(snapshot, sim->blockRng, sizeof(Rng));
+    
+    for (metric = 0; metric < LATENCY_METRICS; metric++) {
+        for (i = 0; i < sim->config.levels; i++) {
+            transfer(snapshot, sim->priorityLatency[metric][i], sizeof(Histogram));
+        }
+        
+        for (i = 0; i < PCB_TYPES; i++) {
+            transfer(snapshot, sim->typeLatency[metric][i], sizeof(Histogram));
+        }
     }
     
-    printf("Total number of processes run: %d\n", nextPCB_ID);
-    printf("%d processes in new queue\n", Queue_size(newQueue));
-    printf("%d processes in ready queue\n", PriorityQueue_size(readyQueue));
-    printf("%d processes in termination queue\n", Queue_size(terminationQueue));
-    printf("%d processes in IO waiting queue #1\n", Queue_size(ioOneWaitQueue));
-    printf("%d processes in IO waiting queue #2\n", Queue_size(ioTwoWaitQueue));       
+    for (i = 0; i < sim->config.cpus; i++) {
+        transfer(snapshot, &sim->cpus[i].refillCounter, sizeof(int));
+        transfer(snapshot, &sim->cpus[i].swRegister, sizeof(int));
+        transfer(snapshot, &sim->cpus[i].pcRegister, sizeof(unsigned int));
+        transfer(snapshot, &sim->cpus[i].sysStack, sizeof(SysStack));
+        transfer(snapshot, &sim->cpus[i].timerCounter, sizeof(int));
+        transfer(snapshot, &sim->cpus[i].steals, sizeof(int));
+        transfer(snapshot, &sim->cpus[i].kernelStall, sizeof(int));
+        transfer(snapshot, &sim->cpus[i].switchStall, sizeof(int));
+        transfer(snapshot, &sim->cpus[i].switches, sizeof(uint64_t));
+        transfer(snapshot, &sim->cpus[i].userCycles, sizeof(uint64_t));
+        transfer(snapshot, &sim->cpus[i].kernelCycles, sizeof(uint64_t));
+        transfer(snapshot, &sim->cpus[i].switchCycles, sizeof(uint64_t));
+        transfer(snapshot, &sim->cpus[i].idleCycles, sizeof(uint64_t));
+    }
 }
 
 /**
-* This initializes some variables that are used in this program.
+* Adapts Snapshot_write() to transferCounters()
 */
-void initialize() {
-    timerCounter = TIMER_QUANTUM;
-    // start this program with an idle task
-    idleTask = PCB_constructor(Compute);
-    PCB_setCurrentState(idleTask, Idle);
-    curPCB = idleTask;
-    pcRegister = PCB_getPC(curPCB);
-    swRegister = PCB_getSW(curPCB);
+void writeCounter(Snapshot_Ptr snapshot, void *data, size_t size) {
+    Snapshot_write(snapshot, data, size);
+}
 
-    sysStack = malloc(sizeof(SysStack));
-    newQueue = Queue_constructor();
-    initializeNewQueue();
-    readyQueue = PriorityQueue_constructor();
-    terminationQueue = Queue_constructor();
-    ioOneWaitQueue = Queue_constructor();
-    ioTwoWaitQueue = Queue_constructor();
+int Simulation_save(Simulation_Ptr sim, const char *fileName) {
+    Snapshot_Ptr snapshot = Snapshot_create(fileName);
+    PCB_Ptr idleTasks[MAX_CPUS];
+    uint32_t configSize = sizeof(Config);
+    uint64_t fingerprint[3];
+    Config config;
+    int i, current = sim->cpu - sim->cpus;
     
-    int i;
+    if (snapshot == NULL) {
+        return 0;
+    }
+    
+    // the workload is mapped from its file again when the snapshot is restored
+    memcpy(&config, &sim->config, sizeof(Config));
+    config.workload = NULL;
+    workloadFingerprint(sim->config.workload, fingerprint);
+    Snapshot_write(snapshot, &configSize, sizeof(configSize));
+    Snapshot_write(snapshot, &config, sizeof(Config));
+    Snapshot_write(snapshot, fingerprint, sizeof(fingerprint));
+    Snapshot_write(snapshot, &current, sizeof(current));
+    transferCounters(sim, snapshot, writeCounter);
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        idleTasks[i] = sim->cpus[i].idleTask;
+    }
+    
+    // every pcb is written once, the queues below only refer to it
+    Snapshot_writePool(snapshot, sim->pcbPool, idleTasks, sim->config.cpus);
     
-    for (i = 0; i < 4; i++) {
-        mutexArray[i] = Mutex_constructor();
-        readCondVars[i] = CondVar_constructor();
-        writeCondVars[i] = CondVar_constructor();
-        shareIntArray[i] = 0;
-        writableFlags[i] = 1;
+    for (i = 0; i < sim->config.cpus; i++) {
+        Snapshot_writePCB(snapshot, sim->cpus[i].curPCB);
+        sim->policy->save(sim->cpus[i].readyQueue, snapshot);
     }
     
-    for (i = 0; i < 8; i++) {
-        mrMutexArray[i] = Mutex_constructor();
-        deadLockFlags[i] = -1;
+    Queue_save(sim->newQueue, snapshot);
+    Queue_save(sim->terminationQueue, snapshot);
+    
+    for (i = 0; i < sim->config.devices; i++) {
+        Device_save(sim->devices[i], snapshot);
     }
+    
+    SyncRegistry_save(sim->sync, snapshot);
+    return Snapshot_close(snapshot);
+}
+
+Simulation_Ptr Simulation_restore(const char *fileName, Workload_Ptr workload) {
+    Snapshot_Ptr snapshot = Snapshot_open(fileName);
+    PCB_Ptr idleTasks[MAX_CPUS];
+    uint32_t configSize;
+    uint64_t fingerprint[3], expected[3];
+    Simulation_Ptr sim;
+    Config config;
+    int i, current;
+    
+    if (snapshot == NULL) {
+        return NULL;
+    }
+    
+    Snapshot_read(snapshot, &configSize, sizeof(configSize));
+    
+    if (configSize == sizeof(Config)) {
+        Snapshot_read(snapshot, &config, sizeof(Config));
+    }
+    
+    Snapshot_read(snapshot, fingerprint, sizeof(fingerprint));
+    Snapshot_read(snapshot, &current, sizeof(current));
+    workloadFingerprint(workload, expected);
+    
+    if (snapshot->failed || configSize != sizeof(Config) || memcmp(fingerprint, expected, sizeof(expected)) != 0
+        || !validConfig(&config) || current < 0 || current >= config.cpus) {
+        Snapshot_close(snapshot);
+        return NULL;
+    }
+    
+    config.workload = workload;
+    sim = createSimulation(&config, NULL);
+    transferCounters(sim, snapshot, Snapshot_read);
+    sim->cpu = &sim->cpus[current];
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        idleTasks[i] = sim->cpus[i].idleTask;
+    }
+    
+    Snapshot_readPool(snapshot, sim->pcbPool, idleTasks, sim->config.cpus);
+    
+    for (i = 0; i < sim->config.cpus && !snapshot->failed; i++) {
+        sim->cpus[i].curPCB = Snapshot_readPCB(snapshot);
+        
+        if (sim->cpus[i].curPCB == NULL) {
+            sim->cpus[i].curPCB = sim->cpus[i].idleTask;
+            Snapshot_fail(snapshot);
+        }
+        
+        sim->policy->restore(sim->cpus[i].readyQueue, snapshot);
+    }
+    
+    Queue_restore(sim->newQueue, snapshot);
+    Queue_restore(sim->terminationQueue, snapshot);
+    
+    for (i = 0; i < sim->config.devices; i++) {
+        Device_restore(sim->devices[i], snapshot);
+    }
+    
+    SyncRegistry_restore(sim->sync, snapshot);
+    
+    if (!Snapshot_close(snapshot)) {
+        Simulation_destructor(sim);
+        return NULL;
+    }
+    
+    return sim;
+}
+
+void Simulation_setTrace(Simulation_Ptr sim, Trace_Ptr trace) {
+    sim->trace = trace;
+}
+
+void Simulation_setSampler(Simulation_Ptr sim, Sampler_Ptr sampler) {
+    SampleRecord totals;
+    sim->sampler = sampler;
+    
+    if (sampler != NULL) {
+        sampleTotals(sim, &totals);
+        Sampler_start(sampler, &totals);
+    }
+}
+
+void Simulation_destructor(Simulation_Ptr sim) {
+    int i, metric;
+    Queue_destructor(sim->newQueue);
+    Queue_destructor(sim->terminationQueue);
+    
+    for (i = 0; i < sim->config.devices; i++) {
+        Device_destructor(sim->devices[i]);
+    }
+    
+    // all pcbs except the idle tasks come from the pool, no matter which queue they are in
+    PCBPool_destructor(sim->pcbPool);
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        sim->policy->destructor(sim->cpus[i].readyQueue);
+        PCB_destructor(sim->cpus[i].idleTask);
+    }
+    
+    free(sim->cpus);
+    Rng_destructor(sim->workloadRng);
+    Rng_destructor(sim->trapRng);
+    Rng_destructor(sim->ioRng);
+    Rng_destructor(sim->blockRng);
+    SyncRegistry_deconstructor(sim->sync);
+    
+    for (metric = 0; metric < LATENCY_METRICS; metric++) {
+        for (i = 0; i < sim->config.levels; i++) {
+            Histogram_destructor(sim->priorityLatency[metric][i]);
+        }
+        
+        free(sim->priorityLatency[metric]);
+        
+        for (i = 0; i < PCB_TYPES; i++) {
+            Histogram_destructor(sim->typeLatency[metric][i]);
+        }
+    }
+    
+    free(sim);
 }
 
 /**
-* free the memory used by the data structures in this program
+* Spends up to the given number of cycles of the current cpu on the kernel work it owes, then
+* on the context switches it owes, and returns number of cycles left for its pcb. All the cycles
+* are counted in the utilization of the cpu.
 */
-void finalize() {
-    Queue_destructor(newQueue);
-    PriorityQueue_destructor(readyQueue);
-    Queue_destructor(terminationQueue);
-    Queue_destructor(ioOneWaitQueue);
-    Queue_destructor(ioTwoWaitQueue);
+unsigned int payOverhead(Simulation_Ptr sim, unsigned int cycles) {
+    CPU_Ptr cpu = sim->cpu;
+    unsigned int kernel = (unsigned int) cpu->kernelStall < cycles ? (unsigned int) cpu->kernelStall : cycles;
+    unsigned int context = (unsigned int) cpu->switchStall < cycles - kernel ? (unsigned int) cpu->switchStall : cycles - kernel;
     
-    // avoid to free the same thing twice
-    if (curPCB == idleTask) {
-        free(curPCB);
+    cpu->kernelStall -= kernel;
+    cpu->kernelCycles += kernel;
+    cpu->switchStall -= context;
+    cpu->switchCycles += context;
+    cycles -= kernel + context;
+    
+    if (PCB_getCurrentState(cpu->curPCB) == Idle) {
+        cpu->idleCycles += cycles;
     } else {
-        free(curPCB);
-        free(idleTask);
+        cpu->userCycles += cycles;
     }
     
-    free(sysStack);
+    return cycles;
+}
+
+/**
+* Runs the part of one cycle that belongs to the current cpu. I/O devices are
+* driven by cpu 0.
+*/
+void executeCPUCycle(Simulation_Ptr sim) {
+    int device, traps = 0;
+    
+    // while the kernel works, devices and ready queues go on but the pcb and the timer wait
+    if (payOverhead(sim, 1) == 0) {
+        if (sim->cpu->id == 0) {
+            ioTimers(sim);
+        }
+        
+        sim->policy->age(sim->cpu->readyQueue, 1);
+        return;
+    }
+    
+    sim->cpu->pcRegister += 1;
+    
+    // one comparison tells whether this pc has any trap of the current pcb
+    if (sim->cpu->pcRegister == PCB_getNextTrapPC(sim->cpu->curPCB)) {
+        traps = PCB_takeTrap(sim->cpu->curPCB, &device);
+    }
+    
+    // for synchronization
+    if (synchronize(sim, traps)) return;
+    
+    // for timer interrupt, a policy that doesn't preempt lets the running pcb keep the cpu
+    if (timer(sim)) {
+        sim->cpu->kernelStall += sim->config.overhead.timerISR;
+        
+        if (PCB_getCurrentState(sim->cpu->curPCB) == Idle || sim->policy->onTick(sim->cpu->readyQueue, sim->cpu->curPCB)) {
+            sim->cpu->sysStack.pc = sim->cpu->pcRegister;
+            sim->cpu->sysStack.sw = sim->cpu->swRegister;
+            timerInterruptServiceRoutine(sim);
+            return;
+        }
+        
+        sim->cpu->timerCounter = sim->policy->timeSlice(sim->cpu->readyQueue, sim->cpu->curPCB, sim->cpu->timerCounter);
+    }
+    
+    // for I/O completion interrupt
+    if (sim->cpu->id == 0) {
+        ioTimers(sim);
+    }
+
+    // for io request trap
+    if (PCB_getCurrentState(sim->cpu->curPCB) != Idle && (traps & IO_point)) {
+        sim->cpu->sysStack.pc = sim->cpu->pcRegister;
+        sim->cpu->sysStack.sw = sim->cpu->swRegister;
+        ioTrapHandler(sim, device + 1);
+        return;
+    }
+    
+    // for process termination trap
+    if ((PCB_getTermCount(sim->cpu->curPCB) + 1 == PCB_getTerminate(sim->cpu->curPCB)) && (sim->cpu->pcRegister == MAX_PC)) {
+        terminationTrapHandler(sim);
+    } else if (sim->cpu->pcRegister == MAX_PC) {
+        // wrap around right away instead of when the pcb is saved, a quantum longer than
+        // the first trap pc would otherwise run past the traps of the next round
+        PCB_setPC(sim->cpu->curPCB, sim->cpu->pcRegister);
+        sim->cpu->pcRegister = PCB_getPC(sim->cpu->curPCB);
+        PCB_seekTrap(sim->cpu->curPCB, sim->cpu->pcRegister);
+    }
+    
+    sim->policy->age(sim->cpu->readyQueue, 1);
+}
+
+/**
+* Runs one cycle of all simulated cpus, in order of their ids, after the processes
+* of the workload file that arrive in this cycle are created
+*/
+void executeCycle(Simulation_Ptr sim) {
     int i;
+    Trace_setCPU(sim->trace, 0);
+    admitArrivals(sim);
     
-    for (i = 0; i < 4; i++) {
-        Mutex_deconstructor(mutexArray[i]);
-        CondVar_deconstructor(readCondVars[i]);
-        CondVar_deconstructor(writeCondVars[i]);
+    for (i = 0; i < sim->config.cpus; i++) {
+        sim->cpu = &sim->cpus[i];
+        Trace_setCPU(sim->trace, i);
+        executeCPUCycle(sim);
     }
+}
+
+void sampleTotals(Simulation_Ptr sim, SampleRecord *record) {
+    int i;
+    // zeroed as a whole, so binary records hold no stray padding bytes
+    memset(record, 0, sizeof(SampleRecord));
+    record->time = sim->cpuTime;
+    record->mutexWaiters = sim->sync->mutexWaiters;
+    record->terminations = sim->completed;
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        sim->policy->levelSizes(sim->cpus[i].readyQueue, record->ready);
+        record->switches += sim->cpus[i].switches;
+        record->idleCycles += sim->cpus[i].idleCycles;
+    }
+    
+    for (i = 0; i < sim->config.devices; i++) {
+        record->io[i] = Device_size(sim->devices[i]);
+    }
+}
+
+/**
+* Hands the sampler a sample when the system time has reached the time of its next one
+*/
+void takeSample(Simulation_Ptr sim) {
+    SampleRecord totals;
     
-    for (i = 0; i < 8; i++) {
-        Mutex_deconstructor(mrMutexArray[i]);
+    if (sim->sampler != NULL && sim->cpuTime == sim->sampler->next) {
+        sampleTotals(sim, &totals);
+        Sampler_add(sim->sampler, &totals);
     }
 }
 
 /**
-* This main simulates CPU.
+* Lowers quiet to the number of cycles left before pc reaches trapPC, when trapPC is still ahead
 */
-int main(void) {
-    int isIOOneCompleted, isIOTwoCompleted, deviceNum;
-    initialize();
+unsigned int untilTrap(Simulation_Ptr sim, unsigned int quiet, unsigned int trapPC) {
+    if (trapPC > sim->cpu->pcRegister && trapPC - sim->cpu->pcRegister - 1 < quiet) {
+        return trapPC - sim->cpu->pcRegister - 1;
+    }
+    
+    return quiet;
+}
 
-    for (cpuTime = 0; cpuTime < CYCLES; cpuTime++) {
-   
-        pcRegister += 1;
+/**
+* Returns number of cycles, starting from current one and ending before end, in which no interrupt,
+* trap or promotion can happen on any cpu, so they only advance pcs and the counters
+*/
+unsigned int quietCycles(Simulation_Ptr sim, uint64_t end) {
+    Workload_Ptr workload = sim->config.workload;
+    // the queues and devices age by at most UINT_MAX cycles at once
+    unsigned int quiet = end - sim->cpuTime < UINT_MAX ? (unsigned int) (end - sim->cpuTime) : UINT_MAX;
+    unsigned int starvation, running;
+    int i;
+    
+    // an I/O device only interrupts when the counter of a request it serves is 0
+    for (i = 0; i < sim->config.devices; i++) {
+        if (Device_quietCycles(sim->devices[i]) < quiet) {
+            quiet = Device_quietCycles(sim->devices[i]);
+        }
+    }
+    
+    // the next sample has to see the queues as they are at its time
+    if (sim->sampler != NULL && sim->sampler->next - sim->cpuTime < quiet) {
+        quiet = sim->sampler->next - sim->cpuTime;
+    }
+    
+    // the next process of the workload file arrives at its arrival time
+    if (workload != NULL && sim->nextArrival < workload->count && workload->records[sim->nextArrival].arrival - sim->cpuTime < quiet) {
+        quiet = workload->records[sim->nextArrival].arrival - sim->cpuTime;
+    }
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        sim->cpu = &sim->cpus[i];
+        starvation = sim->policy->quietCycles(sim->cpu->readyQueue);
         
-        PCB_Type type = PCB_getType(curPCB);
-        // for synchronization
-        if ((type == ProducerConsumer || type == MutualResource) && synchronize(pcRegister)) continue;
+        running = sim->cpu->timerCounter;
+        running = untilTrap(sim, running, PCB_getNextTrapPC(sim->cpu->curPCB));
         
-        // for timer interrupt
-        if (timer()) {
-            sysStack->pc = pcRegister;
-            sysStack->sw = swRegister;
-            timerInterruptServiceRoutine();
-            continue;
-        }
+        // the pc terminates the pcb or wraps around at MAX_PC
+        running = untilTrap(sim, running, MAX_PC);
         
-        // for I/O completion interrupt
-        isIOOneCompleted = ioOneTimer();
-        isIOTwoCompleted = ioTwoTimer();
-        if (isIOOneCompleted) {
-            ioInterruptServiceRoutine(1);
+        // the pc and the timer only start counting once the kernel work the cpu owes is done
+        if ((uint64_t) running + sim->cpu->kernelStall + sim->cpu->switchStall < quiet) {
+            quiet = running + sim->cpu->kernelStall + sim->cpu->switchStall;
         }
         
-        if (isIOTwoCompleted) {
-            ioInterruptServiceRoutine(2);
+        if (starvation < quiet) {
+            quiet = starvation;
         }
+    }
+    
+    return quiet;
+}
+
+/**
+* Advances the simulation over the given number of quiet cycles at once
+*/
+void skipCycles(Simulation_Ptr sim, unsigned int cycles) {
+    unsigned int running;
+    int i;
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        sim->cpu = &sim->cpus[i];
+        running = payOverhead(sim, cycles);
+        sim->cpu->pcRegister += running;
+        sim->cpu->timerCounter -= running;
+        sim->policy->age(sim->cpu->readyQueue, cycles);
+    }
+    
+    for (i = 0; i < sim->config.devices; i++) {
+        Device_advance(sim->devices[i], cycles);
+    }
+    
+    sim->cpuTime += cycles;
+}
 
-        // for io request trap
-        if (PCB_getCurrentState(curPCB) != Idle) {
-            deviceNum = checkIOTrapDevice(pcRegister);
+int Simulation_configure(Simulation_Ptr sim, const Config *config) {
+    int i;
+    
+    if (config->cpus != sim->config.cpus || config->seed != sim->config.seed || config->workload != sim->config.workload
+        || config->policy != sim->config.policy || config->levels != sim->config.levels
+        || config->bufferSlots != sim->config.bufferSlots || config->devices != sim->config.devices
+        || memcmp(config->deviceSpecs, sim->config.deviceSpecs, sizeof(DeviceSpec) * config->devices) != 0) {
+        return 0;
+    }
+    
+    sim->config = *config;
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        sim->policy->setStarvationTime(sim->cpus[i].readyQueue, sim->config.starvationTime);
+    }
+    
+    return 1;
+}
+
+void Simulation_runUntil(Simulation_Ptr sim, uint64_t time) {
+    if (sim->config.engine == Cycle_engine) {
+        for (; sim->cpuTime < time; sim->cpuTime++) {
+            takeSample(sim);
+            executeCycle(sim);
+        }
+    } else {
+        while (sim->cpuTime < time) {
+            skipCycles(sim, quietCycles(sim, time));
+            takeSample(sim);
             
-            if (deviceNum > 0) {
-                sysStack->pc = pcRegister;
-                sysStack->sw = swRegister;
-                ioTrapHandler(deviceNum);
-                continue;
+            if (sim->cpuTime < time) {
+                executeCycle(sim);
+                sim->cpuTime++;
             }
         }
-        
-        // for process termination trap
-        if ((PCB_getTermCount(curPCB) + 1 == PCB_getTerminate(curPCB)) && (pcRegister == MAX_PC)) {
-            terminationTrapHandler();
-        }
-        
-        PriorityQueue_preventStarvation(readyQueue);
-        
-        if (cpuTime % 2000 == 0) {
-            deadLockMonitor();
-        }
     }
     
-    stats();
-    finalize(); 
-    return 0;
+    takeSample(sim);
+}
+
+unsigned int Simulation_step(Simulation_Ptr sim, unsigned int cycles) {
+    uint64_t start = sim->cpuTime;
+    Simulation_runUntil(sim, cycles < UINT64_MAX - start ? start + cycles : UINT64_MAX);
+    return (unsigned int) (sim->cpuTime - start);
+}
+
+void Simulation_run(Simulation_Ptr sim) {
+    Simulation_runUntil(sim, sim->config.cycles);
+}
+
+uint64_t Simulation_getTime(Simulation_Ptr sim) {
+    return sim->cpuTime;
+}
+
+void Simulation_getStats(Simulation_Ptr sim, Stats_Ptr stats) {
+    Histogram merged;
+    uint64_t consumed, producerBlocks, consumerBlocks;
+    uint64_t user = 0, kernel = 0, context = 0, idle = 0, total;
+    int i;
+    stats->time = sim->cpuTime;
+    stats->processesRun = sim->nextPCB_ID;
+    stats->newQueue = Queue_size(sim->newQueue);
+    stats->readyQueue = 0;
+    stats->terminationQueue = Queue_size(sim->terminationQueue);
+    stats->ioWaitQueue = 0;
+    stats->ioServed = 0;
+    stats->deadlocks = sim->sync->deadLockCount;
+    stats->recoveries = sim->recoveries;
+    stats->lostWork = sim->lostWork;
+    stats->inversions = sim->inversions;
+    stats->boosts = sim->boosts;
+    stats->steals = 0;
+    stats->completed = sim->completed;
+    stats->meanTurnaround = sim->completed ? (double) sim->turnaroundTime / sim->completed : 0;
+    mergeLatency(sim, Turnaround_latency, &merged);
+    stats->turnaroundP99 = Histogram_percentile(&merged, 99);
+    mergeLatency(sim, Response_latency, &merged);
+    stats->responseP99 = Histogram_percentile(&merged, 99);
+    mergeLatency(sim, Inversion_latency, &merged);
+    stats->inversionP99 = Histogram_percentile(&merged, 99);
+    SyncRegistry_bufferTotals(sim->sync, &consumed, &producerBlocks, &consumerBlocks);
+    stats->itemsPerMillion = sim->cpuTime ? consumed * 1e6 / sim->cpuTime : 0;
+    stats->blocksPerPair = sim->sync->pcPairs ? (double) (producerBlocks + consumerBlocks) / sim->sync->pcPairs : 0;
+    
+    for (i = 0; i < sim->config.cpus; i++) {
+        stats->readyQueue += sim->policy->size(sim->cpus[i].readyQueue);
+        stats->steals += sim->cpus[i].steals;
+        user += sim->cpus[i].userCycles;
+        kernel += sim->cpus[i].kernelCycles;
+        context += sim->cpus[i].switchCycles;
+        idle += sim->cpus[i].idleCycles;
+    }
+    
+    total = user + kernel + context + idle;
+    stats->userShare = total ? 100.0 * user / total : 0;
+    stats->kernelShare = total ? 100.0 * kernel / total : 0;
+    stats->switchShare = total ? 100.0 * context / total : 0;
+    stats->idleShare = total ? 100.0 * idle / total : 0;
+    
+    for (i = 0; i < sim->config.devices; i++) {
+        stats->ioWaitQueue += Device_size(sim->devices[i]);
+        stats->ioServed += sim->devices[i]->served;
+    }
 }
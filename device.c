@@ -0,0 +1,373 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "device.h"
+
+// names of Device_Scheduler values, used in specs and in the summary
+const char *Device_schedulerNames[] = {"fifo", "sstf", "scan", "prio"};
+
+/**
+* parses a number, or two numbers joined by -, from value into min and max, returns 0 when value isn't valid
+*/
+int parseServiceRange(const char *value, unsigned int *min, unsigned int *max);
+
+/**
+* parses one number from value into number, returns 0 when value isn't valid or number is out of [low, high]
+*/
+int parseDeviceNumber(const char *value, unsigned int *number, unsigned int low, unsigned int high);
+
+/**
+* makes the given free slot serve the pcb for a service time drawn from rng plus the seek
+* to its block, where the head moves
+*/
+void startRequest(Device_Ptr device, int slot, PCB_Ptr pcb, Rng_Ptr rng, int quantum);
+
+/**
+* removes the waiting request the scheduler of the device serves next, NULL when none is waiting
+*/
+PCB_Ptr pickRequest(Device_Ptr device);
+
+/**
+* returns number of blocks between the head of the device and the block of the pcb
+*/
+unsigned int seekDistance(Device_Ptr device, PCB_Ptr pcb);
+
+void DeviceSpec_default(DeviceSpec_Ptr spec) {
+   spec->scheduler = FIFO_scheduler;
+   spec->distribution = Quantum_service;
+   spec->minService = 3;
+   spec->maxService = 5;
+   spec->seekCycles = 0;
+   spec->blocks = 1000;
+   spec->depth = 1;
+}
+
+int parseServiceRange(const char *value, unsigned int *min, unsigned int *max) {
+   char *end;
+   unsigned long low = strtoul(value, &end, 10), high = low;
+
+   if (end == value || *value == '-') {
+      return 0;
+   }
+
+   if (*end == '-') {
+      value = end + 1;
+      high = strtoul(value, &end, 10);
+
+      if (end == value || *value == '-') {
+         return 0;
+      }
+   }
+
+   if (*end != '\0' || low > high || high > INT_MAX) {
+      return 0;
+   }
+
+   *min = low;
+   *max = high;
+   return 1;
+}
+
+int parseDeviceNumber(const char *value, unsigned int *number, unsigned int low, unsigned int high) {
+   char *end;
+   unsigned long parsed = strtoul(value, &end, 10);
+
+   if (end == value || *value == '-' || *end != '\0' || parsed < low || parsed > high) {
+      return 0;
+   }
+
+   *number = parsed;
+   return 1;
+}
+
+int DeviceSpec_parse(DeviceSpec_Ptr spec, const char *list) {
+   char copy[256], *token, *value, *next;
+   unsigned int number = 0;
+   int i, valid;
+
+   if (strlen(list) >= sizeof(copy)) {
+      return 0;
+   }
+
+   strcpy(copy, list);
+   DeviceSpec_default(spec);
+
+   for (token = copy; token != NULL; token = next) {
+      next = strchr(token, ',');
+
+      if (next != NULL) {
+         *next++ = '\0';
+      }
+
+      value = strchr(token, '=');
+      valid = 0;
+
+      if (value == NULL) {
+         // a seeking disk sweeping its head, or a flash drive serving many requests at once
+         if (strcmp(token, "hdd") == 0) {
+            valid = 1;
+            spec->scheduler = SCAN_scheduler;
+            spec->distribution = Uniform_service;
+            spec->minService = 300;
+            spec->maxService = 900;
+            spec->seekCycles = 1;
+            spec->depth = 1;
+         } else if (strcmp(token, "nvme") == 0) {
+            valid = 1;
+            spec->scheduler = FIFO_scheduler;
+            spec->distribution = Exponential_service;
+            spec->minService = 150;
+            spec->maxService = 150;
+            spec->seekCycles = 0;
+            spec->depth = 32;
+         }
+      } else {
+         *value++ = '\0';
+
+         if (strcmp(token, "sched") == 0) {
+            for (i = 0; i < DEVICE_SCHEDULERS; i++) {
+               if (strcmp(value, Device_schedulerNames[i]) == 0) {
+                  spec->scheduler = i;
+                  valid = 1;
+               }
+            }
+         } else if (strcmp(token, "quanta") == 0) {
+            spec->distribution = Quantum_service;
+            valid = parseServiceRange(value, &spec->minService, &spec->maxService);
+         } else if (strcmp(token, "cycles") == 0) {
+            spec->distribution = Uniform_service;
+            valid = parseServiceRange(value, &spec->minService, &spec->maxService);
+         } else if (strcmp(token, "mean") == 0) {
+            spec->distribution = Exponential_service;
+            valid = parseDeviceNumber(value, &spec->minService, 1, INT_MAX);
+            spec->maxService = spec->minService;
+         } else if (strcmp(token, "seek") == 0) {
+            valid = parseDeviceNumber(value, &spec->seekCycles, 0, INT_MAX);
+         } else if (strcmp(token, "blocks") == 0) {
+            valid = parseDeviceNumber(value, &spec->blocks, 1, INT_MAX);
+         } else if (strcmp(token, "depth") == 0) {
+            valid = parseDeviceNumber(value, &number, 1, DEVICE_MAX_DEPTH);
+            spec->depth = number;
+         }
+      }
+
+      if (!valid) {
+         return 0;
+      }
+   }
+
+   return 1;
+}
+
+Device_Ptr Device_constructor(const DeviceSpec *spec) {
+   Device_Ptr device = malloc(sizeof(Device));
+   int i;
+   device->spec = *spec;
+   device->waitQueue = Queue_constructor();
+   device->serving = malloc(sizeof(PCB_Ptr) * spec->depth);
+   device->counters = malloc(sizeof(int) * spec->depth);
+   device->busy = 0;
+   device->head = 0;
+   device->direction = 1;
+   device->served = 0;
+   device->serviceTime = 0;
+
+   for (i = 0; i < spec->depth; i++) {
+      device->serving[i] = NULL;
+      device->counters[i] = 0;
+   }
+
+   return device;
+}
+
+void Device_destructor(Device_Ptr device) {
+   Queue_destructor(device->waitQueue);
+   free(device->serving);
+   free(device->counters);
+   free(device);
+}
+
+unsigned int seekDistance(Device_Ptr device, PCB_Ptr pcb) {
+   return pcb->ioBlock > device->head ? pcb->ioBlock - device->head : device->head - pcb->ioBlock;
+}
+
+void startRequest(Device_Ptr device, int slot, PCB_Ptr pcb, Rng_Ptr rng, int quantum) {
+   const DeviceSpec *spec = &device->spec;
+   uint64_t cycles;
+   double uniform;
+
+   if (spec->distribution == Quantum_service) {
+      cycles = (uint64_t) (Rng_range(rng, spec->maxService - spec->minService + 1) + spec->minService) * quantum;
+   } else if (spec->distribution == Uniform_service) {
+      cycles = Rng_range(rng, spec->maxService - spec->minService + 1) + spec->minService;
+   } else {
+      // the top 53 bits make a uniform number in (0, 1]
+      uniform = ((Rng_next(rng) >> 11) + 1) * (1.0 / 9007199254740992.0);
+      cycles = -log(uniform) * spec->minService;
+   }
+
+   cycles += (uint64_t) spec->seekCycles * seekDistance(device, pcb);
+
+   if (cycles > INT_MAX) {
+      cycles = INT_MAX;
+   }
+
+   device->head = pcb->ioBlock;
+   device->serving[slot] = pcb;
+   device->counters[slot] = cycles;
+   device->serviceTime += cycles;
+   device->busy++;
+}
+
+PCB_Ptr pickRequest(Device_Ptr device) {
+   Queue_Ptr queue = device->waitQueue;
+   PCB_Ptr pcb, best = NULL;
+   int i, pass;
+
+   if (Queue_isEmpty(queue) || device->spec.scheduler == FIFO_scheduler) {
+      return Queue_dequeue(queue);
+   }
+
+   // ties go to the request that arrived first
+   for (pass = 0; best == NULL; pass++) {
+      for (i = 0; i < Queue_size(queue); i++) {
+         pcb = Queue_at(queue, i);
+
+         if (device->spec.scheduler == SSTF_scheduler) {
+            if (best == NULL || seekDistance(device, pcb) < seekDistance(device, best)) {
+               best = pcb;
+            }
+         } else if (device->spec.scheduler == Priority_scheduler) {
+            if (best == NULL || PCB_getCurPriority(pcb) < PCB_getCurPriority(best)) {
+               best = pcb;
+            }
+         } else if (device->direction > 0 ? pcb->ioBlock >= device->head : pcb->ioBlock <= device->head) {
+            // the elevator takes the nearest block ahead of the head
+            if (best == NULL || seekDistance(device, pcb) < seekDistance(device, best)) {
+               best = pcb;
+            }
+         }
+      }
+
+      // nothing is ahead of the head, so it turns around
+      if (best == NULL && pass == 0) {
+         device->direction = -device->direction;
+      }
+   }
+
+   Queue_remove(queue, best);
+   return best;
+}
+
+void Device_submit(Device_Ptr device, PCB_Ptr pcb, Rng_Ptr rng, int quantum) {
+   int slot;
+
+   if (device->busy < device->spec.depth) {
+      for (slot = 0; device->serving[slot] != NULL; slot++);
+      startRequest(device, slot, pcb, rng, quantum);
+   } else {
+      Queue_enqueue(device->waitQueue, pcb);
+   }
+}
+
+int Device_tick(Device_Ptr device) {
+   int slot, completed = 0;
+
+   for (slot = 0; slot < device->spec.depth && device->busy > 0; slot++) {
+      if (device->serving[slot] == NULL) {
+         continue;
+      }
+
+      if (device->counters[slot] > 0) {
+         device->counters[slot]--;
+      } else {
+         device->counters[slot] = -1;
+         completed = 1;
+      }
+   }
+
+   return completed;
+}
+
+PCB_Ptr Device_complete(Device_Ptr device, Rng_Ptr rng, int quantum) {
+   PCB_Ptr pcb, next;
+   int slot;
+
+   for (slot = 0; slot < device->spec.depth; slot++) {
+      if (device->serving[slot] != NULL && device->counters[slot] < 0) {
+         pcb = device->serving[slot];
+         device->serving[slot] = NULL;
+         device->counters[slot] = 0;
+         device->busy--;
+         device->served++;
+         next = pickRequest(device);
+
+         if (next != NULL) {
+            startRequest(device, slot, next, rng, quantum);
+         }
+
+         return pcb;
+      }
+   }
+
+   return NULL;
+}
+
+unsigned int Device_quietCycles(Device_Ptr device) {
+   unsigned int quiet = UINT_MAX;
+   int slot;
+
+   for (slot = 0; slot < device->spec.depth && device->busy > 0; slot++) {
+      if (device->serving[slot] != NULL && (unsigned int) device->counters[slot] < quiet) {
+         quiet = device->counters[slot];
+      }
+   }
+
+   return quiet;
+}
+
+void Device_advance(Device_Ptr device, unsigned int cycles) {
+   int slot;
+
+   for (slot = 0; slot < device->spec.depth && device->busy > 0; slot++) {
+      if (device->serving[slot] != NULL) {
+         device->counters[slot] = (unsigned int) device->counters[slot] > cycles ? device->counters[slot] - cycles : 0;
+      }
+   }
+}
+
+int Device_size(Device_Ptr device) {
+   return Queue_size(device->waitQueue) + device->busy;
+}
+
+void Device_save(Device_Ptr device, Snapshot_Ptr snapshot) {
+   int slot;
+   Queue_save(device->waitQueue, snapshot);
+
+   for (slot = 0; slot < device->spec.depth; slot++) {
+      Snapshot_writePCB(snapshot, device->serving[slot]);
+      Snapshot_write(snapshot, &device->counters[slot], sizeof(int));
+   }
+
+   Snapshot_write(snapshot, &device->head, sizeof(device->head));
+   Snapshot_write(snapshot, &device->direction, sizeof(device->direction));
+   Snapshot_write(snapshot, &device->served, sizeof(device->served));
+   Snapshot_write(snapshot, &device->serviceTime, sizeof(device->serviceTime));
+}
+
+void Device_restore(Device_Ptr device, Snapshot_Ptr snapshot) {
+   int slot;
+   Queue_restore(device->waitQueue, snapshot);
+
+   for (slot = 0; slot < device->spec.depth; slot++) {
+      device->serving[slot] = Snapshot_readPCB(snapshot);
+      Snapshot_read(snapshot, &device->counters[slot], sizeof(int));
+      device->busy += device->serving[slot] != NULL;
+   }
+
+   Snapshot_read(snapshot, &device->head, sizeof(device->head));
+   Snapshot_read(snapshot, &device->direction, sizeof(device->direction));
+   Snapshot_read(snapshot, &device->served, sizeof(device->served));
+   Snapshot_read(snapshot, &device->serviceTime, sizeof(device->serviceTime));
+}
@@ -0,0 +1,132 @@
+/**
+* device.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for the I/O device implementation. A device
+* serves up to depth requests at once, each for a number of cycles drawn from its service time
+* distribution plus the time its head takes to seek to the block the request is for. Requests
+* that find every slot busy wait until the scheduler of the device picks them.
+*
+*/
+
+#ifndef DEVICE_H
+#define DEVICE_H
+#include <stdint.h>
+#include "pcb.h"
+#include "queue.h"
+#include "rng.h"
+
+#define DEVICE_MAX_DEPTH 1024 // max number of requests a device serves at once
+
+// This defines the orders in which a device takes waiting requests: arrival, shortest seek
+// from the head, the elevator sweeping the head up and down, and highest current priority
+typedef enum {FIFO_scheduler, SSTF_scheduler, SCAN_scheduler, Priority_scheduler, DEVICE_SCHEDULERS} Device_Scheduler;
+
+// This defines the distributions of service times: whole timer quanta or cycles uniform
+// between min and max, or cycles exponential with mean min
+typedef enum {Quantum_service, Uniform_service, Exponential_service} Service_Distribution;
+
+// This defines the parameters of a device
+typedef struct {
+   Device_Scheduler scheduler;
+   Service_Distribution distribution;
+   unsigned int minService;
+   unsigned int maxService;
+   unsigned int seekCycles; // cycles the head takes to move by one block
+   unsigned int blocks; // number of block addresses requests are spread over
+   int depth; // number of requests served at once
+} DeviceSpec;
+
+typedef DeviceSpec *DeviceSpec_Ptr;
+
+// This defines a device type
+typedef struct {
+   DeviceSpec spec;
+   Queue_Ptr waitQueue; // requests no slot serves yet, in arrival order
+   PCB_Ptr *serving; // pcb served by each slot, NULL when the slot is free
+   int *counters; // cycles left of the request of each slot, -1 once it completed
+   int busy; // number of slots serving a request
+   unsigned int head; // block the head is at
+   int direction; // 1 while the head of a SCAN device sweeps up, -1 while it sweeps down
+   uint64_t served; // number of requests completed
+   uint64_t serviceTime; // sum of the service times of all started requests
+} Device;
+
+typedef Device *Device_Ptr;
+
+extern const char *Device_schedulerNames[]; // names of Device_Scheduler values
+
+/**
+* fills the spec with the device the simulator always had: FIFO, one request at a time,
+* 3 to 5 timer quanta per request and no seek time
+*/
+void DeviceSpec_default(DeviceSpec_Ptr spec);
+
+/**
+* sets the spec from a comma separated list of key=value settings, applied over the default
+* one. A setting without value is a preset: hdd or nvme. Returns 0 when the list isn't valid.
+*/
+int DeviceSpec_parse(DeviceSpec_Ptr spec, const char *list);
+
+/**
+* creates an idle device with the given parameters and returns pointer of the device
+*/
+Device_Ptr Device_constructor(const DeviceSpec *spec);
+
+/**
+* frees memory used by the device, the pcbs in it are not freed
+*/
+void Device_destructor(Device_Ptr device);
+
+/**
+* adds a request of the pcb for its ioBlock, a free slot starts serving it right away with a
+* service time drawn from rng, quantum is the length of a timer quantum
+*/
+void Device_submit(Device_Ptr device, PCB_Ptr pcb, Rng_Ptr rng, int quantum);
+
+/**
+* advances the device by one cycle, returns 1 when a request completes, whose pcb
+* Device_complete() returns
+*/
+int Device_tick(Device_Ptr device);
+
+/**
+* removes the pcb of a completed request and lets its slot start the next waiting request
+* the scheduler picks, returns NULL when no request completed
+*/
+PCB_Ptr Device_complete(Device_Ptr device, Rng_Ptr rng, int quantum);
+
+/**
+* returns number of cycles the device can be advanced before a request completes, UINT_MAX when it is idle
+*/
+unsigned int Device_quietCycles(Device_Ptr device);
+
+/**
+* advances the device by the given number of cycles, in which no request may complete
+*/
+void Device_advance(Device_Ptr device, unsigned int cycles);
+
+/**
+* returns number of requests waiting for or being served by the device
+*/
+int Device_size(Device_Ptr device);
+
+/**
+* writes the requests the device serves and those waiting for it to the snapshot
+*/
+void Device_save(Device_Ptr device, Snapshot_Ptr snapshot);
+
+/**
+* reads what Device_save() wrote into this idle device, which has the same spec
+*/
+void Device_restore(Device_Ptr device, Snapshot_Ptr snapshot);
+
+#endif
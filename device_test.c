@@ -0,0 +1,66 @@
+/**
+* device_test.c
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This file checks that the io traps of the built-in workload reach every I/O device, also
+* when a run has more devices than a process has io traps by default. It prints every check
+* that failed and exits with 1 when any did.
+*/
+
+#include <stdio.h>
+#include "simulation.h"
+
+#define TEST_CYCLES 2000000 // number of cycles every run of the check takes
+
+/**
+* This runs the built-in workload with the given number of devices and checks that each of
+* them served requests. Returns number of failed checks.
+*/
+int checkDevices(int devices);
+
+int checkDevices(int devices) {
+   Config config;
+   Simulation_Ptr sim;
+   int i, failed = 0;
+
+   Config_default(&config, 1);
+   config.cycles = TEST_CYCLES;
+   config.devices = devices;
+
+   for (i = 0; i < devices; i++) {
+      DeviceSpec_default(&config.deviceSpecs[i]);
+   }
+
+   sim = Simulation_constructor(&config, NULL);
+   Simulation_run(sim);
+
+   for (i = 0; i < devices; i++) {
+      if (sim->devices[i]->served == 0) {
+         printf("FAILED: device %d of %d served no requests\n", i + 1, devices);
+         failed++;
+      }
+   }
+
+   Simulation_destructor(sim);
+   return failed;
+}
+
+int main(void) {
+   int failed = 0;
+
+   failed += checkDevices(2);
+   failed += checkDevices(9);
+   failed += checkDevices(12);
+   failed += checkDevices(MAX_DEVICES);
+
+   printf("%s\n", failed ? "device checks failed" : "device checks passed");
+   return failed > 0;
+}
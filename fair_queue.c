@@ -0,0 +1,422 @@
+#include <stdlib.h>
+#include "fair_queue.h"
+
+// weights of original priorities 0 to 3, each priority gets about 3 times the cpu time of the next one
+const unsigned int fairWeights[] = {3121, 1024, 335, 110};
+
+/**
+* returns 1 if pcb a goes before pcb b in the tree
+*/
+int treeBefore(PCB_Ptr a, PCB_Ptr b);
+
+/**
+* replaces the subtree rooted at pcb old by the one rooted at pcb new, which may be NULL
+*/
+void treeTransplant(FairQueue_Ptr fairQueue, PCB_Ptr old, PCB_Ptr new);
+
+/**
+* rotates the subtree rooted at the given pcb to the left, its right child becomes the root
+*/
+void treeRotateLeft(FairQueue_Ptr fairQueue, PCB_Ptr pcb);
+
+/**
+* rotates the subtree rooted at the given pcb to the right, its left child becomes the root
+*/
+void treeRotateRight(FairQueue_Ptr fairQueue, PCB_Ptr pcb);
+
+/**
+* adds the pcb to the tree and rebalances it
+*/
+void treeInsert(FairQueue_Ptr fairQueue, PCB_Ptr pcb);
+
+/**
+* removes the pcb from the tree and rebalances it
+*/
+void treeErase(FairQueue_Ptr fairQueue, PCB_Ptr pcb);
+
+/**
+* restores the red-black properties after a black node was removed above pcb, whose parent is given
+* because pcb may be NULL
+*/
+void treeEraseFixup(FairQueue_Ptr fairQueue, PCB_Ptr pcb, PCB_Ptr parent);
+
+/**
+* adds the cycles the pcb ran since it was dequeued to its virtual runtime, scaled by its weight
+*/
+void chargePCB(FairQueue_Ptr fairQueue, PCB_Ptr pcb);
+
+FairQueue_Ptr FairQueue_constructor(void) {
+   FairQueue_Ptr fairQueue = malloc(sizeof(FairQueue));
+   fairQueue->root = NULL;
+   fairQueue->leftmost = NULL;
+   fairQueue->minVruntime = 0;
+   fairQueue->clock = 0;
+   fairQueue->enqueued = 0;
+   fairQueue->weight = 0;
+   fairQueue->size = 0;
+   return fairQueue;
+}
+
+void FairQueue_destructor(FairQueue_Ptr fairQueue) {
+   free(fairQueue);
+}
+
+unsigned int FairQueue_weight(int priority) {
+   if (priority < 0) {
+      return fairWeights[0];
+   } else if (priority > 3) {
+      return fairWeights[3];
+   }
+
+   return fairWeights[priority];
+}
+
+int treeBefore(PCB_Ptr a, PCB_Ptr b) {
+   return a->vruntime < b->vruntime || (a->vruntime == b->vruntime && a->treeOrder < b->treeOrder);
+}
+
+void treeTransplant(FairQueue_Ptr fairQueue, PCB_Ptr old, PCB_Ptr new) {
+   if (old->treeParent == NULL) {
+      fairQueue->root = new;
+   } else if (old == old->treeParent->treeLeft) {
+      old->treeParent->treeLeft = new;
+   } else {
+      old->treeParent->treeRight = new;
+   }
+
+   if (new != NULL) {
+      new->treeParent = old->treeParent;
+   }
+}
+
+void treeRotateLeft(FairQueue_Ptr fairQueue, PCB_Ptr pcb) {
+   PCB_Ptr child = pcb->treeRight;
+   pcb->treeRight = child->treeLeft;
+
+   if (child->treeLeft != NULL) {
+      child->treeLeft->treeParent = pcb;
+   }
+
+   treeTransplant(fairQueue, pcb, child);
+   child->treeLeft = pcb;
+   pcb->treeParent = child;
+}
+
+void treeRotateRight(FairQueue_Ptr fairQueue, PCB_Ptr pcb) {
+   PCB_Ptr child = pcb->treeLeft;
+   pcb->treeLeft = child->treeRight;
+
+   if (child->treeRight != NULL) {
+      child->treeRight->treeParent = pcb;
+   }
+
+   treeTransplant(fairQueue, pcb, child);
+   child->treeRight = pcb;
+   pcb->treeParent = child;
+}
+
+void treeInsert(FairQueue_Ptr fairQueue, PCB_Ptr pcb) {
+   PCB_Ptr parent = NULL, grandparent, uncle;
+   PCB_Ptr *link = &fairQueue->root;
+   int leftmost = 1;
+
+   while (*link != NULL) {
+      parent = *link;
+
+      if (treeBefore(pcb, parent)) {
+         link = &parent->treeLeft;
+      } else {
+         link = &parent->treeRight;
+         leftmost = 0;
+      }
+   }
+
+   pcb->treeParent = parent;
+   pcb->treeLeft = NULL;
+   pcb->treeRight = NULL;
+   pcb->treeRed = 1;
+   *link = pcb;
+
+   if (leftmost) {
+      fairQueue->leftmost = pcb;
+   }
+
+   // a red pcb must not have a red parent
+   while ((parent = pcb->treeParent) != NULL && parent->treeRed) {
+      grandparent = parent->treeParent;
+
+      if (parent == grandparent->treeLeft) {
+         uncle = grandparent->treeRight;
+
+         if (uncle != NULL && uncle->treeRed) {
+            parent->treeRed = 0;
+            uncle->treeRed = 0;
+            grandparent->treeRed = 1;
+            pcb = grandparent;
+            continue;
+         }
+
+         if (pcb == parent->treeRight) {
+            treeRotateLeft(fairQueue, parent);
+            pcb = parent;
+            parent = pcb->treeParent;
+         }
+
+         treeRotateRight(fairQueue, grandparent);
+      } else {
+         uncle = grandparent->treeLeft;
+
+         if (uncle != NULL && uncle->treeRed) {
+            parent->treeRed = 0;
+            uncle->treeRed = 0;
+            grandparent->treeRed = 1;
+            pcb = grandparent;
+            continue;
+         }
+
+         if (pcb == parent->treeLeft) {
+            treeRotateRight(fairQueue, parent);
+            pcb = parent;
+            parent = pcb->treeParent;
+         }
+
+         treeRotateLeft(fairQueue, grandparent);
+      }
+
+      parent->treeRed = 0;
+      grandparent->treeRed = 1;
+   }
+
+   fairQueue->root->treeRed = 0;
+}
+
+void treeErase(FairQueue_Ptr fairQueue, PCB_Ptr pcb) {
+   PCB_Ptr child, parent, successor;
+   int removedRed = pcb->treeRed;
+
+   if (pcb->treeLeft == NULL) {
+      child = pcb->treeRight;
+      parent = pcb->treeParent;
+      treeTransplant(fairQueue, pcb, child);
+   } else if (pcb->treeRight == NULL) {
+      child = pcb->treeLeft;
+      parent = pcb->treeParent;
+      treeTransplant(fairQueue, pcb, child);
+   } else {
+      // the successor, which has no left child, takes the place of the pcb
+      for (successor = pcb->treeRight; successor->treeLeft != NULL; successor = successor->treeLeft);
+      removedRed = successor->treeRed;
+      child = successor->treeRight;
+
+      if (successor->treeParent == pcb) {
+         parent = successor;
+      } else {
+         parent = successor->treeParent;
+         treeTransplant(fairQueue, successor, child);
+         successor->treeRight = pcb->treeRight;
+         successor->treeRight->treeParent = successor;
+      }
+
+      treeTransplant(fairQueue, pcb, successor);
+      successor->treeLeft = pcb->treeLeft;
+      successor->treeLeft->treeParent = successor;
+      successor->treeRed = pcb->treeRed;
+   }
+
+   if (!removedRed) {
+      treeEraseFixup(fairQueue, child, parent);
+   }
+}
+
+void treeEraseFixup(FairQueue_Ptr fairQueue, PCB_Ptr pcb, PCB_Ptr parent) {
+   PCB_Ptr sibling;
+
+   while (pcb != fairQueue->root && (pcb == NULL || !pcb->treeRed)) {
+      if (pcb == parent->treeLeft) {
+         sibling = parent->treeRight;
+
+         if (sibling->treeRed) {
+            sibling->treeRed = 0;
+            parent->treeRed = 1;
+            treeRotateLeft(fairQueue, parent);
+            sibling = parent->treeRight;
+         }
+
+         if ((sibling->treeLeft == NULL || !sibling->treeLeft->treeRed)
+            && (sibling->treeRight == NULL || !sibling->treeRight->treeRed)) {
+            sibling->treeRed = 1;
+            pcb = parent;
+            parent = pcb->treeParent;
+            continue;
+         }
+
+         if (sibling->treeRight == NULL || !sibling->treeRight->treeRed) {
+            sibling->treeLeft->treeRed = 0;
+            sibling->treeRed = 1;
+            treeRotateRight(fairQueue, sibling);
+            sibling = parent->treeRight;
+         }
+
+         sibling->treeRed = parent->treeRed;
+         parent->treeRed = 0;
+         sibling->treeRight->treeRed = 0;
+         treeRotateLeft(fairQueue, parent);
+      } else {
+         sibling = parent->treeLeft;
+
+         if (sibling->treeRed) {
+            sibling->treeRed = 0;
+            parent->treeRed = 1;
+            treeRotateRight(fairQueue, parent);
+            sibling = parent->treeLeft;
+         }
+
+         if ((sibling->treeLeft == NULL || !sibling->treeLeft->treeRed)
+            && (sibling->treeRight == NULL || !sibling->treeRight->treeRed)) {
+            sibling->treeRed = 1;
+            pcb = parent;
+            parent = pcb->treeParent;
+            continue;
+         }
+
+         if (sibling->treeLeft == NULL || !sibling->treeLeft->treeRed) {
+            sibling->treeRight->treeRed = 0;
+            sibling->treeRed = 1;
+            treeRotateLeft(fairQueue, sibling);
+            sibling = parent->treeLeft;
+         }
+
+         sibling->treeRed = parent->treeRed;
+         parent->treeRed = 0;
+         sibling->treeLeft->treeRed = 0;
+         treeRotateRight(fairQueue, parent);
+      }
+
+      pcb = fairQueue->root;
+   }
+
+   if (pcb != NULL) {
+      pcb->treeRed = 0;
+   }
+}
+
+void chargePCB(FairQueue_Ptr fairQueue, PCB_Ptr pcb) {
+   uint64_t ran;
+
+   if (pcb->execStart == NO_EXEC_START) {
+      return;
+   }
+
+   // a pcb taken from the queue of another cpu may have started a cycle ahead of this clock
+   ran = fairQueue->clock > pcb->execStart ? fairQueue->clock - pcb->execStart : 0;
+   pcb->vruntime += ran * FAIR_NICE_0_WEIGHT / FairQueue_weight(PCB_getOrigPriority(pcb));
+   pcb->execStart = NO_EXEC_START;
+}
+
+void FairQueue_enqueue(FairQueue_Ptr fairQueue, PCB_Ptr pcb) {
+   if (pcb->execStart == NO_EXEC_START) {
+      // a new pcb starts with no advantage over the pcbs already waiting
+      if (pcb->vruntime < fairQueue->minVruntime) {
+         pcb->vruntime = fairQueue->minVruntime;
+      }
+   } else {
+      chargePCB(fairQueue, pcb);
+   }
+
+   pcb->treeOrder = fairQueue->enqueued++;
+   treeInsert(fairQueue, pcb);
+   fairQueue->weight += FairQueue_weight(PCB_getOrigPriority(pcb));
+   fairQueue->size++;
+}
+
+void FairQueue_wake(FairQueue_Ptr fairQueue, PCB_Ptr pcb) {
+   uint64_t credit = FAIR_LATENCY / 2;
+   chargePCB(fairQueue, pcb);
+
+   // waiting doesn't bank cpu time, or a pcb back from a long wait would hold the cpu for as long
+   if (fairQueue->minVruntime > credit && pcb->vruntime < fairQueue->minVruntime - credit) {
+      pcb->vruntime = fairQueue->minVruntime - credit;
+   }
+
+   pcb->treeOrder = fairQueue->enqueued++;
+   treeInsert(fairQueue, pcb);
+   fairQueue->weight += FairQueue_weight(PCB_getOrigPriority(pcb));
+   fairQueue->size++;
+}
+
+void FairQueue_block(FairQueue_Ptr fairQueue, PCB_Ptr pcb) {
+   chargePCB(fairQueue, pcb);
+}
+
+PCB_Ptr FairQueue_dequeue(FairQueue_Ptr fairQueue) {
+   PCB_Ptr pcb = fairQueue->leftmost, next;
+
+   if (pcb == NULL) {
+      return NULL;
+   }
+
+   // the leftmost pcb has no left child, so the next one is the leftmost of its right subtree or its parent
+   if (pcb->treeRight != NULL) {
+      for (next = pcb->treeRight; next->treeLeft != NULL; next = next->treeLeft);
+   } else {
+      next = pcb->treeParent;
+   }
+
+   treeErase(fairQueue, pcb);
+   fairQueue->leftmost = next;
+   fairQueue->weight -= FairQueue_weight(PCB_getOrigPriority(pcb));
+   fairQueue->size--;
+
+   if (pcb->vruntime > fairQueue->minVruntime) {
+      fairQueue->minVruntime = pcb->vruntime;
+   }
+
+   pcb->execStart = fairQueue->clock;
+   return pcb;
+}
+
+int FairQueue_timeSlice(FairQueue_Ptr fairQueue, PCB_Ptr pcb) {
+   uint64_t runnable = fairQueue->size + 1;
+   uint64_t weight = FairQueue_weight(PCB_getOrigPriority(pcb));
+   uint64_t period = FAIR_LATENCY, slice;
+
+   // with many runnable pcbs the period stretches, so no slice gets shorter than the min granularity on average
+   if (runnable * FAIR_MIN_GRANULARITY > period) {
+      period = runnable * FAIR_MIN_GRANULARITY;
+   }
+
+   slice = period * weight / (fairQueue->weight + weight);
+   return slice > 0 ? slice : 1;
+}
+
+int FairQueue_size(FairQueue_Ptr fairQueue) {
+   return fairQueue->size;
+}
+
+void FairQueue_age(FairQueue_Ptr fairQueue, unsigned int cycles) {
+   fairQueue->clock += cycles;
+}
+
+void FairQueue_save(FairQueue_Ptr fairQueue, Snapshot_Ptr snapshot) {
+   Snapshot_writePCB(snapshot, fairQueue->root);
+   Snapshot_writePCB(snapshot, fairQueue->leftmost);
+   Snapshot_write(snapshot, &fairQueue->minVruntime, sizeof(fairQueue->minVruntime));
+   Snapshot_write(snapshot, &fairQueue->clock, sizeof(fairQueue->clock));
+   Snapshot_write(snapshot, &fairQueue->enqueued, sizeof(fairQueue->enqueued));
+   Snapshot_write(snapshot, &fairQueue->weight, sizeof(fairQueue->weight));
+   Snapshot_write(snapshot, &fairQueue->size, sizeof(fairQueue->size));
+}
+
+void FairQueue_restore(FairQueue_Ptr fairQueue, Snapshot_Ptr snapshot) {
+   fairQueue->root = Snapshot_readPCB(snapshot);
+   fairQueue->leftmost = Snapshot_readPCB(snapshot);
+   Snapshot_read(snapshot, &fairQueue->minVruntime, sizeof(fairQueue->minVruntime));
+   Snapshot_read(snapshot, &fairQueue->clock, sizeof(fairQueue->clock));
+   Snapshot_read(snapshot, &fairQueue->enqueued, sizeof(fairQueue->enqueued));
+   Snapshot_read(snapshot, &fairQueue->weight, sizeof(fairQueue->weight));
+   Snapshot_read(snapshot, &fairQueue->size, sizeof(fairQueue->size));
+   
+   if ((fairQueue->root == NULL) != (fairQueue->size == 0) || (fairQueue->leftmost == NULL) != (fairQueue->size == 0)) {
+      Snapshot_fail(snapshot);
+   }
+}
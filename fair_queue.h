@@ -0,0 +1,104 @@
+/**
+* fair_queue.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for the fair queue implementation, the
+* ready queue of the completely fair policy. Every pcb accumulates virtual runtime, the cycles
+* it ran scaled by the weight of its original priority, and the pcb with the least virtual
+* runtime runs next. Pcbs are kept in a red-black tree linked through the pcbs themselves.
+*
+*/
+
+#ifndef FAIR_QUEUE_H
+#define FAIR_QUEUE_H
+#include <stdint.h>
+#include "pcb.h"
+#include "snapshot.h"
+
+#define FAIR_LATENCY 2400 // number of cycles in which every runnable pcb should run once
+#define FAIR_MIN_GRANULARITY 300 // min number of cycles a pcb runs before it can be preempted
+#define FAIR_NICE_0_WEIGHT 1024 // weight of priority 1 pcbs, a pcb of this weight gets one unit of virtual runtime per cycle
+
+typedef struct {
+   PCB_Ptr root;
+   PCB_Ptr leftmost; // cached pcb with the least virtual runtime, NULL when the queue is empty
+   uint64_t minVruntime; // never decreasing lower bound of the virtual runtime of the pcbs, new pcbs start at it
+   uint64_t clock; // number of cycles the queue was aged
+   uint64_t enqueued; // number of pcbs enqueued so far
+   uint64_t weight; // sum of the weights of all pcbs in the queue
+   int size;
+} FairQueue;
+
+typedef FairQueue *FairQueue_Ptr;
+
+/**
+* creates an empty fair queue and returns pointer of the queue
+*/
+FairQueue_Ptr FairQueue_constructor(void);
+
+/**
+* destructs the passed in fair queue, the pcbs in it are not freed
+*/
+void FairQueue_destructor(FairQueue_Ptr fairQueue);
+
+/**
+* returns the weight of pcbs with the given original priority
+*/
+unsigned int FairQueue_weight(int priority);
+
+/**
+* adds a pcb that is new or was preempted, a preempted pcb is charged the cycles it ran
+*/
+void FairQueue_enqueue(FairQueue_Ptr fairQueue, PCB_Ptr pcb);
+
+/**
+* adds a pcb that stopped waiting, with no more than half of FAIR_LATENCY of credit for the time it waited
+*/
+void FairQueue_wake(FairQueue_Ptr fairQueue, PCB_Ptr pcb);
+
+/**
+* charges the running pcb the cycles it ran, because it stops running without being enqueued
+*/
+void FairQueue_block(FairQueue_Ptr fairQueue, PCB_Ptr pcb);
+
+/**
+* removes the pcb with the least virtual runtime, which starts running, returns NULL when the queue is empty
+*/
+PCB_Ptr FairQueue_dequeue(FairQueue_Ptr fairQueue);
+
+/**
+* returns number of cycles the given pcb runs before it can be preempted, its share of the
+* period in which every runnable pcb runs once
+*/
+int FairQueue_timeSlice(FairQueue_Ptr fairQueue, PCB_Ptr pcb);
+
+/**
+* returns size of this fair queue
+*/
+int FairQueue_size(FairQueue_Ptr fairQueue);
+
+/**
+* advances the clock of the queue by the given number of cycles
+*/
+void FairQueue_age(FairQueue_Ptr fairQueue, unsigned int cycles);
+
+/**
+* writes the counters of the queue and the root of its tree to the snapshot, the links of
+* the tree are written with the pcbs
+*/
+void FairQueue_save(FairQueue_Ptr fairQueue, Snapshot_Ptr snapshot);
+
+/**
+* reads what FairQueue_save() wrote into this empty fair queue
+*/
+void FairQueue_restore(FairQueue_Ptr fairQueue, Snapshot_Ptr snapshot);
+
+#endif
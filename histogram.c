@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <string.h>
+#include "histogram.h"
+
+/**
+* returns index of the bucket that holds the given value
+*/
+int bucketOf(uint32_t value);
+
+/**
+* returns the largest value the given bucket holds
+*/
+uint32_t bucketTop(int bucket);
+
+Histogram_Ptr Histogram_constructor(void) {
+   Histogram_Ptr histogram = malloc(sizeof(Histogram));
+   Histogram_reset(histogram);
+   return histogram;
+}
+
+void Histogram_destructor(Histogram_Ptr histogram) {
+   free(histogram);
+}
+
+void Histogram_reset(Histogram_Ptr histogram) {
+   memset(histogram, 0, sizeof(Histogram));
+}
+
+int bucketOf(uint32_t value) {
+   int shift;
+
+   if (value < 2u << HISTOGRAM_SUB_BITS) {
+      return value;
+   }
+
+   // drop all but the top HISTOGRAM_SUB_BITS + 1 bits, the top one is always set
+   shift = 31 - __builtin_clz(value) - HISTOGRAM_SUB_BITS;
+   return (shift << HISTOGRAM_SUB_BITS) + (value >> shift);
+}
+
+uint32_t bucketTop(int bucket) {
+   int shift;
+   uint32_t mantissa;
+
+   if (bucket < 2 << HISTOGRAM_SUB_BITS) {
+      return bucket;
+   }
+
+   shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+   mantissa = bucket - (shift << HISTOGRAM_SUB_BITS);
+   return (uint32_t) ((((uint64_t) mantissa + 1) << shift) - 1);
+}
+
+void Histogram_record(Histogram_Ptr histogram, uint32_t value) {
+   histogram->counts[bucketOf(value)]++;
+   histogram->total++;
+
+   if (value > histogram->max) {
+      histogram->max = value;
+   }
+}
+
+void Histogram_add(Histogram_Ptr histogram, const Histogram *source) {
+   int i;
+
+   for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+      histogram->counts[i] += source->counts[i];
+   }
+
+   histogram->total += source->total;
+
+   if (source->max > histogram->max) {
+      histogram->max = source->max;
+   }
+}
+
+uint32_t Histogram_percentile(const Histogram *histogram, double percentile) {
+   double exact = percentile / 100 * histogram->total;
+   uint64_t rank = exact, seen = 0;
+   int i;
+
+   if (histogram->total == 0) {
+      return 0;
+   }
+
+   // the smallest value that at least the given percent of values are not above
+   if (rank < exact || rank == 0) {
+      rank++;
+   }
+
+   for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+      seen += histogram->counts[i];
+
+      if (seen >= rank) {
+         return bucketTop(i) < histogram->max ? bucketTop(i) : histogram->max;
+      }
+   }
+
+   return histogram->max;
+}
@@ -0,0 +1,66 @@
+/**
+* histogram.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for the histogram implementation. Values
+* below 128 get a bucket each, larger ones share log-spaced buckets of 64 sub-buckets per power
+* of two, so every value is recorded in constant time within 1.6% of its real size.
+*
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+#include <stdint.h>
+
+#define HISTOGRAM_SUB_BITS 6 // log2 of number of sub-buckets per power of two
+#define HISTOGRAM_BUCKETS ((33 - HISTOGRAM_SUB_BITS) << HISTOGRAM_SUB_BITS) // enough for every 32 bit value
+
+// This defines a histogram type
+typedef struct {
+   uint32_t counts[HISTOGRAM_BUCKETS];
+   uint64_t total; // number of values recorded
+   uint32_t max; // largest value recorded
+} Histogram;
+
+typedef Histogram *Histogram_Ptr;
+
+/**
+* creates an empty histogram and returns pointer of the histogram
+*/
+Histogram_Ptr Histogram_constructor(void);
+
+/**
+* frees memory used by the histogram
+*/
+void Histogram_destructor(Histogram_Ptr histogram);
+
+/**
+* empties the histogram
+*/
+void Histogram_reset(Histogram_Ptr histogram);
+
+/**
+* records one value
+*/
+void Histogram_record(Histogram_Ptr histogram, uint32_t value);
+
+/**
+* adds all values recorded by source to the histogram
+*/
+void Histogram_add(Histogram_Ptr histogram, const Histogram *source);
+
+/**
+* returns the value at the given percentile, from 0 to 100, as the largest value of its bucket
+* but never more than the max, or 0 when nothing was recorded
+*/
+uint32_t Histogram_percentile(const Histogram *histogram, double percentile);
+
+#endif
@@ -0,0 +1,310 @@
+/**
+* main.c
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This file runs the simulation from the command line, either one run whose events
+* are printed or a sweep over several parameter values.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "simulation.h"
+#include "sweep.h"
+
+/**
+* This makes the sweep continue the simulation restored from a snapshot. The parameters fixed when
+* a simulation is created (cpus, policy, levels, buffer slots, seed, devices and -d) always come from the
+* config of the snapshot. Those of -C, -q, -a, -f, -c, -R, -I and -o come from it too, unless
+* given, which is indexed by option char, tells they were set on the command line.
+*/
+void resumeSweep(Sweep_Ptr sweep, Simulation_Ptr sim, const char *given, const char *snapshot);
+
+/**
+* This runs the simulation to the number of cycles in config. With a save file, the simulation is
+* saved there at the end and, when checkpoint isn't 0, every checkpoint cycles. Returns 0 when a
+* snapshot couldn't be written.
+*/
+int runSaving(Simulation_Ptr sim, const Config *config, const char *saveFile, unsigned int checkpoint);
+
+void resumeSweep(Sweep_Ptr sweep, Simulation_Ptr sim, const char *given, const char *snapshot) {
+    Config config = sim->config;
+    const char options[] = "Cqaf";
+    const Sweep_Param params[] = {Sweep_cycles, Sweep_quantum, Sweep_starvation, Sweep_refill};
+    uint64_t values[] = {config.cycles, config.timerQuantum, config.starvationTime, config.refillFrequency};
+    int i;
+    
+    for (i = 0; i < 4; i++) {
+        if (!given[(int) options[i]]) {
+            sweep->values[params[i]][0] = values[i];
+            sweep->counts[params[i]] = 1;
+        }
+    }
+    
+    sweep->values[Sweep_cpus][0] = config.cpus;
+    sweep->values[Sweep_policy][0] = config.policy;
+    sweep->values[Sweep_slots][0] = config.bufferSlots;
+    sweep->counts[Sweep_cpus] = sweep->counts[Sweep_policy] = sweep->counts[Sweep_slots] = 1;
+    sweep->firstSeed = config.seed;
+    sweep->deadLockProne = config.deadLockProne;
+    sweep->levels = config.levels;
+    sweep->devices = config.devices;
+    memcpy(sweep->deviceSpecs, config.deviceSpecs, sizeof(config.deviceSpecs));
+    sweep->snapshot = snapshot;
+    
+    if (!given['c']) {
+        sweep->engine = config.engine;
+    }
+    
+    if (!given['R']) {
+        sweep->deadLockRecovery = config.deadLockRecovery;
+    }
+    
+    if (!given['I']) {
+        sweep->priorityInheritance = config.priorityInheritance;
+    }
+    
+    if (!given['o']) {
+        sweep->overhead = config.overhead;
+    }
+}
+
+int runSaving(Simulation_Ptr sim, const Config *config, const char *saveFile, unsigned int checkpoint) {
+    uint64_t time;
+    
+    while ((time = Simulation_getTime(sim)) < config->cycles) {
+        if (checkpoint > 0 && saveFile != NULL && config->cycles - time > checkpoint) {
+            Simulation_runUntil(sim, time + checkpoint);
+            
+            if (!Simulation_save(sim, saveFile)) {
+                return 0;
+            }
+        } else {
+            Simulation_runUntil(sim, config->cycles);
+        }
+    }
+    
+    return saveFile == NULL || Simulation_save(sim, saveFile);
+}
+
+/**
+* This main simulates CPU. By default, time jumps from one event to the next one,
+* -c makes it run every cycle instead. Both produce the same sequence of events.
+* -d makes the built-in mutual resource pairs lock in opposite orders, so they can deadlock,
+* -R breaks every deadlock by rolling back one of its processes.
+* -I makes a process holding a mutex inherit the priority of the processes waiting for it.
+* Events are printed to stdout, or written as binary records to the file given by -t.
+* -v sets the verbosity from 0 (no events) to 3 (all events).
+* -s sets the seed of all random numbers, runs with the same seed are identical.
+* -C, -q, -a, -f and -n take comma separated lists of cycles, timer quanta, starvation
+* times, refill frequencies and numbers of cpus, -P a comma separated list of scheduling
+* policies: mlfq (default), fcfs, rr, srw or cfs, -l the number of priority levels of the
+* ready queues and the latency table (default 4, up to 256), -b a comma separated list of numbers of
+* slots in the buffer of each producer consumer pair, 0 (default) for one shared integer
+* they take turns on. -r runs each combination with that many seeds, starting at the one
+* given by -s. -w runs the processes of a workload file instead of the built-in random
+* ones. Every -D adds an I/O device, described by a comma separated list of settings (see
+* DeviceSpec_parse()), instead of the two default ones.
+* -o sets the cycles context switches, interrupt service routines and traps take, as a comma
+* separated list of switch=, timer=, io= and trap= settings, all 0 by default.
+* -S saves the state of a single run to a snapshot file when it ends, and with -k also every
+* given number of cycles. -L continues from a snapshot instead of starting at cycle 0, with the
+* parameters it was saved with unless -C, -q, -a, -f, -o, -c, -R or -I change them, so a
+* sweep over those branches every run from the same state.
+* -m writes a sample of the queues and counters of a single run to a CSV file every -M cycles
+* (default 100000), or as binary records with -B.
+* When there is more than one run, they are spread over the threads given by -j and a
+* table of averages is printed instead of the events.
+*/
+int main(int argc, char *argv[]) {
+    Trace_Level level = Trace_sync;
+    FILE *traceFile = stdout, *metricsFile = NULL;
+    Sweep_Ptr sweep = Sweep_constructor(time(NULL));
+    Simulation_Ptr restored = NULL;
+    const char *saveFile = NULL, *loadFile = NULL;
+    char given[128] = {0};
+    unsigned int checkpoint = 0, interval = SAMPLER_INTERVAL;
+    int option, valid = 1, devices = 0, binaryMetrics = 0;
+    
+    while (valid && (option = getopt(argc, argv, "cdRIBt:v:s:C:q:a:f:n:P:l:b:r:j:w:D:o:S:k:L:m:M:")) != -1) {
+        given[option & 127] = 1;
+        
+        if (option == 'c') {
+            sweep->engine = Cycle_engine;
+        } else if (option == 'd') {
+            sweep->deadLockProne = 1;
+        } else if (option == 'R') {
+            sweep->deadLockRecovery = 1;
+        } else if (option == 'I') {
+            sweep->priorityInheritance = 1;
+        } else if (option == 't') {
+            traceFile = fopen(optarg, "wb");
+            
+            if (traceFile == NULL) {
+                perror(optarg);
+                return 1;
+            }
+        } else if (option == 'v') {
+            level = atoi(optarg);
+        } else if (option == 's') {
+            sweep->firstSeed = strtoull(optarg, NULL, 10);
+        } else if (option == 'C') {
+            valid = Sweep_setValues(sweep, Sweep_cycles, optarg);
+        } else if (option == 'q') {
+            valid = Sweep_setValues(sweep, Sweep_quantum, optarg);
+        } else if (option == 'a') {
+            valid = Sweep_setValues(sweep, Sweep_starvation, optarg);
+        } else if (option == 'f') {
+            valid = Sweep_setValues(sweep, Sweep_refill, optarg);
+        } else if (option == 'n') {
+            valid = Sweep_setValues(sweep, Sweep_cpus, optarg);
+        } else if (option == 'P') {
+            valid = Sweep_setValues(sweep, Sweep_policy, optarg);
+        } else if (option == 'l' && atoi(optarg) >= 1 && atoi(optarg) <= MAX_PRIORITY_LEVELS) {
+            sweep->levels = atoi(optarg);
+        } else if (option == 'b') {
+            valid = Sweep_setValues(sweep, Sweep_slots, optarg);
+        } else if (option == 'r' && atoi(optarg) >= 1) {
+            sweep->seeds = atoi(optarg);
+        } else if (option == 'j' && atoi(optarg) >= 1) {
+            sweep->threads = atoi(optarg);
+        } else if (option == 'w') {
+            sweep->workload = Workload_constructor(optarg);
+            valid = sweep->workload != NULL;
+        } else if (option == 'D' && devices < MAX_DEVICES) {
+            // the first device given replaces the two default ones
+            valid = DeviceSpec_parse(&sweep->deviceSpecs[devices++], optarg);
+            sweep->devices = devices;
+        } else if (option == 'o') {
+            valid = Overhead_parse(&sweep->overhead, optarg);
+        } else if (option == 'S') {
+            saveFile = optarg;
+        } else if (option == 'k' && atoi(optarg) >= 1) {
+            checkpoint = atoi(optarg);
+        } else if (option == 'L') {
+            loadFile = optarg;
+        } else if (option == 'm') {
+            metricsFile = fopen(optarg, "wb");
+            
+            if (metricsFile == NULL) {
+                perror(optarg);
+                return 1;
+            }
+        } else if (option == 'M' && atoi(optarg) >= 1) {
+            interval = atoi(optarg);
+        } else if (option == 'B') {
+            binaryMetrics = 1;
+        } else {
+            valid = 0;
+        }
+    }
+    
+    if (valid && loadFile != NULL) {
+        restored = Simulation_restore(loadFile, sweep->workload);
+        
+        if (restored == NULL) {
+            fprintf(stderr, "%s: not a snapshot of this build and workload\n", loadFile);
+            valid = 0;
+        } else {
+            resumeSweep(sweep, restored, given, loadFile);
+        }
+    }
+    
+    // a sweep saves and samples nothing, and all its runs come from one snapshot
+    if (valid && (Sweep_runs(sweep) > SWEEP_MAX_RUNS || (checkpoint > 0 && saveFile == NULL) || (saveFile != NULL && Sweep_runs(sweep) > 1)
+        || (restored != NULL && sweep->seeds > 1) || ((given['M'] || binaryMetrics) && metricsFile == NULL)
+        || (metricsFile != NULL && Sweep_runs(sweep) > 1))) {
+        valid = 0;
+    }
+    
+    if (!valid) {
+        fprintf(stderr, "usage: %s [-c] [-d] [-R] [-I] [-t trace_file] [-v level] [-s seed] [-C cycles] [-q quanta]\n"
+            "    [-a starvation_times] [-f refill_frequencies] [-n cpus] [-P policies] [-l levels] [-b buffer_slots] [-r seeds]\n"
+            "    [-j threads] [-w workload_file] [-D device_spec]... [-o overhead] [-S snapshot_file [-k cycles]]\n"
+            "    [-L snapshot_file] [-m metrics_file [-M cycles] [-B]]\n", argv[0]);
+        
+        if (restored != NULL) {
+            Simulation_destructor(restored);
+        }
+        
+        if (sweep->workload != NULL) {
+            Workload_destructor(sweep->workload);
+        }
+        
+        if (metricsFile != NULL) {
+            fclose(metricsFile);
+        }
+        
+        Sweep_destructor(sweep);
+        return 1;
+    }
+    
+    if (Sweep_runs(sweep) > 1) {
+        if (!Sweep_run(sweep, stdout)) {
+            fprintf(stderr, "%s: a run of the sweep could not be restored\n", loadFile);
+            valid = 0;
+        }
+        
+        if (restored != NULL) {
+            Simulation_destructor(restored);
+        }
+    } else {
+        Config config;
+        Sweep_getConfig(sweep, 0, &config);
+        Trace_Ptr trace = Trace_constructor(traceFile, traceFile != stdout, level, config.cpus);
+        Simulation_Ptr sim = restored;
+        Sampler_Ptr sampler = NULL;
+        
+        if (sim == NULL) {
+            sim = Simulation_constructor(&config, trace);
+        } else {
+            Simulation_configure(sim, &config);
+            Simulation_setTrace(sim, trace);
+        }
+        
+        if (metricsFile != NULL) {
+            sampler = Sampler_constructor(metricsFile, binaryMetrics, interval, config.devices, config.levels);
+            Simulation_setSampler(sim, sampler);
+        }
+        
+        valid = runSaving(sim, &config, saveFile, checkpoint);
+        // all events must be out before the summary is printed
+        Trace_destructor(trace);
+        
+        if (sampler != NULL) {
+            Sampler_destructor(sampler);
+        }
+        
+        Simulation_printStats(sim);
+        Simulation_destructor(sim);
+        
+        if (!valid) {
+            fprintf(stderr, "%s: could not write snapshot\n", saveFile);
+        }
+    }
+    
+    if (traceFile != stdout) {
+        fclose(traceFile);
+    }
+    
+    if (metricsFile != NULL) {
+        fclose(metricsFile);
+    }
+    
+    if (sweep->workload != NULL) {
+        Workload_destructor(sweep->workload);
+    }
+    
+    Sweep_destructor(sweep);
+    return !valid;
+}
@@ -1,25 +1,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
+#include "rng.h"
 #include "pcb.h"
 
-/**
-* This is a function for the io trap arrays. It 
-* generates eight random numbers for them. io_trap is
-* a temporary array holding these numbers, length is 
-* the length of the array, seed is the seed used for
-* random number generator.
-*/
-void fillArray(PCB_Ptr pcb, int *io_trap, int length, int seed);
+const char *PCB_stateNames[] = {"New", "Ready", "Running", "Blocked", "Halted", "Interrupted", "Idle", "Terminated"};
+const char *PCB_typeNames[] = {"IO", "Compute", "ProducerConsumer", "MutualResource"};
 
 /**
-* This can copy numbers from source array to destination
-* array. src is source array, dest is destination array,
-* start is the index where this starts coping and end
-* is the index (exclusive) where this ends coping.
+* This is a function for the io trap array. It 
+* generates a random pc for each io trap in it. io_trap is
+* the array holding these traps, length is 
+* the length of the array, rng is the random number
+* generator the pcs come from.
 */
-void copyArray(int *src, int *dest, int start, int end);
+void fillArray(PCB_Ptr pcb, IoTrap *io_trap, int length, Rng_Ptr rng);
 
 /**
 * This is a helper function for PCB_setPC(). It's a setter
@@ -29,35 +24,253 @@ void PCB_setTermCount(PCB_Ptr pcb);
 
 int max(int *array);
 
+/**
+* This sets every field of the pcb to its initial value
+*/
+void resetPCB(PCB_Ptr pcb, PCB_Type type);
+
+/**
+* This compiles lock, unlock, wait, signal and io trap values into
+* the sorted trap schedule of the pcb. Sync values are only used by
+* ProducerConsumer and MutualResource pcbs.
+*/
+void buildTrapSchedule(PCB_Ptr pcb);
+
+/**
+* This appends a trap of the given kind to the trap schedule, which is sorted
+* once all traps are in. A negative pc means there is no such trap. device is
+* the device an io trap needs.
+*/
+void addTrap(PCB_Ptr pcb, int pc, Trap_Kind kind, int device);
+
+/**
+* This orders trap schedule entries by pc for qsort()
+*/
+int compareTraps(const void *one, const void *two);
+
 int min(int *array);
 
 PCB_Ptr PCB_constructor(PCB_Type type) {
    PCB_Ptr pcb = malloc(sizeof(PCB));
+   pcb->ioTraps = NULL;
+   pcb->traps = NULL;
+   pcb->trapCapacity = 0;
+   resetPCB(pcb, type);
+   return pcb;
+}
+
+PCBPool_Ptr PCBPool_constructor(void) {
+   PCBPool_Ptr pool = malloc(sizeof(PCBPool));
+   pool->slabs = NULL;
+   pool->freeList = NULL;
+   return pool;
+}
+
+void PCBPool_destructor(PCBPool_Ptr pool) {
+   PCBSlab *slab;
+   int i;
+   
+   while (pool->slabs != NULL) {
+      slab = pool->slabs;
+      pool->slabs = slab->next;
+      
+      for (i = 0; i < PCB_SLAB_SIZE; i++) {
+         free(slab->pcbs[i].ioTraps);
+         free(slab->pcbs[i].traps);
+      }
+      
+      free(slab);
+   }
+   
+   free(pool);
+}
+
+PCBSlab *PCBSlab_constructor(void) {
+   PCBSlab *slab = malloc(sizeof(PCBSlab));
+   int i;
+   
+   for (i = 0; i < PCB_SLAB_SIZE; i++) {
+      slab->pcbs[i].ioTraps = NULL;
+      slab->pcbs[i].traps = NULL;
+      slab->pcbs[i].trapCapacity = 0;
+   }
+   
+   slab->next = NULL;
+   return slab;
+}
+
+PCB_Ptr PCBPool_acquire(PCBPool_Ptr pool, PCB_Type type) {
+   PCB_Ptr pcb;
+   int i;
+   
+   if (pool->freeList == NULL) {
+      PCBSlab *slab = PCBSlab_constructor();
+      slab->next = pool->slabs;
+      pool->slabs = slab;
+      
+      for (i = PCB_SLAB_SIZE - 1; i >= 0; i--) {
+         slab->pcbs[i].nextFree = pool->freeList;
+         pool->freeList = &slab->pcbs[i];
+      }
+   }
+   
+   pcb = pool->freeList;
+   pool->freeList = pcb->nextFree;
+   resetPCB(pcb, type);
+   return pcb;
+}
+
+void PCBPool_release(PCBPool_Ptr pool, PCB_Ptr pcb) {
+   pcb->nextFree = pool->freeList;
+   pool->freeList = pcb;
+}
+
+void resetPCB(PCB_Ptr pcb, PCB_Type type) {
    pcb->type = type;
    pcb->pairID = -1;
    pcb->origPriority = -1;
    pcb->curPriority = -1;
    pcb->promotedRuns = 0;
-   pcb->starvationTime = 0;
-   pcb->lockArray = calloc(2, sizeof(int));
-   pcb->unlockArray = calloc(2, sizeof(int));
+   pcb->headTime = 0;
+   pcb->vruntime = 0;
+   pcb->execStart = NO_EXEC_START;
+   pcb->treeParent = NULL;
+   pcb->treeLeft = NULL;
+   pcb->treeRight = NULL;
+   pcb->treeRed = 0;
+   pcb->treeOrder = 0;
    pcb->lockArray[0] = -1;
    pcb->lockArray[1] = -1;
    pcb->unlockArray[0] = -1;
    pcb->unlockArray[1] = -1;
    pcb->wait = -1;
    pcb->signal = -1;
+   pcb->waitingOn = NULL;
+   pcb->deadLocked = 0;
+   pcb->boostedFrom = -1;
+   pcb->inverted = 0;
+   pcb->invertedSince = 0;
+   pcb->readyCPU = 0;
    pcb->curState = New;
    pcb->PID = 0;
    pcb->pc = 0;
    pcb->sw = 0;
-   pcb->creation = -1;
-   pcb->termination = -1;
+   pcb->creation = UINT64_MAX;
+   pcb->termination = UINT64_MAX;
    pcb->terminate = 0;
    pcb->termCount = 0;
-   pcb->io_1_trap = calloc(4, sizeof(int));
-   pcb->io_2_trap = calloc(4, sizeof(int)); 
-   return pcb;
+   pcb->readySince = 0;
+   pcb->blockedSince = 0;
+   pcb->readyWait = 0;
+   pcb->blockedTime = 0;
+   pcb->dispatched = 0;
+   // the trap arrays are kept for the next process that gets this pcb
+   pcb->ioTrapCount = 0;
+   pcb->ioBlock = 0;
+   pcb->trapCount = 0;
+   pcb->nextTrap = 0;
+   pcb->nextFree = NULL;
+}
+
+void addTrap(PCB_Ptr pcb, int pc, Trap_Kind kind, int device) {
+   if (pc < 0) return;
+   
+   pcb->traps[pcb->trapCount].pc = pc;
+   pcb->traps[pcb->trapCount].kinds = kind;
+   pcb->traps[pcb->trapCount].device = kind == IO_point ? device : -1;
+   pcb->trapCount++;
+}
+
+int compareTraps(const void *one, const void *two) {
+   const TrapEntry *first = one, *second = two;
+   
+   if (first->pc != second->pc) {
+      return first->pc < second->pc ? -1 : 1;
+   }
+   
+   // io traps at the same pc are ordered by device, so the lower device comes first
+   return (first->device > second->device) - (first->device < second->device);
+}
+
+void PCB_reserveTraps(PCB_Ptr pcb, int count) {
+   if (pcb->traps != NULL && count <= pcb->trapCapacity) return;
+   
+   if (count < IO_TRAPS) {
+      count = IO_TRAPS;
+   }
+   
+   pcb->ioTraps = realloc(pcb->ioTraps, sizeof(IoTrap) * count);
+   pcb->traps = realloc(pcb->traps, sizeof(TrapEntry) * (count + SYN_TRAPS));
+   pcb->trapCapacity = count;
+}
+
+void buildTrapSchedule(PCB_Ptr pcb) {
+   int i, merged;
+   PCB_reserveTraps(pcb, pcb->ioTrapCount);
+   pcb->trapCount = 0;
+   
+   if (pcb->type == ProducerConsumer || pcb->type == MutualResource) {
+      for (i = 0; i < 2; i++) {
+         addTrap(pcb, pcb->lockArray[i], Lock_point, -1);
+         addTrap(pcb, pcb->unlockArray[i], Unlock_point, -1);
+      }
+      
+      addTrap(pcb, pcb->wait, Wait_point, -1);
+      addTrap(pcb, pcb->signal, Signal_point, -1);
+   }
+   
+   for (i = 0; i < pcb->ioTrapCount; i++) {
+      addTrap(pcb, pcb->ioTraps[i].pc, IO_point, pcb->ioTraps[i].device);
+   }
+   
+   qsort(pcb->traps, pcb->trapCount, sizeof(TrapEntry), compareTraps);
+   merged = 0;
+   
+   // traps at the same pc become one entry, whose io trap needs the lowest device of them
+   for (i = 0; i < pcb->trapCount; i++) {
+      if (merged > 0 && pcb->traps[merged - 1].pc == pcb->traps[i].pc) {
+         if (pcb->traps[merged - 1].device == -1) {
+            pcb->traps[merged - 1].device = pcb->traps[i].device;
+         }
+         
+         pcb->traps[merged - 1].kinds |= pcb->traps[i].kinds;
+      } else {
+         pcb->traps[merged++] = pcb->traps[i];
+      }
+   }
+   
+   pcb->trapCount = merged;
+   PCB_seekTrap(pcb, pcb->pc);
+}
+
+void PCB_seekTrap(PCB_Ptr pcb, unsigned int pc) {
+   int low = 0, high = pcb->trapCount, mid;
+   
+   // binary search for the first entry with a pc greater than the given one
+   while (low < high) {
+      mid = (low + high) / 2;
+      
+      if (pcb->traps[mid].pc <= pc) {
+         low = mid + 1;
+      } else {
+         high = mid;
+      }
+   }
+   
+   pcb->nextTrap = low;
+}
+
+unsigned int PCB_getNextTrapPC(PCB_Ptr pcb) {
+   if (pcb->nextTrap < pcb->trapCount) {
+      return pcb->traps[pcb->nextTrap].pc;
+   }
+   
+   return NO_TRAP;
+}
+
+int PCB_takeTrap(PCB_Ptr pcb, int *device) {
+   *device = pcb->traps[pcb->nextTrap].device;
+   return pcb->traps[pcb->nextTrap++].kinds;
 }
 
 void PCB_setSynData(PCB_Ptr pcb, int lock0, int lock1, int unlock0, int unlock1, int wait, int signal) {
@@ -67,19 +280,36 @@ void PCB_setSynData(PCB_Ptr pcb, int lock0, int lock1, int unlock0, int unlock1,
    pcb->unlockArray[1] = unlock1;
    pcb->wait = wait;
    pcb->signal = signal;
+   buildTrapSchedule(pcb);
 }
 
-void PCB_setIoTraps(PCB_Ptr pcb) {
-    int temp[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+void PCB_setIoTraps(PCB_Ptr pcb, Rng_Ptr rng, int devices) {
+    // with more devices than io traps, a pcb gets one trap per device so every device is used
+    int i, count = devices > IO_TRAPS ? devices : IO_TRAPS;
+    PCB_reserveTraps(pcb, count);
+    pcb->ioTrapCount = count;
+    
+    for (i = 0; i < count; i++) {
+        pcb->ioTraps[i].pc = -1;
+        // with two devices the first half of the traps needs device 0, the second half device 1
+        pcb->ioTraps[i].device = i * devices / count;
+        pcb->ioTraps[i].pad = 0;
+    }
     
-    // io trap arrays contain valid values only when
+    // io trap array contains valid values only when
     // this is a IO, ProducerConsumer, or MutualResource type process
     if (pcb->type == IO || pcb->type == ProducerConsumer || pcb->type == MutualResource) {
-        fillArray(pcb, temp, 8, pcb->PID);
+        fillArray(pcb, pcb->ioTraps, count, rng);
     }
     
-    copyArray(temp, pcb->io_1_trap, 0, 4);
-    copyArray(temp, pcb->io_2_trap, 4, 8);
+    buildTrapSchedule(pcb);
+}
+
+void PCB_setIoTrapValues(PCB_Ptr pcb, int count, const IoTrap *traps) {
+    PCB_reserveTraps(pcb, count);
+    memcpy(pcb->ioTraps, traps, sizeof(IoTrap) * count);
+    pcb->ioTrapCount = count;
+    buildTrapSchedule(pcb);
 }
 
 /**
@@ -104,15 +334,13 @@ int min(int *array) {
    }
 }
 
-void fillArray(PCB_Ptr pcb, int *io_trap, int length, int seed) {
-
-    srand(time(NULL) + seed);
+void fillArray(PCB_Ptr pcb, IoTrap *io_trap, int length, Rng_Ptr rng) {
     int i, j, found, num;
     
     for (i = 0; i < length; i++) {
         // keep looping until find an unique number
         do {
-            num = rand() % 1500 + 100;
+            num = Rng_range(rng, 1500) + 100;
             found = 0;
             
             if (pcb->type == MutualResource && (min(pcb->lockArray) <= num && num <= max(pcb->unlockArray))) {
@@ -125,28 +353,20 @@ void fillArray(PCB_Ptr pcb, int *io_trap, int length, int seed) {
             }
             
             for (j = 0; j < i; j++) {
-                if (io_trap[j] == num) {
+                if (io_trap[j].pc == num) {
                     found = 1;
                     break;
                 }
             }
          } while (found == 1);
          
-         io_trap[i] = num;
+         io_trap[i].pc = num;
     }          
 }
 
-void copyArray(int *src, int *dest, int start, int end) {
-   int i = 0;
-   
-   while (start < end) {
-      dest[i] = src[start];
-      start++;
-      i++;
-   }
-}
-
 void PCB_destructor(PCB_Ptr pcb) {
+   free(pcb->ioTraps);
+   free(pcb->traps);
    free(pcb);
 }
 
@@ -195,19 +415,19 @@ int PCB_getSW(PCB_Ptr pcb) {
     return pcb->sw;
 }
 
-void PCB_setCreation(PCB_Ptr pcb, int creation) {
+void PCB_setCreation(PCB_Ptr pcb, uint64_t creation) {
    pcb->creation = creation;
 }
 
-int PCB_getCreation(PCB_Ptr pcb) {
+uint64_t PCB_getCreation(PCB_Ptr pcb) {
    return pcb->creation;
 }
 
-void PCB_setTermination(PCB_Ptr pcb, int termination) {
+void PCB_setTermination(PCB_Ptr pcb, uint64_t termination) {
    pcb->termination = termination;
 }
 
-int PCB_getTermination(PCB_Ptr pcb) {
+uint64_t PCB_getTermination(PCB_Ptr pcb) {
    return pcb->termination;
 }
 
@@ -227,12 +447,12 @@ int PCB_getTermCount(PCB_Ptr pcb) {
    return pcb->termCount;
 }
 
-int *PCB_getIo_1_trap(PCB_Ptr pcb) {
-   return pcb->io_1_trap;
+const IoTrap *PCB_getIoTraps(PCB_Ptr pcb) {
+   return pcb->ioTraps;
 }
 
-int *PCB_getIo_2_trap(PCB_Ptr pcb) {
-   return pcb->io_2_trap;
+int PCB_getIoTrapCount(PCB_Ptr pcb) {
+   return pcb->ioTrapCount;
 }
 
 void PCB_setOrigPriority(PCB_Ptr pcb, int priority) {
@@ -273,9 +493,7 @@ PCB_Type PCB_getType(PCB_Ptr pcb) {
 
 char *PCB_toString(const PCB_Ptr pcb) {
    char *str = calloc(PCB_STR_LEN, sizeof(char));
-   const char *states[] = {"New", "Ready", "Running", "Blocked", "Halted", "Interrupted", "Idle", "Terminated"};
-   const char *types[] = {"IO", "Compute", "ProducerConsumer", "MutualResource"};
-   sprintf(str, "PID: %d, Priority: %d, State: %s, PC: %d, SW: %d, Terminatate: %d, Type: %s", pcb->PID, pcb->curPriority, 
-   states[pcb->curState], pcb->pc, pcb->sw, pcb->terminate, types[pcb->type]);
+   snprintf(str, PCB_STR_LEN, "PID: %d, Priority: %d, State: %s, PC: %d, SW: %d, Terminatate: %d, Type: %s", pcb->PID, pcb->curPriority, 
+   PCB_stateNames[pcb->curState], pcb->pc, pcb->sw, pcb->terminate, PCB_typeNames[pcb->type]);
    return str;
 }
\ No newline at end of file
@@ -16,40 +16,111 @@
 
 #ifndef PCB_H
 #define PCB_H
-#define PCB_STR_LEN 50 // number of chars that a string can hold
+#include "rng.h"
+#define PCB_STR_LEN 120 // number of chars that a string can hold
 #define MAX_PC 2345 // max value of a pc can be
+#define IO_TRAPS 8 // min number of io traps of a pcb of the built-in workload
+#define MAX_IO_TRAPS 65535 // max number of io traps of a pcb, the most a workload record can have
+#define MAX_DEVICES 16 // max number of io devices a simulation can have
+#define SYN_TRAPS 6 // number of sync traps of a pcb: two locks, two unlocks, wait and signal
+#define NO_TRAP 0xFFFFFFFFu // pc returned when a pcb has no trap left
+#define PCB_SLAB_SIZE 64 // number of PCBs allocated at once by a PCB pool
+#define NO_EXEC_START UINT64_MAX // execStart of a pcb that isn't running
 
 // This defines an enum type for all conditions that a PCB can have
 // Idle is only used for the PCB of Idle task
 typedef enum {New, Ready, Running, Blocked, Halted, Interrupted, Idle, Terminated} State;
 typedef enum {IO, Compute, ProducerConsumer, MutualResource} PCB_Type;
+#define PCB_TYPES (MutualResource + 1) // number of PCB_Type values
+// This defines kinds of traps that can be at a pc, one pc can have several of them
+typedef enum {Lock_point = 1, Unlock_point = 2, Wait_point = 4, Signal_point = 8, IO_point = 16} Trap_Kind;
+#define SYN_POINTS (Lock_point | Unlock_point | Wait_point | Signal_point)
 
-// This defines a PCB type
+// This defines an io trap of a PCB, workload files list io traps the same way
+typedef struct {
+   int16_t pc; // pc of the trap, -1 when there is none
+   uint8_t device; // device the trap needs
+   uint8_t pad;
+} IoTrap;
+
+// This defines an entry of the trap schedule of a PCB
 typedef struct {
+   unsigned int pc; // pc where traps happen
+   int kinds; // Trap_Kind values of all traps at this pc
+   int device; // device the io trap at this pc needs, -1 when there is none
+} TrapEntry;
+
+struct mutex; // defined in syn.h
+
+// This defines a PCB type
+typedef struct pcb {
    PCB_Type type; // this is for type of this pcb
    int pairID;  // this is for producer consumer or mutual resource users pair
    int origPriority; // original priority of this pcb, used for starvation prevention
    int curPriority; // current priority of this pcb, used for starvation prevention
    int promotedRuns; // number of runs this pcb can be promoted
-   int starvationTime; // keep track of time this pcb stays in the head of a queue in the priority queue
-   int *lockArray; // an array holding lock values
-   int *unlockArray; // an array holding unlock values
+   uint64_t headTime; // aging clock of the priority queue when this pcb reached the head of one of its queues
+   uint64_t vruntime; // weighted virtual runtime, used by the fair queue
+   uint64_t execStart; // clock of the fair queue when this pcb started running, NO_EXEC_START when it isn't
+   struct pcb *treeParent; // links of this pcb in the red-black tree of a fair queue
+   struct pcb *treeLeft;
+   struct pcb *treeRight;
+   int treeRed; // 1 when this pcb is a red node of the tree, 0 when it is black
+   uint64_t treeOrder; // enqueue number, orders pcbs with the same vruntime
+   int lockArray[2]; // an array holding lock values
+   int unlockArray[2]; // an array holding unlock values
    int wait; // a value for wait()
    int signal; // a value for signal()
+   struct mutex *waitingOn; // mutex this pcb is blocked on, its edge in the wait-for graph, NULL when there is none
+   int deadLocked; // 1 while this pcb is in a cycle of the wait-for graph
+   int boostedFrom; // priority this pcb returns to when it stops inheriting one from pcbs waiting for its mutexes, -1 when not boosted
+   int inverted; // 1 while this pcb waits for a mutex held by a pcb of lower priority
+   uint64_t invertedSince; // system time the priority inversion this pcb waits in started
+   int readyCPU; // cpu whose ready queue holds this pcb while it is ready
    State curState; // shows current state of PCB
    int PID; // a process ID given to this PCB
    unsigned int pc; // a program counter of a process related to this PCB
    int sw; // state work of a process related to this PCB
-   int creation; // creation time of a process
-   int termination; // termination time of a process 
+   uint64_t creation; // creation time of a process, UINT64_MAX before it is set
+   uint64_t termination; // termination time of a process, UINT64_MAX before it is set
    int terminate; // a control field deciding when a process is terminated
    int termCount; // a counter keeping track of number of times that passes the MAX_PC value
-   int *io_1_trap; // an array for io trap values
-   int *io_2_trap; // another array for io trap values
+   uint64_t readySince; // system time this pcb last became ready
+   uint64_t blockedSince; // system time this pcb last started waiting for I/O, a lock or a condition
+   uint64_t readyWait; // number of cycles this pcb spent in ready queues
+   uint64_t blockedTime; // number of cycles this pcb spent waiting for I/O, locks and conditions
+   int dispatched; // 1 once this pcb has run
+   IoTrap *ioTraps; // io traps of this pcb in no particular order
+   int ioTrapCount; // number of entries in ioTraps
+   unsigned int ioBlock; // block address of the io request this pcb waits for
+   TrapEntry *traps; // all trap values above sorted by pc
+   int trapCount; // number of entries in traps
+   // number of io traps ioTraps has room for, traps has room for SYN_TRAPS more. A pcb keeps
+   // both arrays while it is in the free list of its pool, so reusing it allocates nothing.
+   int trapCapacity;
+   int nextTrap; // index of the entry for the next trap this pcb reaches
+   struct pcb *nextFree; // next PCB in the free list of a PCB pool, only used while this PCB is free
 } PCB;
 
 typedef PCB *PCB_Ptr; // This defines a PCB pointer type
 
+// This defines a block of PCBs allocated together by a PCB pool
+typedef struct pcbslab {
+   struct pcbslab *next;
+   PCB pcbs[PCB_SLAB_SIZE];
+} PCBSlab;
+
+// This defines a pool that recycles PCBs of terminated processes
+typedef struct {
+   PCBSlab *slabs; // all slabs allocated by this pool
+   PCB_Ptr freeList; // PCBs that can be handed out again
+} PCBPool;
+
+typedef PCBPool *PCBPool_Ptr; // This defines a PCB pool pointer type
+
+extern const char *PCB_stateNames[]; // names of State values, used when a PCB is printed
+extern const char *PCB_typeNames[]; // names of PCB_Type values, used when a PCB is printed
+
 /**
  * This is a constructor of this PCB type
  * return a pointer of newly created PCB
@@ -62,6 +133,34 @@ PCB_Ptr PCB_constructor(PCB_Type type);
  */
 void PCB_destructor(PCB_Ptr pcb);
 
+/**
+ * This is a constructor of the PCB pool type
+ * return a pointer of newly created pool without any PCB
+ */
+PCBPool_Ptr PCBPool_constructor(void);
+
+/**
+ * This frees the pool and every PCB it has handed out
+ */
+void PCBPool_destructor(PCBPool_Ptr pool);
+
+/**
+ * This allocates a slab of PCBs without trap arrays, the caller links it into a pool
+ */
+PCBSlab *PCBSlab_constructor(void);
+
+/**
+ * This takes a PCB from the free list of the pool, or from a new slab when
+ * the free list is empty, and initializes it like PCB_constructor() does
+ * return a pointer of the PCB
+ */
+PCB_Ptr PCBPool_acquire(PCBPool_Ptr pool, PCB_Type type);
+
+/**
+ * This puts a PCB handed out by the pool back to its free list
+ */
+void PCBPool_release(PCBPool_Ptr pool, PCB_Ptr pcb);
+
 /**
  * This is a setter for process ID
  * PCB_Ptr pcb is the PCB where you set new PID
@@ -141,30 +240,30 @@ char *PCB_toString(const PCB_Ptr pcb);
 /*
 * This is a setter for creation
 * PCB_Ptr pcb is the PCB where you set creation time
-* int creation is the creation time
+* uint64_t creation is the creation time
 */
-void PCB_setCreation(PCB_Ptr pcb, int creation);
+void PCB_setCreation(PCB_Ptr pcb, uint64_t creation);
 
 /**
 * This is a getter for creation
 * PCB_Ptr pcb is the PCB where you get creation time
 * return creation time stored in the PCB
 */
-int PCB_getCreation(PCB_Ptr pcb);
+uint64_t PCB_getCreation(PCB_Ptr pcb);
 
 /**
 * This is a setter for termination 
 * PCB_Ptr pcb is the PCB where you set termination time
-* int termination is the termination time
+* uint64_t termination is the termination time
 */
-void PCB_setTermination(PCB_Ptr pcb, int termination);
+void PCB_setTermination(PCB_Ptr pcb, uint64_t termination);
 
 /**
 * This is a getter for termination
 * PCB_Ptr pcb is the PCB where you get termination time
 * return termination time stored in the PCB
 */
-int PCB_getTermination(PCB_Ptr pcb);
+uint64_t PCB_getTermination(PCB_Ptr pcb);
 
 /**
 * This is a setter for terminate
@@ -188,23 +287,34 @@ int PCB_getTerminate(PCB_Ptr pcb);
 int PCB_getTermCount(PCB_Ptr pcb);
 
 /**
-* This initializes the io_trap arrays in the given PCB.
+* This initializes the io traps in the given PCB with random pcs taken
+* from rng, spread evenly over the given number of devices. The PCB gets
+* IO_TRAPS io traps, or one per device when there are more devices.
 */
-void PCB_setIoTraps(PCB_Ptr pcb);
+void PCB_setIoTraps(PCB_Ptr pcb, Rng_Ptr rng, int devices);
 
 /**
-* This is a getter for io_trap 1 array
-* PCB_Ptr pcb is the PCB where you get this array
-* return the array in the PCB
+* This sets the io traps in the given PCB to the count given ones, a
+* negative pc means there is no trap.
 */
-int *PCB_getIo_1_trap(PCB_Ptr pcb);
+void PCB_setIoTrapValues(PCB_Ptr pcb, int count, const IoTrap *traps);
 
 /**
-* This is a getter for io_trap 2 array
+* This is a getter for the io traps
 * PCB_Ptr pcb is the PCB where you get this array
-* return the array in the PCB
+* return the array in the PCB, which has PCB_getIoTrapCount() entries
 */
-int *PCB_getIo_2_trap(PCB_Ptr pcb);
+const IoTrap *PCB_getIoTraps(PCB_Ptr pcb);
+
+/**
+* returns number of io traps of this pcb
+*/
+int PCB_getIoTrapCount(PCB_Ptr pcb);
+
+/**
+* This makes room for count io traps, and the trap schedule they go into, in the given PCB
+*/
+void PCB_reserveTraps(PCB_Ptr pcb, int count);
 
 /**
 * a setter for original priority of this pcb
@@ -255,4 +365,21 @@ PCB_Type PCB_getType(PCB_Ptr pcb);
 * set values for locks, unlocks, wait, and signal
 */
 void PCB_setSynData(PCB_Ptr pcb, int lock0, int lock1, int unlock0, int unlock1, int wait, int signal);
+
+/**
+* moves the trap cursor of this pcb to the first trap after the given pc,
+* used when this pcb is dispatched
+*/
+void PCB_seekTrap(PCB_Ptr pcb, unsigned int pc);
+
+/**
+* returns pc of the next trap this pcb reaches, or NO_TRAP when there is none
+*/
+unsigned int PCB_getNextTrapPC(PCB_Ptr pcb);
+
+/**
+* returns Trap_Kind values of the next trap and moves the trap cursor past it, the device
+* its io trap needs is stored in device
+*/
+int PCB_takeTrap(PCB_Ptr pcb, int *device);
 #endif
\ No newline at end of file
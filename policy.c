@@ -0,0 +1,457 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "priority_queue.h"
+#include "fair_queue.h"
+#include "policy.h"
+
+/**
+* These adapt the priority queue, which ages pcbs and promotes the starving ones, to the
+* hooks of the multi-level feedback queue policy
+*/
+void *mlfqConstructor(int levels, unsigned int starvationTime);
+void mlfqDestructor(void *queue);
+void mlfqEnqueue(void *queue, PCB_Ptr pcb);
+void mlfqReprioritize(void *queue, PCB_Ptr pcb, int priority);
+PCB_Ptr mlfqPickNext(void *queue);
+int mlfqSize(void *queue);
+void mlfqLevelSizes(void *queue, int *sizes);
+void mlfqAge(void *queue, unsigned int cycles);
+unsigned int mlfqQuietCycles(void *queue);
+void mlfqSetStarvationTime(void *queue, unsigned int starvationTime);
+void mlfqSave(void *queue, Snapshot_Ptr snapshot);
+void mlfqRestore(void *queue, Snapshot_Ptr snapshot);
+
+/**
+* These are the hooks of the first come first served and round robin policies, both keep
+* ready pcbs in one queue in order of arrival
+*/
+void *fifoConstructor(int levels, unsigned int starvationTime);
+void fifoDestructor(void *queue);
+void fifoEnqueue(void *queue, PCB_Ptr pcb);
+PCB_Ptr fifoPickNext(void *queue);
+int fifoSize(void *queue);
+void fifoLevelSizes(void *queue, int *sizes);
+void fifoSave(void *queue, Snapshot_Ptr snapshot);
+void fifoRestore(void *queue, Snapshot_Ptr snapshot);
+
+/**
+* These are the hooks of the shortest remaining work policy
+*/
+void *srwConstructor(int levels, unsigned int starvationTime);
+void srwDestructor(void *queue);
+void srwEnqueue(void *queue, PCB_Ptr pcb);
+PCB_Ptr srwPickNext(void *queue);
+int srwSize(void *queue);
+void srwLevelSizes(void *queue, int *sizes);
+void srwSave(void *queue, Snapshot_Ptr snapshot);
+void srwRestore(void *queue, Snapshot_Ptr snapshot);
+
+/**
+* These adapt the fair queue to the hooks of the completely fair policy
+*/
+void *cfsConstructor(int levels, unsigned int starvationTime);
+void cfsDestructor(void *queue);
+void cfsEnqueue(void *queue, PCB_Ptr pcb);
+PCB_Ptr cfsPickNext(void *queue);
+int cfsSize(void *queue);
+void cfsLevelSizes(void *queue, int *sizes);
+int cfsTick(void *queue, PCB_Ptr running);
+int cfsTimeSlice(void *queue, PCB_Ptr pcb, int timerCounter);
+void cfsBlock(void *queue, PCB_Ptr pcb);
+void cfsWake(void *queue, PCB_Ptr pcb);
+void cfsAge(void *queue, unsigned int cycles);
+void cfsSave(void *queue, Snapshot_Ptr snapshot);
+void cfsRestore(void *queue, Snapshot_Ptr snapshot);
+
+/**
+* returns 1 if entry i of the heap goes before entry j
+*/
+int workHeapBefore(WorkHeap_Ptr heap, int i, int j);
+
+/**
+* swaps entries i and j of the heap
+*/
+void workHeapSwap(WorkHeap_Ptr heap, int i, int j);
+
+/**
+* These are hooks shared by policies that need them: a quantum tick that always or never
+* preempts, a fixed quantum, blocking that changes nothing, priorities that don't change the
+* order of the queue, and queues that don't change with time
+*/
+int preemptTick(void *queue, PCB_Ptr running);
+int keepTick(void *queue, PCB_Ptr running);
+int keepTimer(void *queue, PCB_Ptr pcb, int timerCounter);
+void ignoreBlock(void *queue, PCB_Ptr pcb);
+void setPriority(void *queue, PCB_Ptr pcb, int priority);
+void ignoreAge(void *queue, unsigned int cycles);
+unsigned int alwaysQuiet(void *queue);
+void ignoreStarvationTime(void *queue, unsigned int starvationTime);
+
+const Policy Policy_table[POLICIES] = {
+   {"mlfq", mlfqConstructor, mlfqDestructor, mlfqEnqueue, mlfqPickNext, mlfqSize, mlfqLevelSizes, preemptTick,
+      keepTimer, ignoreBlock, mlfqEnqueue, mlfqReprioritize, mlfqAge, mlfqQuietCycles, mlfqSetStarvationTime,
+      mlfqSave, mlfqRestore},
+   {"fcfs", fifoConstructor, fifoDestructor, fifoEnqueue, fifoPickNext, fifoSize, fifoLevelSizes, keepTick,
+      keepTimer, ignoreBlock, fifoEnqueue, setPriority, ignoreAge, alwaysQuiet, ignoreStarvationTime,
+      fifoSave, fifoRestore},
+   {"rr", fifoConstructor, fifoDestructor, fifoEnqueue, fifoPickNext, fifoSize, fifoLevelSizes, preemptTick,
+      keepTimer, ignoreBlock, fifoEnqueue, setPriority, ignoreAge, alwaysQuiet, ignoreStarvationTime,
+      fifoSave, fifoRestore},
+   {"srw", srwConstructor, srwDestructor, srwEnqueue, srwPickNext, srwSize, srwLevelSizes, preemptTick,
+      keepTimer, ignoreBlock, srwEnqueue, setPriority, ignoreAge, alwaysQuiet, ignoreStarvationTime,
+      srwSave, srwRestore},
+   {"cfs", cfsConstructor, cfsDestructor, cfsEnqueue, cfsPickNext, cfsSize, cfsLevelSizes, cfsTick,
+      cfsTimeSlice, cfsBlock, cfsWake, setPriority, cfsAge, alwaysQuiet, ignoreStarvationTime,
+      cfsSave, cfsRestore}
+};
+
+Policy_Ptr Policy_find(const char *name, size_t length) {
+   int i;
+
+   for (i = 0; i < POLICIES; i++) {
+      if (strlen(Policy_table[i].name) == length && strncmp(Policy_table[i].name, name, length) == 0) {
+         return &Policy_table[i];
+      }
+   }
+
+   return NULL;
+}
+
+uint64_t Policy_remainingWork(PCB_Ptr pcb) {
+   int rounds = PCB_getTerminate(pcb) - PCB_getTermCount(pcb);
+
+   if (rounds <= 0) {
+      return UINT64_MAX;
+   }
+
+   // the pcb terminates when its pc reaches MAX_PC in its last round
+   return (uint64_t) (rounds - 1) * MAX_PC + MAX_PC - PCB_getPC(pcb);
+}
+
+void *mlfqConstructor(int levels, unsigned int starvationTime) {
+   return PriorityQueue_constructor(levels, starvationTime);
+}
+
+void mlfqDestructor(void *queue) {
+   PriorityQueue_destructor(queue);
+}
+
+void mlfqEnqueue(void *queue, PCB_Ptr pcb) {
+   PriorityQueue_enqueue(queue, pcb);
+}
+
+void mlfqReprioritize(void *queue, PCB_Ptr pcb, int priority) {
+   PriorityQueue_reprioritize(queue, pcb, priority);
+}
+
+PCB_Ptr mlfqPickNext(void *queue) {
+   return PriorityQueue_dequeue(queue);
+}
+
+int mlfqSize(void *queue) {
+   return PriorityQueue_size(queue);
+}
+
+void mlfqLevelSizes(void *queue, int *sizes) {
+   PriorityQueue_Ptr priorityQueue = queue;
+   int i;
+
+   for (i = 0; i < priorityQueue->levels; i++) {
+      sizes[i] += Queue_size(priorityQueue->queueArray[i]);
+   }
+}
+
+void mlfqAge(void *queue, unsigned int cycles) {
+   PriorityQueue_age(queue, cycles);
+}
+
+unsigned int mlfqQuietCycles(void *queue) {
+   return PriorityQueue_cyclesToPromotion(queue);
+}
+
+void mlfqSetStarvationTime(void *queue, unsigned int starvationTime) {
+   PriorityQueue_setStarvationTime(queue, starvationTime);
+}
+
+void mlfqSave(void *queue, Snapshot_Ptr snapshot) {
+   PriorityQueue_save(queue, snapshot);
+}
+
+void mlfqRestore(void *queue, Snapshot_Ptr snapshot) {
+   PriorityQueue_restore(queue, snapshot);
+}
+
+void *fifoConstructor(int levels, unsigned int starvationTime) {
+   (void) levels;
+   (void) starvationTime;
+   return Queue_constructor();
+}
+
+void fifoDestructor(void *queue) {
+   Queue_destructor(queue);
+}
+
+void fifoEnqueue(void *queue, PCB_Ptr pcb) {
+   Queue_enqueue(queue, pcb);
+}
+
+PCB_Ptr fifoPickNext(void *queue) {
+   return Queue_isEmpty(queue) ? NULL : Queue_dequeue(queue);
+}
+
+int fifoSize(void *queue) {
+   return Queue_size(queue);
+}
+
+void fifoLevelSizes(void *queue, int *sizes) {
+   sizes[0] += Queue_size(queue);
+}
+
+void fifoSave(void *queue, Snapshot_Ptr snapshot) {
+   Queue_save(queue, snapshot);
+}
+
+void fifoRestore(void *queue, Snapshot_Ptr snapshot) {
+   Queue_restore(queue, snapshot);
+}
+
+void *srwConstructor(int levels, unsigned int starvationTime) {
+   WorkHeap_Ptr heap = malloc(sizeof(WorkHeap));
+   (void) levels;
+   (void) starvationTime;
+   heap->pcbs = NULL;
+   heap->keys = NULL;
+   heap->order = NULL;
+   heap->enqueued = 0;
+   heap->size = 0;
+   heap->capacity = 0;
+   return heap;
+}
+
+void srwDestructor(void *queue) {
+   WorkHeap_Ptr heap = queue;
+   free(heap->pcbs);
+   free(heap->keys);
+   free(heap->order);
+   free(heap);
+}
+
+int workHeapBefore(WorkHeap_Ptr heap, int i, int j) {
+   return heap->keys[i] < heap->keys[j] || (heap->keys[i] == heap->keys[j] && heap->order[i] < heap->order[j]);
+}
+
+void workHeapSwap(WorkHeap_Ptr heap, int i, int j) {
+   PCB_Ptr pcb = heap->pcbs[i];
+   uint64_t key = heap->keys[i];
+   uint64_t order = heap->order[i];
+   heap->pcbs[i] = heap->pcbs[j];
+   heap->keys[i] = heap->keys[j];
+   heap->order[i] = heap->order[j];
+   heap->pcbs[j] = pcb;
+   heap->keys[j] = key;
+   heap->order[j] = order;
+}
+
+void srwEnqueue(void *queue, PCB_Ptr pcb) {
+   WorkHeap_Ptr heap = queue;
+   int i = heap->size++;
+
+   if (heap->size > heap->capacity) {
+      heap->capacity = heap->capacity ? 2 * heap->capacity : 64;
+      heap->pcbs = realloc(heap->pcbs, sizeof(PCB_Ptr) * heap->capacity);
+      heap->keys = realloc(heap->keys, sizeof(uint64_t) * heap->capacity);
+      heap->order = realloc(heap->order, sizeof(uint64_t) * heap->capacity);
+   }
+
+   // the pc of a pcb only changes while it runs, so its key stays valid while it is queued
+   heap->pcbs[i] = pcb;
+   heap->keys[i] = Policy_remainingWork(pcb);
+   heap->order[i] = heap->enqueued++;
+
+   while (i > 0 && workHeapBefore(heap, i, (i - 1) / 2)) {
+      workHeapSwap(heap, i, (i - 1) / 2);
+      i = (i - 1) / 2;
+   }
+}
+
+PCB_Ptr srwPickNext(void *queue) {
+   WorkHeap_Ptr heap = queue;
+   PCB_Ptr pcb;
+   int i = 0, child;
+
+   if (heap->size == 0) {
+      return NULL;
+   }
+
+   pcb = heap->pcbs[0];
+   heap->size--;
+   workHeapSwap(heap, 0, heap->size);
+
+   for (child = 1; child < heap->size; child = 2 * i + 1) {
+      if (child + 1 < heap->size && workHeapBefore(heap, child + 1, child)) {
+         child++;
+      }
+
+      if (!workHeapBefore(heap, child, i)) {
+         break;
+      }
+
+      workHeapSwap(heap, i, child);
+      i = child;
+   }
+
+   return pcb;
+}
+
+int srwSize(void *queue) {
+   return ((WorkHeap_Ptr) queue)->size;
+}
+
+void srwLevelSizes(void *queue, int *sizes) {
+   sizes[0] += ((WorkHeap_Ptr) queue)->size;
+}
+
+void srwSave(void *queue, Snapshot_Ptr snapshot) {
+   WorkHeap_Ptr heap = queue;
+   int i;
+   Snapshot_write(snapshot, &heap->size, sizeof(heap->size));
+   Snapshot_write(snapshot, &heap->enqueued, sizeof(heap->enqueued));
+
+   // the entries are written in heap order, so the heap needs no rebuilding
+   for (i = 0; i < heap->size; i++) {
+      Snapshot_writePCB(snapshot, heap->pcbs[i]);
+   }
+
+   Snapshot_write(snapshot, heap->keys, sizeof(uint64_t) * heap->size);
+   Snapshot_write(snapshot, heap->order, sizeof(uint64_t) * heap->size);
+}
+
+void srwRestore(void *queue, Snapshot_Ptr snapshot) {
+   WorkHeap_Ptr heap = queue;
+   int i, size;
+   Snapshot_read(snapshot, &size, sizeof(size));
+   Snapshot_read(snapshot, &heap->enqueued, sizeof(heap->enqueued));
+
+   if (size < 0 || size > Snapshot_pcbCount(snapshot)) {
+      Snapshot_fail(snapshot);
+      return;
+   }
+
+   heap->capacity = size;
+   heap->pcbs = malloc(sizeof(PCB_Ptr) * (size ? size : 1));
+   heap->keys = malloc(sizeof(uint64_t) * (size ? size : 1));
+   heap->order = malloc(sizeof(uint64_t) * (size ? size : 1));
+
+   for (i = 0; i < size; i++) {
+      heap->pcbs[i] = Snapshot_readPCB(snapshot);
+
+      if (heap->pcbs[i] == NULL) {
+         Snapshot_fail(snapshot);
+      }
+   }
+
+   Snapshot_read(snapshot, heap->keys, sizeof(uint64_t) * size);
+   Snapshot_read(snapshot, heap->order, sizeof(uint64_t) * size);
+   heap->size = snapshot->failed ? 0 : size;
+}
+
+void *cfsConstructor(int levels, unsigned int starvationTime) {
+   (void) levels;
+   (void) starvationTime;
+   return FairQueue_constructor();
+}
+
+void cfsDestructor(void *queue) {
+   FairQueue_destructor(queue);
+}
+
+void cfsEnqueue(void *queue, PCB_Ptr pcb) {
+   FairQueue_enqueue(queue, pcb);
+}
+
+PCB_Ptr cfsPickNext(void *queue) {
+   return FairQueue_dequeue(queue);
+}
+
+int cfsSize(void *queue) {
+   return FairQueue_size(queue);
+}
+
+void cfsLevelSizes(void *queue, int *sizes) {
+   sizes[0] += FairQueue_size(queue);
+}
+
+int cfsTick(void *queue, PCB_Ptr running) {
+   (void) running;
+   // a pcb alone on its cpu runs on into a new slice
+   return FairQueue_size(queue) > 0;
+}
+
+int cfsTimeSlice(void *queue, PCB_Ptr pcb, int timerCounter) {
+   (void) timerCounter;
+   return FairQueue_timeSlice(queue, pcb);
+}
+
+void cfsBlock(void *queue, PCB_Ptr pcb) {
+   FairQueue_block(queue, pcb);
+}
+
+void cfsWake(void *queue, PCB_Ptr pcb) {
+   FairQueue_wake(queue, pcb);
+}
+
+void cfsAge(void *queue, unsigned int cycles) {
+   FairQueue_age(queue, cycles);
+}
+
+void cfsSave(void *queue, Snapshot_Ptr snapshot) {
+   FairQueue_save(queue, snapshot);
+}
+
+void cfsRestore(void *queue, Snapshot_Ptr snapshot) {
+   FairQueue_restore(queue, snapshot);
+}
+
+int preemptTick(void *queue, PCB_Ptr running) {
+   (void) queue;
+   (void) running;
+   return 1;
+}
+
+int keepTick(void *queue, PCB_Ptr running) {
+   (void) queue;
+   (void) running;
+   return 0;
+}
+
+int keepTimer(void *queue, PCB_Ptr pcb, int timerCounter) {
+   (void) queue;
+   (void) pcb;
+   return timerCounter;
+}
+
+void ignoreBlock(void *queue, PCB_Ptr pcb) {
+   (void) queue;
+   (void) pcb;
+}
+
+void setPriority(void *queue, PCB_Ptr pcb, int priority) {
+   (void) queue;
+   PCB_setCurPriority(pcb, priority);
+}
+
+void ignoreAge(void *queue, unsigned int cycles) {
+   (void) queue;
+   (void) cycles;
+}
+
+unsigned int alwaysQuiet(void *queue) {
+   (void) queue;
+   return UINT_MAX;
+}
+
+void ignoreStarvationTime(void *queue, unsigned int starvationTime) {
+   (void) queue;
+   (void) starvationTime;
+}
@@ -0,0 +1,93 @@
+/**
+* policy.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the interface of scheduling policies. A policy owns the ready
+* queue of each cpu and decides which pcb runs next. The simulation looks its policy up once
+* when it is created and calls it only through the hooks below.
+*
+*/
+
+#ifndef POLICY_H
+#define POLICY_H
+#include <stddef.h>
+#include <stdint.h>
+#include "pcb.h"
+#include "snapshot.h"
+
+// This defines the policies a simulation can use
+typedef enum {MLFQ_policy, FCFS_policy, RR_policy, SRW_policy, CFS_policy, POLICIES} Policy_Type;
+
+// This defines the hooks of a policy, queue is a ready queue made by the constructor
+typedef struct {
+   const char *name; // name of the policy on the command line and in the summary
+   void *(*constructor)(int levels, unsigned int starvationTime);
+   void (*destructor)(void *queue);
+   // adds a pcb that is new or was preempted
+   void (*enqueue)(void *queue, PCB_Ptr pcb);
+   // removes and returns the pcb to run next, NULL when the queue is empty
+   PCB_Ptr (*pickNext)(void *queue);
+   int (*size)(void *queue);
+   // adds the number of pcbs at each level of the queue to sizes, which holds a count for each
+   // of the levels the queue was made with, a policy with a single queue counts all its pcbs at level 0
+   void (*levelSizes)(void *queue, int *sizes);
+   // called when the time quantum of the running pcb ends, returns 1 when it is preempted
+   int (*onTick)(void *queue, PCB_Ptr running);
+   // returns the timer counter for a pcb that starts or keeps running, policies with a fixed
+   // quantum return timerCounter, so the timer runs on across context switches
+   int (*timeSlice)(void *queue, PCB_Ptr pcb, int timerCounter);
+   // called when the running pcb waits for I/O, a lock or a condition
+   void (*onBlock)(void *queue, PCB_Ptr pcb);
+   // adds a pcb that stopped waiting
+   void (*onWake)(void *queue, PCB_Ptr pcb);
+   // changes the current priority of a pcb in the queue, when it inherits the priority of a
+   // pcb waiting for its mutex and when it gives that priority back
+   void (*reprioritize)(void *queue, PCB_Ptr pcb, int priority);
+   // advances the queue over the given number of cycles
+   void (*age)(void *queue, unsigned int cycles);
+   // returns number of cycles age() can advance before the order of the queue changes, UINT_MAX for never
+   unsigned int (*quietCycles)(void *queue);
+   void (*setStarvationTime)(void *queue, unsigned int starvationTime);
+   // writes the queue to a snapshot, and reads it back into a queue the constructor just made
+   void (*save)(void *queue, Snapshot_Ptr snapshot);
+   void (*restore)(void *queue, Snapshot_Ptr snapshot);
+} Policy;
+
+typedef const Policy *Policy_Ptr;
+
+// This is the queue of the shortest remaining work policy, a binary heap of pcbs
+typedef struct {
+   PCB_Ptr *pcbs;
+   uint64_t *keys; // remaining work of each pcb, ties go to the pcb enqueued first
+   uint64_t *order; // enqueue number of each pcb
+   uint64_t enqueued; // number of pcbs enqueued so far
+   int size;
+   int capacity;
+} WorkHeap;
+
+typedef WorkHeap *WorkHeap_Ptr;
+
+/**
+* all policies, indexed by Policy_Type
+*/
+extern const Policy Policy_table[POLICIES];
+
+/**
+* returns the policy whose name is the first length chars of name, or NULL when there is none
+*/
+Policy_Ptr Policy_find(const char *name, size_t length);
+
+/**
+* returns the number of cycles the pcb runs before it terminates, UINT64_MAX when it never does
+*/
+uint64_t Policy_remainingWork(PCB_Ptr pcb);
+
+#endif
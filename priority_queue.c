@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include "pcb.h"
 #include "queue.h"
 #include "priority_queue.h"
@@ -10,166 +11,418 @@
 */
 void promotePCB(PriorityQueue_Ptr priorityQueue, int origPriority);
 
-PriorityQueue_Ptr PriorityQueue_constructor(void) {
+/**
+* returns the first non-empty priority level at or below the given one, or number of levels
+* when all of them are empty
+*/
+int nextLevel(PriorityQueue_Ptr priorityQueue, int level);
+
+/**
+* returns clock of the call that promotes the head of the given level
+*/
+uint64_t headDeadline(PriorityQueue_Ptr priorityQueue, int level);
+
+/**
+* sets the promotion deadline to that of the head at the top of the deadline heap
+*/
+void updateDeadline(PriorityQueue_Ptr priorityQueue);
+
+/**
+* returns 1 when the head of the level at heap position i is promoted before that of position j
+*/
+int heapBefore(PriorityQueue_Ptr priorityQueue, int i, int j);
+
+/**
+* swaps the levels at heap positions i and j
+*/
+void heapSwap(PriorityQueue_Ptr priorityQueue, int i, int j);
+
+/**
+* moves the level at heap position i up while its head is promoted before that of its parent
+*/
+void heapSiftUp(PriorityQueue_Ptr priorityQueue, int i);
+
+/**
+* moves the level at heap position i down while the head of a child is promoted before its own
+*/
+void heapSiftDown(PriorityQueue_Ptr priorityQueue, int i);
+
+/**
+* adds a level that just became non-empty to the deadline heap
+*/
+void heapInsert(PriorityQueue_Ptr priorityQueue, int level);
+
+/**
+* removes a level that just became empty from the deadline heap
+*/
+void heapRemove(PriorityQueue_Ptr priorityQueue, int level);
+
+/**
+* promotes every head whose deadline is the current clock. Each level only receives the pcbs
+* promoted from the level below it, so the order they are promoted in doesn't matter.
+*/
+void promoteDue(PriorityQueue_Ptr priorityQueue);
+
+/**
+* adds the pcb to the tail of the given level and marks that level as non-empty
+*/
+void pushLevel(PriorityQueue_Ptr priorityQueue, int level, PCB_Ptr pcb);
+
+/**
+* removes the pcb at the head of the given level and clears the mark when the level becomes empty
+*/
+PCB_Ptr popLevel(PriorityQueue_Ptr priorityQueue, int level);
+
+PriorityQueue_Ptr PriorityQueue_constructor(int levels, unsigned int starvationTime) {
    PriorityQueue_Ptr priorityQueue = malloc(sizeof(PriorityQueue));
-   int i;
+   int i, words = (levels + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
    
-   for (i = 0; i < SIZE; i++) {
-      priorityQueue->queueArray[i] = NULL;
+   priorityQueue->queueArray = malloc(sizeof(Queue_Ptr) * levels);
+   priorityQueue->bitmap = calloc(words, sizeof(unsigned long));
+   priorityQueue->deadlineHeap = malloc(sizeof(int) * levels);
+   priorityQueue->heapIndex = malloc(sizeof(int) * levels);
+   priorityQueue->heapSize = 0;
+   priorityQueue->levels = levels;
+   priorityQueue->starvationTime = starvationTime;
+   priorityQueue->size = 0;
+   priorityQueue->clock = 0;
+   priorityQueue->promotionDeadline = UINT64_MAX;
+   
+   for (i = 0; i < levels; i++) {
+      priorityQueue->queueArray[i] = Queue_constructor();
+      priorityQueue->heapIndex[i] = -1;
    }
    
    return priorityQueue;
 }
 
+int nextLevel(PriorityQueue_Ptr priorityQueue, int level) {
+   int word = level / BITMAP_WORD_BITS;
+   int words = (priorityQueue->levels + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+   unsigned long bits;
+   
+   if (level >= priorityQueue->levels) {
+      return priorityQueue->levels;
+   }
+   
+   // ignore levels above the given one in its word
+   bits = priorityQueue->bitmap[word] & (~0UL << (level % BITMAP_WORD_BITS));
+   
+   while (!bits) {
+      if (++word == words) {
+         return priorityQueue->levels;
+      }
+      
+      bits = priorityQueue->bitmap[word];
+   }
+   
+   return word * BITMAP_WORD_BITS + __builtin_ctzl(bits);
+}
+
+uint64_t headDeadline(PriorityQueue_Ptr priorityQueue, int level) {
+   // the head stays for starvationTime calls after the one that made it head, the next call promotes it
+   return Queue_peek(priorityQueue->queueArray[level])->headTime + priorityQueue->starvationTime + 1;
+}
+
+void updateDeadline(PriorityQueue_Ptr priorityQueue) {
+   if (priorityQueue->heapSize == 0) {
+      priorityQueue->promotionDeadline = UINT64_MAX;
+   } else {
+      priorityQueue->promotionDeadline = headDeadline(priorityQueue, priorityQueue->deadlineHeap[0]);
+   }
+}
+
+int heapBefore(PriorityQueue_Ptr priorityQueue, int i, int j) {
+   int one = priorityQueue->deadlineHeap[i], two = priorityQueue->deadlineHeap[j];
+   uint64_t oneTime = Queue_peek(priorityQueue->queueArray[one])->headTime;
+   uint64_t twoTime = Queue_peek(priorityQueue->queueArray[two])->headTime;
+   return oneTime < twoTime || (oneTime == twoTime && one < two);
+}
+
+void heapSwap(PriorityQueue_Ptr priorityQueue, int i, int j) {
+   int level = priorityQueue->deadlineHeap[i];
+   priorityQueue->deadlineHeap[i] = priorityQueue->deadlineHeap[j];
+   priorityQueue->deadlineHeap[j] = level;
+   priorityQueue->heapIndex[priorityQueue->deadlineHeap[i]] = i;
+   priorityQueue->heapIndex[priorityQueue->deadlineHeap[j]] = j;
+}
+
+void heapSiftUp(PriorityQueue_Ptr priorityQueue, int i) {
+   while (i > 0 && heapBefore(priorityQueue, i, (i - 1) / 2)) {
+      heapSwap(priorityQueue, i, (i - 1) / 2);
+      i = (i - 1) / 2;
+   }
+}
+
+void heapSiftDown(PriorityQueue_Ptr priorityQueue, int i) {
+   int child;
+   
+   while ((child = 2 * i + 1) < priorityQueue->heapSize) {
+      if (child + 1 < priorityQueue->heapSize && heapBefore(priorityQueue, child + 1, child)) {
+         child++;
+      }
+      
+      if (!heapBefore(priorityQueue, child, i)) {
+         break;
+      }
+      
+      heapSwap(priorityQueue, i, child);
+      i = child;
+   }
+}
+
+void heapInsert(PriorityQueue_Ptr priorityQueue, int level) {
+   int i = priorityQueue->heapSize++;
+   priorityQueue->deadlineHeap[i] = level;
+   priorityQueue->heapIndex[level] = i;
+   heapSiftUp(priorityQueue, i);
+}
+
+void heapRemove(PriorityQueue_Ptr priorityQueue, int level) {
+   int i = priorityQueue->heapIndex[level];
+   int moved = priorityQueue->deadlineHeap[--priorityQueue->heapSize];
+   priorityQueue->heapIndex[level] = -1;
+   
+   if (moved == level) {
+      return;
+   }
+   
+   // the last level takes the place of the removed one, then moves to wherever it belongs
+   priorityQueue->deadlineHeap[i] = moved;
+   priorityQueue->heapIndex[moved] = i;
+   heapSiftUp(priorityQueue, i);
+   heapSiftDown(priorityQueue, priorityQueue->heapIndex[moved]);
+}
+
+void pushLevel(PriorityQueue_Ptr priorityQueue, int level, PCB_Ptr pcb) {
+   Queue_Ptr queue = priorityQueue->queueArray[level];
+   Queue_enqueue(queue, pcb);
+   priorityQueue->size++;
+   
+   if (Queue_size(queue) == 1) {
+      pcb->headTime = priorityQueue->clock;
+      priorityQueue->bitmap[level / BITMAP_WORD_BITS] |= 1UL << (level % BITMAP_WORD_BITS);
+      
+      if (level > 0) {
+         heapInsert(priorityQueue, level);
+         updateDeadline(priorityQueue);
+      }
+   }
+}
+
+PCB_Ptr popLevel(PriorityQueue_Ptr priorityQueue, int level) {
+   Queue_Ptr queue = priorityQueue->queueArray[level];
+   PCB_Ptr pcb = Queue_dequeue(queue);
+   
+   if (Queue_isEmpty(queue)) {
+      priorityQueue->bitmap[level / BITMAP_WORD_BITS] &= ~(1UL << (level % BITMAP_WORD_BITS));
+   } else {
+      Queue_peek(queue)->headTime = priorityQueue->clock;
+   }
+   
+   priorityQueue->size--;
+   
+   // the new head reached the head now, so its level can only move down the heap
+   if (level > 0) {
+      if (Queue_isEmpty(queue)) {
+         heapRemove(priorityQueue, level);
+      } else {
+         heapSiftDown(priorityQueue, priorityQueue->heapIndex[level]);
+      }
+      
+      updateDeadline(priorityQueue);
+   }
+   
+   return pcb;
+}
+
 void promotePCB(PriorityQueue_Ptr priorityQueue, int origPriority) {
-   Queue_Ptr origQueue = priorityQueue->queueArray[origPriority];
-   PCB_Ptr pcb = Queue_dequeue(origQueue);
+   PCB_Ptr pcb = popLevel(priorityQueue, origPriority);
    
    if (PCB_getPromotedRuns(pcb) == 0) {
       // promoted pcb can run on cpu 6 times with a higher priority level
       PCB_setPromotedRuns(pcb, 6);
    }
    
-   if (Queue_isEmpty(origQueue)) {
-      Queue_destructor(origQueue);
-      priorityQueue->queueArray[origPriority] = NULL;
+   PCB_setCurPriority(pcb, origPriority - 1);
+   pushLevel(priorityQueue, origPriority - 1, pcb);
+}
+
+void promoteDue(PriorityQueue_Ptr priorityQueue) {
+   // a promoted head is replaced by one that just reached the head, which isn't due
+   while (priorityQueue->promotionDeadline <= priorityQueue->clock) {
+      promotePCB(priorityQueue, priorityQueue->deadlineHeap[0]);
    }
+}
+
+void PriorityQueue_preventStarvation(PriorityQueue_Ptr priorityQueue) {
+   PriorityQueue_age(priorityQueue, 1);
+}
+
+unsigned int PriorityQueue_cyclesToPromotion(PriorityQueue_Ptr priorityQueue) {
+   uint64_t calls = priorityQueue->promotionDeadline - priorityQueue->clock - 1;
+   return calls < UINT_MAX ? (unsigned int) calls : UINT_MAX;
+}
 
-   Queue_Ptr curQueue = priorityQueue->queueArray[origPriority - 1];
+void PriorityQueue_age(PriorityQueue_Ptr priorityQueue, unsigned int calls) {
+   uint64_t target = priorityQueue->clock + calls;
    
-   if (curQueue == NULL) {
-      curQueue = Queue_constructor();
-      priorityQueue->queueArray[origPriority - 1] = curQueue;
+   // replay only the calls that promote something, in clock order
+   while (priorityQueue->promotionDeadline <= target) {
+      priorityQueue->clock = priorityQueue->promotionDeadline;
+      promoteDue(priorityQueue);
    }
    
-   PCB_setCurPriority(pcb, origPriority - 1);
-   Queue_enqueue(curQueue, pcb);
+   priorityQueue->clock = target;
 }
 
-void PriorityQueue_preventStarvation(PriorityQueue_Ptr priorityQueue) {
-   Queue_Ptr queue;
-   PCB_Ptr pcb;
+void PriorityQueue_setStarvationTime(PriorityQueue_Ptr priorityQueue, unsigned int starvationTime) {
    int i;
+   priorityQueue->starvationTime = starvationTime;
    
-   for (i = 1; i < SIZE; i++) {
-      queue = priorityQueue->queueArray[i];
-      
-      if (queue != NULL) {
-         pcb = Queue_peek(queue);
-         // promotes a pcb from the head of queue when it reaches the starvation time
-         if (pcb->starvationTime == STARVATION_TIME) {
-            pcb->starvationTime = 0;
-            promotePCB(priorityQueue, i);
-         } else {
-            pcb->starvationTime++;
-         }
+   // heads that already waited longer than the new time are promoted by the next call, their head
+   // times only move forward, so their levels only move down the heap
+   for (i = nextLevel(priorityQueue, 1); i < priorityQueue->levels; i = nextLevel(priorityQueue, i + 1)) {
+      if (headDeadline(priorityQueue, i) <= priorityQueue->clock) {
+         Queue_peek(priorityQueue->queueArray[i])->headTime = priorityQueue->clock - starvationTime;
+         heapSiftDown(priorityQueue, priorityQueue->heapIndex[i]);
       }
    }
+   
+   updateDeadline(priorityQueue);
 }
 
 void PriorityQueue_destructor(PriorityQueue_Ptr priorityQueue) {
    int i;
    
-   for (i = 0; i < SIZE; i++) {
-      if (priorityQueue->queueArray[i] != NULL) {
-         Queue_destructor(priorityQueue->queueArray[i]);
-      }
+   for (i = 0; i < priorityQueue->levels; i++) {
+      Queue_destructor(priorityQueue->queueArray[i]);
    }
    
+   free(priorityQueue->queueArray);
+   free(priorityQueue->bitmap);
+   free(priorityQueue->deadlineHeap);
+   free(priorityQueue->heapIndex);
    free(priorityQueue);
 }
 
 int PriorityQueue_isEmpty(PriorityQueue_Ptr priorityQueue) {
-   int i, result = 1;
-   
-   for (i = 0; i < SIZE; i++) {
-      if (priorityQueue->queueArray[i] != NULL) {
-         result = 0;
-      }
-   }
-   
-   return result;
+   return !priorityQueue->size;
 }
 
 int PriorityQueue_size(PriorityQueue_Ptr priorityQueue) {
-   int i, size = 0;
-   Queue_Ptr queue;
-   
-   for(i = 0; i < SIZE; i++) {
-      queue = priorityQueue->queueArray[i];
-      
-      if (queue != NULL) {
-         size += Queue_size(queue);
-      }
-   }
-   
-   return size;
+   return priorityQueue->size;
 }
 
 void PriorityQueue_enqueue(PriorityQueue_Ptr priorityQueue, PCB_Ptr pcb) {
    int priority, numOfRuns = PCB_getPromotedRuns(pcb);
    
    if (numOfRuns > 0) {
-      priority = PCB_getCurPriority(pcb);
+      priority = pcb->boostedFrom < 0 ? PCB_getCurPriority(pcb) : pcb->boostedFrom;
       PCB_setPromotedRuns(pcb, numOfRuns - 1);
    } else {
       // demote the pcb back to its original priority level
       // when number of promoted runs becomes 0
       priority = PCB_getOrigPriority(pcb);
-      PCB_setCurPriority(pcb, priority);
    }
    
-   Queue_Ptr targetQueue = priorityQueue->queueArray[priority];
+   // a pcb that inherited a higher priority keeps it until it releases its mutexes,
+   // and then goes back to the level it would have had
+   if (pcb->boostedFrom >= 0) {
+      pcb->boostedFrom = priority;
+      
+      if (PCB_getCurPriority(pcb) < priority) {
+         priority = PCB_getCurPriority(pcb);
+      }
+   }
+   
+   PCB_setCurPriority(pcb, priority);
+   pushLevel(priorityQueue, priority, pcb);
+}
+
+void PriorityQueue_reprioritize(PriorityQueue_Ptr priorityQueue, PCB_Ptr pcb, int priority) {
+   int level = PCB_getCurPriority(pcb);
+   Queue_Ptr queue = priorityQueue->queueArray[level];
    
-   if (targetQueue == NULL) {
-      targetQueue = Queue_constructor();
-      priorityQueue->queueArray[priority] = targetQueue;
+   if (Queue_peek(queue) == pcb) {
+      popLevel(priorityQueue, level);
+   } else {
+      Queue_remove(queue, pcb);
+      priorityQueue->size--;
    }
    
-   Queue_enqueue(targetQueue, pcb);
+   PCB_setCurPriority(pcb, priority);
+   pushLevel(priorityQueue, priority, pcb);
 }
 
 PCB_Ptr PriorityQueue_dequeue(PriorityQueue_Ptr priorityQueue) {
-   int i;
-   Queue_Ptr q;
+   int level = nextLevel(priorityQueue, 0);
    
-   for (i = 0; i < SIZE; i++) {
-      q = priorityQueue->queueArray[i];
-      
-      if (q != NULL && !Queue_isEmpty(q)) {
-         PCB_Ptr pcb = Queue_dequeue(q);
-         
-         if (Queue_isEmpty(q)) {
-            Queue_destructor(q);
-            priorityQueue->queueArray[i] = NULL;
-         }
-         
-         pcb->starvationTime = 0;
-         return pcb;
-      }
+   if (level == priorityQueue->levels) {
+      return NULL;
    }
    
-   return NULL;
+   return popLevel(priorityQueue, level);
 }
 
 char *PriorityQueue_toString(PriorityQueue_Ptr priorityQueue) {
    int i, size;
-   Queue_Ptr q;
    char *dest = calloc(QUEUE_DEST_LEN, sizeof(char));
-   char *src = calloc(QUEUE_SRC_LEN, sizeof(char));
+   char src[QUEUE_SRC_LEN];
    char *temp;
    
-   for (i = 0; i < SIZE; i++) {
-      q = priorityQueue->queueArray[i];
+   for (i = nextLevel(priorityQueue, 0); i < priorityQueue->levels; i = nextLevel(priorityQueue, i + 1)) {
+      size = snprintf(src, sizeof(src), "Q%d: ", i);
+      temp = Queue_toString(priorityQueue->queueArray[i]);
       
-      if (q != NULL) {
-         size = sprintf(src, "Q%d: ", i);
-         strncat(dest, src, size);
-         temp = Queue_toString(q);
-         strncat(dest, temp, strlen(temp));
-         strcat(dest, "\n");
+      // stop before overflowing dest
+      if (strlen(dest) + size + strlen(temp) + 1 >= QUEUE_DEST_LEN) {
+         free(temp);
+         break;
       }
+      
+      strncat(dest, src, size);
+      strcat(dest, temp);
+      strcat(dest, "\n");
+      free(temp);
    }
    
    return dest;
-}
\ No newline at end of file
+}
+
+void PriorityQueue_save(PriorityQueue_Ptr priorityQueue, Snapshot_Ptr snapshot) {
+   int i;
+   Snapshot_write(snapshot, &priorityQueue->levels, sizeof(priorityQueue->levels));
+   Snapshot_write(snapshot, &priorityQueue->clock, sizeof(priorityQueue->clock));
+   Snapshot_write(snapshot, &priorityQueue->promotionDeadline, sizeof(priorityQueue->promotionDeadline));
+   
+   for (i = 0; i < priorityQueue->levels; i++) {
+      Queue_save(priorityQueue->queueArray[i], snapshot);
+   }
+}
+
+void PriorityQueue_restore(PriorityQueue_Ptr priorityQueue, Snapshot_Ptr snapshot) {
+   int i, levels;
+   Snapshot_read(snapshot, &levels, sizeof(levels));
+   Snapshot_read(snapshot, &priorityQueue->clock, sizeof(priorityQueue->clock));
+   Snapshot_read(snapshot, &priorityQueue->promotionDeadline, sizeof(priorityQueue->promotionDeadline));
+   
+   if (levels != priorityQueue->levels) {
+      Snapshot_fail(snapshot);
+      return;
+   }
+   
+   // the head times are in the pcbs, so the levels are filled without pushLevel()
+   for (i = 0; i < priorityQueue->levels; i++) {
+      Queue_restore(priorityQueue->queueArray[i], snapshot);
+      priorityQueue->size += Queue_size(priorityQueue->queueArray[i]);
+      
+      if (!Queue_isEmpty(priorityQueue->queueArray[i])) {
+         priorityQueue->bitmap[i / BITMAP_WORD_BITS] |= 1UL << (i % BITMAP_WORD_BITS);
+         
+         if (i > 0) {
+            heapInsert(priorityQueue, i);
+         }
+      }
+   }
+}
@@ -20,20 +20,35 @@
 #include "queue.h"
 
 #define QUEUE_DEST_LEN 1500
-#define QUEUE_SRC_LEN 6
-#define SIZE 4 // number of queues in this priority queue
-#define STARVATION_TIME 1200 // a pcb will stay at head of a queue no longer than 1200 preventStarvation() calls
+#define QUEUE_SRC_LEN 12
+#define PRIORITY_LEVELS 4 // default number of queues in a priority queue
+#define MAX_PRIORITY_LEVELS 256 // max number of priority levels of a simulation, the priority of a workload record fits in a byte
+#define STARVATION_TIME 1200 // by default a pcb stays at head of a queue no longer than 1200 preventStarvation() calls
+#define BITMAP_WORD_BITS (8 * sizeof(unsigned long)) // number of levels tracked by one bitmap word
 
 typedef struct {
-   Queue_Ptr queueArray[SIZE];
+   Queue_Ptr *queueArray; // one queue per priority level, kept even when it is empty
+   unsigned long *bitmap; // bit i is set when the queue for priority level i is not empty
+   // min-heap of the non-empty levels below priority 0, ordered by the head times of their heads,
+   // so the head promoted first is found without visiting every level
+   int *deadlineHeap;
+   int *heapIndex; // position of each level in deadlineHeap, -1 when it isn't there
+   int heapSize;
+   int levels; // number of priority levels, 0 is the highest priority
+   unsigned int starvationTime; // max number of preventStarvation() calls a pcb stays at head of a level
+   int size; // number of pcbs in all levels
+   // 64 bits, so clock + starvationTime can't wrap around for any starvation time
+   uint64_t clock; // number of preventStarvation() calls made so far
+   uint64_t promotionDeadline; // clock of the next call that promotes a pcb, UINT64_MAX when none will
 } PriorityQueue;
 
 typedef PriorityQueue *PriorityQueue_Ptr;
 
 /**
-* creates a priority queue and returns pointer of the queue
+* creates a priority queue with the given number of priority levels, whose heads are promoted
+* after starvationTime preventStarvation() calls, and returns pointer of the queue
 */
-PriorityQueue_Ptr PriorityQueue_constructor(void);
+PriorityQueue_Ptr PriorityQueue_constructor(int levels, unsigned int starvationTime);
 
 /**
 * destructs the passed in priority queue
@@ -45,6 +60,12 @@ void PriorityQueue_destructor(PriorityQueue_Ptr priorityQueue);
 */
 void PriorityQueue_enqueue(PriorityQueue_Ptr priorityQueue, PCB_Ptr pcb);
 
+/**
+* moves a pcb of this priority queue to the end of the level of the given priority,
+* which becomes its current priority
+*/
+void PriorityQueue_reprioritize(PriorityQueue_Ptr priorityQueue, PCB_Ptr pcb, int priority);
+
 /**
 * gets one pcb from this priority queue
 */
@@ -66,8 +87,36 @@ int PriorityQueue_size(PriorityQueue_Ptr priorityQueue);
 char *PriorityQueue_toString(PriorityQueue_Ptr priorityQueue);
 
 /**
-* used to prevent pcbs in this priority from starvation
+* used to prevent pcbs in this priority from starvation. Every head remembers the clock at which
+* it reached the head, so a call only advances the clock unless the promotion deadline is reached.
 */
 void PriorityQueue_preventStarvation(PriorityQueue_Ptr priorityQueue);
 
+/**
+* returns number of preventStarvation() calls that can be made before one of them
+* promotes a pcb, UINT_MAX when that is more or when no pcb is waiting below priority 0
+*/
+unsigned int PriorityQueue_cyclesToPromotion(PriorityQueue_Ptr priorityQueue);
+
+/**
+* has the same effect as calling preventStarvation() the given number of times
+*/
+void PriorityQueue_age(PriorityQueue_Ptr priorityQueue, unsigned int calls);
+
+/**
+* changes the number of preventStarvation() calls a pcb stays at head of a level,
+* heads that waited longer already are promoted by the next call
+*/
+void PriorityQueue_setStarvationTime(PriorityQueue_Ptr priorityQueue, unsigned int starvationTime);
+
+/**
+* writes the clock, the promotion deadline and the pcbs of every level to the snapshot
+*/
+void PriorityQueue_save(PriorityQueue_Ptr priorityQueue, Snapshot_Ptr snapshot);
+
+/**
+* reads what PriorityQueue_save() wrote into this empty priority queue, which has the same number of levels
+*/
+void PriorityQueue_restore(PriorityQueue_Ptr priorityQueue, Snapshot_Ptr snapshot);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,287 @@
+/**
+* priority_queue_test.c
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This file checks that the priority queue promotes starving pcbs exactly when their
+* starvation time is over, also when the clock and the starvation time add up past UINT_MAX,
+* and that it keeps its bitmap and deadline heap right with more levels than a bitmap word
+* holds and with several levels waiting for promotion at once.
+* It prints every check that failed and exits with 1 when any did.
+*/
+
+#include <stdio.h>
+#include <limits.h>
+#include "pcb.h"
+#include "priority_queue.h"
+
+#define MANY_LEVELS 140 // number of levels of the queues whose bitmap spans several words
+#define HEAP_STARVATION 50 // starvation time of the queue whose heads are promoted over and over
+
+/**
+* This prints the check when it failed and returns 1 when it failed, 0 otherwise
+*/
+int check(int passed, const char *description);
+
+/**
+* This returns a pcb of the given priority that was never promoted
+*/
+PCB_Ptr makePCB(int priority);
+
+/**
+* This ages an empty queue by skip calls, enqueues a pcb at level 2 and checks that it stays
+* there for starvationTime calls and is promoted by the next one. Returns number of failed checks.
+*/
+int checkPromotion(unsigned int starvationTime, unsigned int skip);
+
+/**
+* This returns 1 when the bitmap marks exactly the non-empty levels, the deadline heap holds
+* exactly the non-empty levels below 0, the heapIndex of each level is its position in the heap
+* or -1, no head is promoted before the head of its parent and the promotion deadline is that
+* of the head at the top of the heap, 0 otherwise
+*/
+int isConsistent(PriorityQueue_Ptr priorityQueue);
+
+/**
+* This fills levels in several bitmap words and checks that they are dequeued in order and that
+* a head is promoted across a word boundary. Returns number of failed checks.
+*/
+int checkManyLevels(void);
+
+/**
+* This puts pcbs at several levels, some reaching the head at the same call, ages the queue one
+* call at a time while they are promoted level by level and checks the bookkeeping after every
+* call. Returns number of failed checks.
+*/
+int checkDeadlineHeap(void);
+
+int check(int passed, const char *description) {
+   if (!passed) {
+      printf("FAILED: %s\n", description);
+   }
+
+   return !passed;
+}
+
+PCB_Ptr makePCB(int priority) {
+   PCB_Ptr pcb = PCB_constructor(Compute);
+   PCB_setOrigPriority(pcb, priority);
+   PCB_setCurPriority(pcb, priority);
+   PCB_setPromotedRuns(pcb, 0);
+   return pcb;
+}
+
+int checkPromotion(unsigned int starvationTime, unsigned int skip) {
+   PriorityQueue_Ptr priorityQueue = PriorityQueue_constructor(PRIORITY_LEVELS, starvationTime);
+   PCB_Ptr pcb = makePCB(2);
+   int failed = 0;
+
+   PriorityQueue_age(priorityQueue, skip);
+   PriorityQueue_enqueue(priorityQueue, pcb);
+   failed += check(PriorityQueue_cyclesToPromotion(priorityQueue) == starvationTime,
+      "cyclesToPromotion() is the starvation time right after the pcb reached the head");
+
+   // the head stays for starvationTime calls, replayed in two steps and one by one at the end
+   PriorityQueue_age(priorityQueue, starvationTime / 2);
+   PriorityQueue_age(priorityQueue, starvationTime - starvationTime / 2 - 1);
+   PriorityQueue_preventStarvation(priorityQueue);
+   failed += check(PCB_getCurPriority(pcb) == 2, "the pcb isn't promoted before its starvation time is over");
+   failed += check(PriorityQueue_cyclesToPromotion(priorityQueue) == 0, "cyclesToPromotion() is 0 right before the promotion");
+
+   PriorityQueue_preventStarvation(priorityQueue);
+   failed += check(PCB_getCurPriority(pcb) == 1, "the pcb is promoted by the call after its starvation time");
+   failed += check(PriorityQueue_dequeue(priorityQueue) == pcb, "the promoted pcb is dequeued");
+   failed += check(PriorityQueue_cyclesToPromotion(priorityQueue) == UINT_MAX, "an empty queue never promotes");
+
+   PCB_destructor(pcb);
+   PriorityQueue_destructor(priorityQueue);
+   return failed;
+}
+
+int isConsistent(PriorityQueue_Ptr priorityQueue) {
+   int i, level, parent, empty, marked, heapLevels = 0;
+   uint64_t time, parentTime;
+
+   for (level = 0; level < priorityQueue->levels; level++) {
+      empty = Queue_isEmpty(priorityQueue->queueArray[level]);
+      marked = (priorityQueue->bitmap[level / BITMAP_WORD_BITS] >> (level % BITMAP_WORD_BITS)) & 1;
+      i = priorityQueue->heapIndex[level];
+
+      if (marked == empty) {
+         return 0;
+      }
+
+      if (level == 0 || empty) {
+         if (i != -1) {
+            return 0;
+         }
+      } else if (i < 0 || i >= priorityQueue->heapSize || priorityQueue->deadlineHeap[i] != level) {
+         return 0;
+      } else {
+         heapLevels++;
+      }
+   }
+
+   if (heapLevels != priorityQueue->heapSize) {
+      return 0;
+   }
+
+   for (i = 1; i < priorityQueue->heapSize; i++) {
+      level = priorityQueue->deadlineHeap[i];
+      parent = priorityQueue->deadlineHeap[(i - 1) / 2];
+      time = Queue_peek(priorityQueue->queueArray[level])->headTime;
+      parentTime = Queue_peek(priorityQueue->queueArray[parent])->headTime;
+
+      if (time < parentTime || (time == parentTime && level < parent)) {
+         return 0;
+      }
+   }
+
+   if (priorityQueue->heapSize == 0) {
+      return priorityQueue->promotionDeadline == UINT64_MAX;
+   }
+
+   return priorityQueue->promotionDeadline
+      == Queue_peek(priorityQueue->queueArray[priorityQueue->deadlineHeap[0]])->headTime + priorityQueue->starvationTime + 1;
+}
+
+int checkManyLevels(void) {
+   PriorityQueue_Ptr priorityQueue = PriorityQueue_constructor(MANY_LEVELS, STARVATION_TIME);
+   const int levels[] = {139, 64, 0, 127, 63, 128, 65, 1};
+   const int sorted[] = {0, 1, 63, 64, 65, 127, 128, 139};
+   const int count = sizeof(levels) / sizeof(levels[0]);
+   PCB_Ptr pcbs[sizeof(levels) / sizeof(levels[0])];
+   PCB_Ptr pcb;
+   int i, inOrder = 1, consistent;
+   int failed = 0;
+
+   for (i = 0; i < count; i++) {
+      pcbs[i] = makePCB(levels[i]);
+      PriorityQueue_enqueue(priorityQueue, pcbs[i]);
+   }
+
+   consistent = isConsistent(priorityQueue);
+
+   for (i = 0; i < count; i++) {
+      pcb = PriorityQueue_dequeue(priorityQueue);
+      inOrder = inOrder && pcb != NULL && PCB_getCurPriority(pcb) == sorted[i];
+      consistent = consistent && isConsistent(priorityQueue);
+   }
+
+   failed += check(inOrder, "levels in different bitmap words are dequeued from the highest priority down");
+   failed += check(consistent, "the bitmap and the deadline heap are right while levels of several words empty");
+   failed += check(PriorityQueue_dequeue(priorityQueue) == NULL, "a queue whose levels all emptied returns no pcb");
+
+   // level 64 is the first of the second word, its head is promoted into the last level of the first one
+   PriorityQueue_enqueue(priorityQueue, pcbs[1]);
+   PriorityQueue_age(priorityQueue, STARVATION_TIME);
+   failed += check(PCB_getCurPriority(pcbs[1]) == 64, "the head of level 64 isn't promoted before its starvation time is over");
+   PriorityQueue_preventStarvation(priorityQueue);
+   failed += check(PCB_getCurPriority(pcbs[1]) == 63, "the head of level 64 is promoted to level 63");
+   failed += check(isConsistent(priorityQueue), "the bitmap and the deadline heap are right after a promotion across words");
+   failed += check(PriorityQueue_dequeue(priorityQueue) == pcbs[1], "the pcb promoted across words is dequeued");
+
+   for (i = 0; i < count; i++) {
+      PCB_destructor(pcbs[i]);
+   }
+
+   PriorityQueue_destructor(priorityQueue);
+   return failed;
+}
+
+int checkDeadlineHeap(void) {
+   PriorityQueue_Ptr priorityQueue = PriorityQueue_constructor(MANY_LEVELS, HEAP_STARVATION);
+   // pcbs 0 and 1 arrive at clock 0, 2 and 3 at clock 10, the rest at clock 20
+   const int levels[] = {100, 100, 3, 64, 65, 2, 130};
+   const int count = sizeof(levels) / sizeof(levels[0]);
+   PCB_Ptr pcbs[sizeof(levels) / sizeof(levels[0])];
+   PCB_Ptr pcb;
+   int i, consistent = 1, inOrder = 1, dequeued = 0, last = 0;
+   int failed = 0;
+
+   for (i = 0; i < count; i++) {
+      if (i == 2 || i == 4) {
+         PriorityQueue_age(priorityQueue, 10);
+      }
+
+      pcbs[i] = makePCB(levels[i]);
+      PriorityQueue_enqueue(priorityQueue, pcbs[i]);
+      consistent = consistent && isConsistent(priorityQueue);
+   }
+
+   failed += check(consistent, "the deadline heap is right while levels join it");
+
+   // the clock is 20, the head of level 100 is promoted by call HEAP_STARVATION + 1
+   PriorityQueue_age(priorityQueue, HEAP_STARVATION - 20);
+   failed += check(PCB_getCurPriority(pcbs[0]) == 100, "the first head isn't promoted before its starvation time is over");
+   PriorityQueue_preventStarvation(priorityQueue);
+   failed += check(PCB_getCurPriority(pcbs[0]) == 99 && PCB_getCurPriority(pcbs[1]) == 100,
+      "only the head of level 100 is promoted by the call after its starvation time");
+   failed += check(isConsistent(priorityQueue), "the deadline heap is right after the first promotion");
+
+   // the heads of levels 3 and 64 are due at the same call, and those of 2, 65 and 130 ten calls later
+   PriorityQueue_age(priorityQueue, 10);
+   failed += check(PCB_getCurPriority(pcbs[2]) == 2 && PCB_getCurPriority(pcbs[3]) == 63,
+      "two heads due at the same call are promoted by it");
+   failed += check(isConsistent(priorityQueue), "the deadline heap is right after two promotions at one call");
+   PriorityQueue_age(priorityQueue, 10);
+   failed += check(PCB_getCurPriority(pcbs[5]) == 1 && PCB_getCurPriority(pcbs[4]) == 64 && PCB_getCurPriority(pcbs[6]) == 129,
+      "three heads due at the same call are promoted by it");
+   failed += check(isConsistent(priorityQueue), "the deadline heap is right after three promotions at one call");
+
+   // moving a head out of its level and taking pcbs out empties levels in the middle of the heap
+   PriorityQueue_reprioritize(priorityQueue, pcbs[1], 5);
+   consistent = isConsistent(priorityQueue);
+
+   for (i = 0; i < 4 * HEAP_STARVATION; i++) {
+      PriorityQueue_preventStarvation(priorityQueue);
+      consistent = consistent && isConsistent(priorityQueue);
+
+      if (i == 2 * HEAP_STARVATION) {
+         pcb = PriorityQueue_dequeue(priorityQueue);
+         consistent = consistent && pcb != NULL && isConsistent(priorityQueue);
+         dequeued++;
+      }
+   }
+
+   failed += check(consistent, "the deadline heap and the heapIndex of every level are right after every promotion");
+
+   while ((pcb = PriorityQueue_dequeue(priorityQueue)) != NULL) {
+      inOrder = inOrder && PCB_getCurPriority(pcb) >= last;
+      last = PCB_getCurPriority(pcb);
+      consistent = consistent && isConsistent(priorityQueue);
+      dequeued++;
+   }
+
+   failed += check(inOrder && dequeued == count, "every pcb is dequeued once, from the highest priority down");
+   failed += check(consistent, "the deadline heap is right while the promoted levels empty");
+
+   for (i = 0; i < count; i++) {
+      PCB_destructor(pcbs[i]);
+   }
+
+   PriorityQueue_destructor(priorityQueue);
+   return failed;
+}
+
+int main(void) {
+   int failed = 0;
+
+   failed += checkPromotion(STARVATION_TIME, 0);
+   failed += checkPromotion(STARVATION_TIME, UINT_MAX);
+   failed += checkPromotion(UINT_MAX - 1, 0);
+   failed += checkPromotion(UINT_MAX - 1, UINT_MAX - 5);
+   failed += checkPromotion(3000000000U, 2000000000U);
+   failed += checkManyLevels();
+   failed += checkDeadlineHeap();
+
+   printf("%s\n", failed ? "priority queue checks failed" : "priority queue checks passed");
+   return failed > 0;
+}
@@ -4,64 +4,81 @@
 #include "queue.h"
 #include "pcb.h"
 
-typedef struct node {
-  struct node *next;
-  PCB_Ptr thisPCB;
-} Node;
-
-Node *nodeConstructor(PCB_Ptr pcb);
-
-Node *nodeConstructor(PCB_Ptr pcb) {
-  Node *n = malloc(sizeof(Node));
-  n->next = NULL;
-  n->thisPCB = pcb;
-  return n;
+/**
+* Doubles the capacity of the buffer, the pcbs are copied to the front of
+* the new buffer in queue order.
+*/
+void grow(Queue_Ptr queue);
+
+void grow(Queue_Ptr queue) {
+  unsigned int capacity = queue->capacity * 2;
+  PCB_Ptr *buffer = malloc(sizeof(PCB_Ptr) * capacity);
+  unsigned int first = queue->capacity - queue->head; // number of slots before the buffer wraps
+
+  memcpy(buffer, queue->buffer + queue->head, sizeof(PCB_Ptr) * first);
+  memcpy(buffer + first, queue->buffer, sizeof(PCB_Ptr) * queue->head);
+  free(queue->buffer);
+  queue->buffer = buffer;
+  queue->capacity = capacity;
+  queue->head = 0;
 }
 
 Queue_Ptr Queue_constructor(void) {
   Queue *q = malloc(sizeof(Queue));
-  q->head = NULL;
-  q->tail = NULL;
+  q->buffer = malloc(sizeof(PCB_Ptr) * QUEUE_INIT_CAPACITY);
+  q->capacity = QUEUE_INIT_CAPACITY;
+  q->head = 0;
   q->size = 0;
   return q;
 }
 
 void Queue_enqueue(Queue_Ptr queue, PCB_Ptr pcb) {
-  Node *n = nodeConstructor(pcb);
-
-  if (!queue->size) {
-    queue->head = n;
-    queue->tail = n;
-    
-  } else {
-    queue->tail->next = n;
-    queue->tail = n;
+  if (queue->size == queue->capacity) {
+    grow(queue);
   }
-  
+
+  queue->buffer[(queue->head + queue->size) & (queue->capacity - 1)] = pcb;
   queue->size++;
 }
 
 PCB_Ptr Queue_dequeue(Queue_Ptr queue) {
   if (!queue->size) return NULL;
 
-  Node *n = queue->head;
-
-  if (queue->size == 1) {
-    queue->head = NULL;
-    queue->tail = NULL;
-  } else {
-    queue->head = n->next;
-  }
-  
-  PCB_Ptr pcb = n->thisPCB;
-  free(n);
+  PCB_Ptr pcb = queue->buffer[queue->head];
+  queue->head = (queue->head + 1) & (queue->capacity - 1);
   queue->size--;
 
   return pcb;
 }
 
+PCB_Ptr Queue_at(Queue_Ptr queue, int index) {
+  return queue->buffer[(queue->head + index) & (queue->capacity - 1)];
+}
+
+int Queue_remove(Queue_Ptr queue, PCB_Ptr pcb) {
+  unsigned int mask = queue->capacity - 1;
+  unsigned int i;
+
+  for (i = 0; i < queue->size; i++) {
+    if (queue->buffer[(queue->head + i) & mask] == pcb) {
+      break;
+    }
+  }
+
+  if (i == queue->size) return 0;
+
+  for (; i + 1 < queue->size; i++) {
+    queue->buffer[(queue->head + i) & mask] = queue->buffer[(queue->head + i + 1) & mask];
+  }
+
+  queue->size--;
+  return 1;
+}
+
 PCB_Ptr Queue_peek(Queue_Ptr queue) {
-   return queue->head->thisPCB;
+   if (!queue->size) return NULL;
+   
+   return queue->buffer[queue->head];
 }
 
 int Queue_size(Queue_Ptr queue) {
@@ -73,31 +90,58 @@ int Queue_isEmpty(Queue_Ptr queue) {
 }
 
 void Queue_destructor(Queue_Ptr queue) {
-  while (Queue_dequeue(queue) != NULL);
+  free(queue->buffer);
   free(queue);
 }
 
 char *Queue_toString(const Queue_Ptr queue) {
-	Node *current = queue->head;
+   unsigned int i, mask = queue->capacity - 1;
    int size;
    char *dest = calloc(DEST_LEN, sizeof(char));
-   char *src = calloc(SRC_LEN, sizeof(char));
+   char src[SRC_LEN];
    
-   if (current == NULL) {
+   if (!queue->size) {
       return "";
    }
    
-	while(current != NULL){
-      if (current->next == NULL) {
-         size = sprintf(src, "P%d-*", PCB_getProcessID(current->thisPCB));
-         strncat(dest, src, size);
+   for (i = 0; i < queue->size; i++) {
+      PCB_Ptr pcb = queue->buffer[(queue->head + i) & mask];
+      
+      if (i == queue->size - 1) {
+         size = snprintf(src, SRC_LEN, "P%d-*", PCB_getProcessID(pcb));
       } else {
-         size = sprintf(src, "P%d->", PCB_getProcessID(current->thisPCB));
-         strncat(dest, src, size);
+         size = snprintf(src, SRC_LEN, "P%d->", PCB_getProcessID(pcb));
       }
       
-		current = current->next;
-	}
+      // stop before overflowing dest, a full queue can be longer than DEST_LEN
+      if (strlen(dest) + size >= DEST_LEN) break;
+      strncat(dest, src, size);
+   }
    
    return dest;
-}
\ No newline at end of file
+}
+
+void Queue_save(Queue_Ptr queue, Snapshot_Ptr snapshot) {
+   unsigned int i;
+   Snapshot_write(snapshot, &queue->size, sizeof(queue->size));
+
+   for (i = 0; i < queue->size; i++) {
+      Snapshot_writePCB(snapshot, Queue_at(queue, i));
+   }
+}
+
+void Queue_restore(Queue_Ptr queue, Snapshot_Ptr snapshot) {
+   unsigned int size, i;
+   PCB_Ptr pcb;
+   Snapshot_read(snapshot, &size, sizeof(size));
+
+   for (i = 0; i < size && !snapshot->failed; i++) {
+      pcb = Snapshot_readPCB(snapshot);
+
+      if (pcb == NULL) {
+         Snapshot_fail(snapshot);
+      } else {
+         Queue_enqueue(queue, pcb);
+      }
+   }
+}
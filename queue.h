@@ -18,16 +18,20 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 #include "pcb.h"
+#include "snapshot.h"
 // Both constants are used in Queue_toString() for length of a string
 #define DEST_LEN 600
 #define SRC_LEN 8
+#define QUEUE_INIT_CAPACITY 8 // initial number of slots, always a power of 2
 
 /*
-* Node definition for the linked list implementation. Contains a pointer to a PCB object
+* Queue definition for the ring buffer implementation. Slots hold pointers to PCB objects,
+* the buffer doubles its capacity when it is full and never shrinks.
 */
 typedef struct {
-  struct node *head;
-  struct node *tail;
+  PCB_Ptr *buffer;
+  unsigned int capacity; // number of slots in the buffer, a power of 2
+  unsigned int head; // index of the slot holding the head of the queue
   unsigned int size;
 } Queue;
 
@@ -39,28 +43,36 @@ typedef Queue *Queue_Ptr;
 Queue_Ptr Queue_constructor(void);
 
 /*
-* Creates a new node and makes that node point to the pcb that is passed in.
-* Then that node is appended to the tail of the queue. Queue size is incrimented by 1.
+* Stores the pcb that is passed in at the slot after the tail of the queue. If all slots
+* are used, the buffer grows first. Queue size is incrimented by 1.
 */
 void Queue_enqueue(Queue_Ptr queue, PCB_Ptr pcb);
 
 /*
 * If queue is empty, this function will return NULL.
-* A node pointer is created and pointed at the head of the queue. 
-* If there was only one node in the queue, the head and tail will
-* be set to null. Otherwise, the next node is set to be the head of the queue.
-* Then a pcb pointer is created to poiint at the pcb that the dequeued node was
-* pointing at. The node is freed from memory, and the pointer to the pcb is returned.
+* Otherwise, the pcb at the head slot is returned and the head moves to the next slot.
+* No memory is freed here, the slot is reused by later enqueues.
 */
 PCB_Ptr Queue_dequeue(Queue_Ptr queue);
 
 /*
-* Returns true if the Queue has no nodes in it, false otherwise.
+* Returns the pcb at the given position of the queue, 0 is the head.
+*/
+PCB_Ptr Queue_at(Queue_Ptr queue, int index);
+
+/*
+* Removes the pcb from anywhere in the queue, the pcbs behind it move up one slot.
+* Returns 1 if the pcb was in the queue, 0 otherwise.
+*/
+int Queue_remove(Queue_Ptr queue, PCB_Ptr pcb);
+
+/*
+* Returns true if the Queue has no pcbs in it, false otherwise.
 */
 int Queue_isEmpty(Queue_Ptr queue);
 
 /*
-* Returns the PCB pointed to by the head node in the queue.
+* Returns the PCB at the head of the queue, or NULL when the queue is empty.
 */
 PCB_Ptr Queue_peek(Queue_Ptr queue);
 
@@ -70,13 +82,23 @@ PCB_Ptr Queue_peek(Queue_Ptr queue);
 int Queue_size(Queue_Ptr queue);
 
 /*
-* Loops through each node, and frees the data from memory, destroying the Queue.
+* Frees the buffer and the queue, destroying the Queue. PCBs in it are not freed.
 */
 void Queue_destructor(Queue_Ptr queue);
 
 /*
-* Prints out the processID of the pcb at each node in the queue.
+* Prints out the processID of the pcb at each slot in the queue.
 */
 char *Queue_toString(const Queue_Ptr queue);
 
+/*
+* Writes the pcbs of the queue in order to the snapshot.
+*/
+void Queue_save(Queue_Ptr queue, Snapshot_Ptr snapshot);
+
+/*
+* Appends the pcbs written by Queue_save() to the queue.
+*/
+void Queue_restore(Queue_Ptr queue, Snapshot_Ptr snapshot);
+
 #endif
@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "rng.h"
+
+/**
+* returns x rotated left by k bits
+*/
+uint64_t rotl(uint64_t x, int k);
+
+/**
+* advances the generator by 2^128 numbers, used to get to the next stream
+*/
+void jump(Rng_Ptr rng);
+
+uint64_t rotl(uint64_t x, int k) {
+   return (x << k) | (x >> (64 - k));
+}
+
+Rng_Ptr Rng_constructor(uint64_t seed, int stream) {
+   Rng_Ptr rng = malloc(sizeof(Rng));
+   Rng_seed(rng, seed, stream);
+   return rng;
+}
+
+void Rng_destructor(Rng_Ptr rng) {
+   free(rng);
+}
+
+void Rng_seed(Rng_Ptr rng, uint64_t seed, int stream) {
+   int i;
+   
+   // splitmix64 spreads the seed over the whole state, which must not be all zeros
+   for (i = 0; i < 4; i++) {
+      uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      rng->state[i] = z ^ (z >> 31);
+   }
+   
+   for (i = 0; i < stream; i++) {
+      jump(rng);
+   }
+}
+
+uint64_t Rng_next(Rng_Ptr rng) {
+   uint64_t *s = rng->state;
+   uint64_t result = rotl(s[1] * 5, 7) * 9;
+   uint64_t t = s[1] << 17;
+   
+   s[2] ^= s[0];
+   s[3] ^= s[1];
+   s[1] ^= s[2];
+   s[0] ^= s[3];
+   s[2] ^= t;
+   s[3] = rotl(s[3], 45);
+   
+   return result;
+}
+
+int Rng_range(Rng_Ptr rng, int bound) {
+   // multiply the high 32 bits by bound instead of using %, which favours small numbers
+   return (int) (((Rng_next(rng) >> 32) * (uint64_t) bound) >> 32);
+}
+
+void jump(Rng_Ptr rng) {
+   static const uint64_t JUMP[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+   uint64_t s[4] = {0, 0, 0, 0};
+   int i, b, j;
+   
+   for (i = 0; i < 4; i++) {
+      for (b = 0; b < 64; b++) {
+         if (JUMP[i] & (1ULL << b)) {
+            for (j = 0; j < 4; j++) {
+               s[j] ^= rng->state[j];
+            }
+         }
+         
+         Rng_next(rng);
+      }
+   }
+   
+   for (j = 0; j < 4; j++) {
+      rng->state[j] = s[j];
+   }
+}
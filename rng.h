@@ -0,0 +1,58 @@
+/**
+* rng.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for the random number generator
+* implementation. It is a xoshiro256** generator, a stream is the sequence that starts
+* 2^128 numbers after the previous stream of the same seed, so streams never overlap.
+*
+*/
+
+#ifndef RNG_H
+#define RNG_H
+#include <stdint.h>
+
+// This defines the streams used by a simulation, one for each thing that needs random numbers
+typedef enum {Workload_stream, Trap_stream, IO_stream, Block_stream, RNG_STREAMS} Rng_Stream;
+
+// This defines a random number generator type
+typedef struct {
+   uint64_t state[4];
+} Rng;
+
+typedef Rng *Rng_Ptr;
+
+/**
+* creates a generator for the given stream of the given seed
+*/
+Rng_Ptr Rng_constructor(uint64_t seed, int stream);
+
+/**
+* frees memory used by the generator
+*/
+void Rng_destructor(Rng_Ptr rng);
+
+/**
+* sets the generator to the start of the given stream of the given seed
+*/
+void Rng_seed(Rng_Ptr rng, uint64_t seed, int stream);
+
+/**
+* returns the next 64 random bits
+*/
+uint64_t Rng_next(Rng_Ptr rng);
+
+/**
+* returns a random number in [0, bound)
+*/
+int Rng_range(Rng_Ptr rng, int bound);
+
+#endif
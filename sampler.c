@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "sampler.h"
+
+/**
+* This writes the buffer to the file when less than a line or a record is left in it
+*/
+void reserve(Sampler_Ptr sampler);
+
+/**
+* This appends the CSV line of the record to the buffer
+*/
+void formatLine(Sampler_Ptr sampler, const SampleRecord *record);
+
+Sampler_Ptr Sampler_constructor(FILE *out, int binary, unsigned int interval, int devices, int levels) {
+   Sampler_Ptr sampler = malloc(sizeof(Sampler));
+   int i;
+   sampler->out = out;
+   sampler->binary = binary;
+   sampler->devices = devices;
+   sampler->levels = levels;
+   sampler->recordSize = offsetof(SampleRecord, ready) + sizeof(int32_t) * levels;
+   sampler->interval = interval;
+   sampler->next = interval;
+   memset(&sampler->previous, 0, sizeof(SampleRecord));
+   sampler->buffer = malloc(SAMPLER_BUFFER_SIZE);
+   sampler->used = 0;
+
+   if (binary) {
+      SampleHeader header = {SAMPLER_MAGIC, SAMPLER_VERSION, sampler->recordSize, devices, levels};
+      memcpy(sampler->buffer, &header, sizeof(SampleHeader));
+      sampler->used = sizeof(SampleHeader);
+   } else {
+      sampler->used += sprintf(sampler->buffer + sampler->used, "time");
+
+      for (i = 0; i < levels; i++) {
+         sampler->used += sprintf(sampler->buffer + sampler->used, ",ready%d", i);
+      }
+
+      for (i = 0; i < devices; i++) {
+         sampler->used += sprintf(sampler->buffer + sampler->used, ",io%d", i + 1);
+      }
+
+      sampler->used += sprintf(sampler->buffer + sampler->used, ",mutex_waiters,switches,terminations,idle_cycles\n");
+   }
+
+   return sampler;
+}
+
+void Sampler_destructor(Sampler_Ptr sampler) {
+   fwrite(sampler->buffer, 1, sampler->used, sampler->out);
+   fflush(sampler->out);
+   free(sampler->buffer);
+   free(sampler);
+}
+
+void Sampler_start(Sampler_Ptr sampler, const SampleRecord *totals) {
+   sampler->previous = *totals;
+   sampler->next = (totals->time / sampler->interval + 1) * sampler->interval;
+}
+
+void reserve(Sampler_Ptr sampler) {
+   if (SAMPLER_BUFFER_SIZE - sampler->used < SAMPLER_LINE_LEN + (size_t) SAMPLER_COUNT_LEN * sampler->levels) {
+      fwrite(sampler->buffer, 1, sampler->used, sampler->out);
+      sampler->used = 0;
+   }
+}
+
+void formatLine(Sampler_Ptr sampler, const SampleRecord *record) {
+   char *line = sampler->buffer + sampler->used;
+   int i, length = sprintf(line, "%" PRIu64, record->time);
+
+   for (i = 0; i < sampler->levels; i++) {
+      length += sprintf(line + length, ",%d", record->ready[i]);
+   }
+
+   for (i = 0; i < sampler->devices; i++) {
+      length += sprintf(line + length, ",%d", record->io[i]);
+   }
+
+   length += sprintf(line + length, ",%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", record->mutexWaiters,
+      record->switches, record->terminations, record->idleCycles);
+   sampler->used += length;
+}
+
+void Sampler_add(Sampler_Ptr sampler, const SampleRecord *totals) {
+   SampleRecord record = *totals;
+   record.switches -= sampler->previous.switches;
+   record.terminations -= sampler->previous.terminations;
+   record.idleCycles -= sampler->previous.idleCycles;
+   sampler->previous = *totals;
+   sampler->next += sampler->interval;
+   reserve(sampler);
+
+   if (sampler->binary) {
+      memcpy(sampler->buffer + sampler->used, &record, sampler->recordSize);
+      sampler->used += sampler->recordSize;
+   } else {
+      formatLine(sampler, &record);
+   }
+}
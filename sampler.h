@@ -0,0 +1,97 @@
+/**
+* sampler.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for the metrics sampler implementation.
+* Every given number of cycles the simulation hands the sampler a fixed-size record of its
+* queues and counters, which is appended to a time series file as a binary record or as a
+* line of CSV. Records are collected in a buffer and written to the file when it fills up.
+*
+*/
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pcb.h"
+#include "priority_queue.h"
+
+#define SAMPLER_INTERVAL 100000 // default number of cycles between two samples
+#define SAMPLER_BUFFER_SIZE (1 << 16) // number of bytes of records buffered before they are written
+#define SAMPLER_LINE_LEN 512 // number of chars a CSV line can take without its ready counts
+#define SAMPLER_COUNT_LEN 12 // number of chars a ready count of a CSV line can take
+#define SAMPLER_MAGIC 0x504D5353 // "SSMP", first 4 bytes of a binary sample file
+#define SAMPLER_VERSION 3
+
+// This defines a sample record. Queue lengths are those at the time of the sample, the
+// counters are what happened since the previous sample. A binary record is cut after the
+// ready counts of the levels the run has.
+typedef struct {
+   uint64_t time; // system time the sample was taken at
+   uint64_t switches; // context switches of all cpus
+   uint64_t terminations; // processes terminated
+   uint64_t idleCycles; // cycles all cpus spent running their idle tasks
+   int32_t mutexWaiters; // pcbs waiting for the mutexes of all pairs
+   int32_t io[MAX_DEVICES]; // pcbs waiting for or being served by each I/O device, 0 for devices the run doesn't have
+   int32_t ready[MAX_PRIORITY_LEVELS]; // pcbs in the ready queues of all cpus at each level of the policy
+} SampleRecord;
+
+// This defines the header at the start of a binary sample file
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t recordSize; // number of bytes of each record, offsetof(SampleRecord, ready) and 4 per level
+   uint32_t devices; // number of I/O devices of the run
+   uint32_t levels; // number of priority levels of the run
+} SampleHeader;
+
+// This defines a sampler writing the samples of one simulation run
+typedef struct {
+   FILE *out;
+   int binary; // 1 writes binary records, 0 writes CSV lines
+   int devices; // number of I/O devices, CSV lines have a column for each
+   int levels; // number of priority levels, CSV lines have a column for each
+   size_t recordSize; // number of bytes of a binary record
+   unsigned int interval; // number of cycles between two samples
+   uint64_t next; // system time of the next sample
+   SampleRecord previous; // totals of the counters at the previous sample
+   char *buffer;
+   size_t used; // number of bytes in the buffer
+} Sampler;
+
+typedef Sampler *Sampler_Ptr;
+
+/**
+* creates a sampler writing a sample every interval cycles of a run with the given numbers of
+* I/O devices and priority levels to the given file. binary selects binary records instead of
+* CSV lines. The header of the file is written right away.
+*/
+Sampler_Ptr Sampler_constructor(FILE *out, int binary, unsigned int interval, int devices, int levels);
+
+/**
+* writes the records left in the buffer and frees the sampler. The file is flushed but not closed.
+*/
+void Sampler_destructor(Sampler_Ptr sampler);
+
+/**
+* starts sampling at the time of totals, which hold the counters so far, the first sample is
+* taken at the next multiple of the interval
+*/
+void Sampler_start(Sampler_Ptr sampler, const SampleRecord *totals);
+
+/**
+* adds the sample whose counters are the totals so far, they are written as what happened since
+* the previous sample, and moves the time of the next sample one interval on
+*/
+void Sampler_add(Sampler_Ptr sampler, const SampleRecord *totals);
+
+#endif
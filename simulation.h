@@ -0,0 +1,276 @@
+/**
+* simulation.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for one simulation run. All state
+* of a run lives in its Simulation, so several runs can go on at once in different threads.
+* A program embedding the simulator creates a Simulation, advances it with
+* Simulation_step() or Simulation_runUntil(), and queries it with Simulation_getStats()
+* as often as it likes.
+*
+*/
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+#include <stdint.h>
+#include "pcb.h"
+#include "queue.h"
+#include "priority_queue.h"
+#include "syn.h"
+#include "trace.h"
+#include "rng.h"
+#include "workload.h"
+#include "policy.h"
+#include "histogram.h"
+#include "device.h"
+#include "sampler.h"
+
+#define CYCLES 1000000 // default number of cycles we are going to run
+#define REFILL_FREQUENCY 3 // default cycle for refilling the ready queue
+#define TIMER_QUANTUM 300 // default time quantum for cpu timer
+#define MAX_CPUS 64 // max number of simulated cpus
+#define MAX_OVERHEAD 1000000 // max cycle cost of one kernel operation
+
+//define a type for system stack
+typedef struct {
+    unsigned int pc; // program counter
+    int sw; // state work
+} SysStack;
+
+typedef SysStack *SysStack_Ptr;
+
+// define the ways time can be advanced, one cycle at a time or from one event to the next
+typedef enum {Cycle_engine, Event_engine} Engine_Type;
+
+// define a type for one simulated cpu, every cpu runs its own pcb with its own timer and ready queue
+typedef struct {
+    int id; // index of this cpu, I/O interrupts are delivered to cpu 0
+    int refillCounter; // a counter for refilling the ready queue
+    int swRegister; // state work register
+    unsigned int pcRegister; // program counter register
+    PCB_Ptr curPCB; // current PCB
+    PCB_Ptr idleTask; // an idle task
+    SysStack sysStack;
+    void *readyQueue; // a queue of the policy holding PCBs that are in ready state and local to this cpu
+    int timerCounter; // cpu timer counter
+    int steals; // number of PCBs this cpu took from ready queues of other cpus
+    int kernelStall; // cycles of interrupt service routines and trap handlers the cpu owes before it runs its pcb again
+    int switchStall; // cycles of context switches the cpu owes, paid after kernelStall
+    uint64_t switches; // number of context switches to another pcb or the idle task
+    uint64_t userCycles; // number of cycles the cpu ran a process, the kernel, switched and ran its idle task
+    uint64_t kernelCycles;
+    uint64_t switchCycles;
+    uint64_t idleCycles;
+} CPU;
+
+typedef CPU *CPU_Ptr;
+
+// define the latencies measured for every process: cycles from creation to termination, from creation
+// to the first time it runs, spent in ready queues, spent waiting for I/O, locks and conditions, and
+// each wait for a mutex held by a process of lower priority
+typedef enum {Turnaround_latency, Response_latency, Wait_latency, Blocked_latency, Inversion_latency, LATENCY_METRICS} Latency_Metric;
+
+// define the cycles the kernel takes for its work, the cpu runs no process meanwhile and its timer stands
+// still, while I/O devices and ready queues go on
+typedef struct {
+    int contextSwitch; // loading a different pcb than the one that ran before
+    int timerISR; // every timer interrupt, whether it preempts or not
+    int ioISR; // every I/O completion interrupt, paid by cpu 0
+    int trapEntry; // every I/O, termination or synchronization trap
+} Overhead;
+
+typedef Overhead *Overhead_Ptr;
+
+// define the parameters of a run, Config_default() gives the values of the #defines
+typedef struct {
+    uint64_t cycles; // number of cycles Simulation_run() runs
+    int timerQuantum; // time quantum for cpu timer
+    unsigned int starvationTime; // max number of cycles a pcb stays at head of a ready queue level
+    int levels; // number of priority levels of the ready queues and the latency table, 0 is the highest priority
+    int refillFrequency; // the cycle for refilling the ready queue
+    int cpus; // number of simulated cpus
+    uint64_t seed; // seed of all random number streams of the run
+    Engine_Type engine;
+    Workload_Ptr workload; // processes to run, NULL for the built-in random workload
+    Policy_Type policy; // scheduling policy
+    int deadLockProne; // 1 makes the two pcbs of each built-in mutual resource pair lock their resources in opposite orders
+    int deadLockRecovery; // 1 breaks every deadlock by rolling a victim back, 0 leaves deadlocked pcbs blocked
+    int priorityInheritance; // 1 makes a pcb holding a mutex run with the priority of the highest priority pcb waiting for it
+    int bufferSlots; // number of slots of the buffer of each producer consumer pair, 0 for one shared integer they take turns on
+    int devices; // number of I/O devices
+    DeviceSpec deviceSpecs[MAX_DEVICES]; // parameters of each I/O device
+    Overhead overhead; // cycle costs of the kernel, all 0 by default
+} Config;
+
+typedef Config *Config_Ptr;
+
+// define the results of a run
+typedef struct {
+    uint64_t time; // system time the stats were taken at
+    int processesRun; // total number of processes created
+    int newQueue; // number of processes in each queue when the stats were taken
+    int readyQueue;
+    int terminationQueue;
+    int ioWaitQueue; // number of processes waiting for or being served by any I/O device
+    uint64_t ioServed; // number of I/O requests completed
+    int deadlocks; // number of cycles found in the wait-for graph
+    int recoveries; // number of deadlocks broken by rolling a victim back
+    uint64_t lostWork; // number of cycles of work undone by rollbacks
+    int inversions; // number of times a process waited for a mutex held by a process of lower priority
+    int boosts; // number of priorities inherited by processes holding a mutex
+    uint32_t inversionP99; // 99th percentile of the cycles those waits took
+    double itemsPerMillion; // number of items consumers read per million cycles
+    double blocksPerPair; // mean number of times the producer or the consumer of a pair waited for the other one
+    int steals; // number of processes stolen by idle cpus
+    // percent of the cycles of all cpus spent running processes, in interrupt service routines and
+    // trap handlers, switching contexts and running idle tasks
+    double userShare;
+    double kernelShare;
+    double switchShare;
+    double idleShare;
+    int completed; // number of processes terminated
+    double meanTurnaround; // mean number of cycles from creation to termination of terminated processes
+    uint32_t turnaroundP99; // 99th percentile of the turnaround of terminated processes
+    uint32_t responseP99; // 99th percentile of the response time of processes that ran
+} Stats;
+
+typedef Stats *Stats_Ptr;
+
+// define the state of one simulation run
+typedef struct {
+    Config config;
+    Policy_Ptr policy; // the scheduling policy of config
+    int nextPCB_ID;
+    int completed; // number of processes terminated
+    uint64_t turnaroundTime; // sum of cycles from creation to termination of terminated processes
+    int recoveries; // number of deadlocks broken by rolling a victim back
+    uint64_t lostWork; // number of cycles of work undone by rollbacks
+    int inversions; // number of times a pcb blocked on a mutex held by a pcb of lower priority
+    int boosts; // number of priorities inherited by pcbs holding a mutex
+    // latencies of processes by original priority and by type, response times are recorded when a process
+    // runs for the first time and the others when it terminates
+    Histogram_Ptr *priorityLatency[LATENCY_METRICS]; // config.levels histograms of each metric
+    Histogram_Ptr typeLatency[LATENCY_METRICS][PCB_TYPES];
+    CPU_Ptr cpus; // all simulated cpus
+    CPU_Ptr cpu; // the cpu whose part of the current cycle is being simulated
+    PCBPool_Ptr pcbPool; // a pool recycling PCBs of terminated processes
+    Trace_Ptr trace; // a trace receiving all events of this run, NULL when nothing is traced
+    Sampler_Ptr sampler; // a sampler receiving the queues and counters of this run, NULL when nothing is sampled
+    Rng_Ptr workloadRng; // random numbers for types, priorities and lifetimes of pcbs
+    Rng_Ptr trapRng; // random numbers for io trap pcs
+    Rng_Ptr ioRng; // random numbers for io service times
+    Rng_Ptr blockRng; // random numbers for block addresses of io requests
+    Queue_Ptr newQueue; // a queue holding all newly created PCBs
+    Queue_Ptr terminationQueue; // a queue holding PCBs that are going to be terminated
+    Device_Ptr devices[MAX_DEVICES]; // all I/O devices
+    uint64_t cpuTime; // a counter used for system time, 64 bits so long runs never wrap it
+    uint64_t nextArrival; // index of the next record of the workload file to create a pcb for
+    // next pair ID handed out to producer consumer pcbs of the built-in workload, even numbers are for producers,
+    // pcbs with pair ID 2 * i and 2 * i + 1 form pair i
+    int pcPairID;
+    // next pair ID handed out to mutual resource pcbs of the built-in workload, even numbers are for process A type
+    int mrPairID;
+    SyncRegistry_Ptr sync; // mutexes, conditional variables and shared integers of all pairs, indexed by pair ID / 2
+} Simulation;
+
+typedef Simulation *Simulation_Ptr;
+
+/**
+* fills the config with the default parameters and the given seed
+*/
+void Config_default(Config_Ptr config, uint64_t seed);
+
+/**
+* sets the overhead from a comma separated list of key=value settings: switch, timer, io and
+* trap, each a number of cycles up to MAX_OVERHEAD, settings not in the list are 0. Returns 0
+* when the list isn't valid.
+*/
+int Overhead_parse(Overhead_Ptr overhead, const char *list);
+
+/**
+* creates a simulation with the given parameters and its initial processes, events
+* go to the given trace, which may be NULL
+*/
+Simulation_Ptr Simulation_constructor(const Config *config, Trace_Ptr trace);
+
+/**
+* frees all memory used by the simulation, the trace is not destroyed
+*/
+void Simulation_destructor(Simulation_Ptr sim);
+
+/**
+* changes the parameters of the simulation, new values take effect from the current cycle on.
+* Returns 0 without changing anything when config has a different number of cpus, seed,
+* workload, policy, priority levels, buffer slots or devices, which are fixed when the
+* simulation is created,
+* 1 otherwise
+*/
+int Simulation_configure(Simulation_Ptr sim, const Config *config);
+
+/**
+* runs the given number of cycles and returns number of cycles run, which is less only when
+* the system time would overflow
+*/
+unsigned int Simulation_step(Simulation_Ptr sim, unsigned int cycles);
+
+/**
+* runs the simulation until its system time reaches the given time, does nothing when it already has
+*/
+void Simulation_runUntil(Simulation_Ptr sim, uint64_t time);
+
+/**
+* runs the simulation until its system time reaches the number of cycles in its config
+*/
+void Simulation_run(Simulation_Ptr sim);
+
+/**
+* returns system time of the simulation, which is the number of cycles run so far
+*/
+uint64_t Simulation_getTime(Simulation_Ptr sim);
+
+/**
+* fills stats with the results of the simulation so far
+*/
+void Simulation_getStats(Simulation_Ptr sim, Stats_Ptr stats);
+
+/**
+* prints out statistics for the simulation
+*/
+void Simulation_printStats(Simulation_Ptr sim);
+
+/**
+* writes the whole state of the simulation to a snapshot file with the given name, which is only
+* replaced once the snapshot is complete. Returns 1 on success, 0 otherwise.
+*/
+int Simulation_save(Simulation_Ptr sim, const char *fileName);
+
+/**
+* creates a simulation in the state written to the snapshot file with the given name, which goes
+* on exactly as the saved one would have. workload must be the workload the saved simulation ran,
+* or NULL when it ran the built-in one. Events go nowhere until Simulation_setTrace() is called.
+* Returns NULL when the file can't be read, wasn't written by a build with the same layout or
+* was taken with a different workload.
+*/
+Simulation_Ptr Simulation_restore(const char *fileName, Workload_Ptr workload);
+
+/**
+* makes the given trace receive the events of the simulation from now on, NULL drops them
+*/
+void Simulation_setTrace(Simulation_Ptr sim, Trace_Ptr trace);
+
+/**
+* makes the given sampler receive a sample of the simulation at every multiple of its interval
+* from now on, NULL stops sampling. Samples are taken before the cycle of their time runs, and
+* when a run ends at one, so both engines write the same samples.
+*/
+void Simulation_setSampler(Simulation_Ptr sim, Sampler_Ptr sampler);
+
+#endif
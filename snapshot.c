@@ -0,0 +1,369 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "snapshot.h"
+
+/**
+* opens the file with the given mode and gives it the buffer of the snapshot
+*/
+Snapshot_Ptr openSnapshot(const char *fileName, const char *mode);
+
+/**
+* numbers the pcbs of the given slabs, listed in pool order, and then the extra ones
+*/
+void numberSlabs(Snapshot_Ptr snapshot, PCBSlab **slabList, int slabCount, PCB_Ptr *extras, int extraCount);
+
+/**
+* compares slabs by address for qsort()
+*/
+int compareSlabs(const void *one, const void *two);
+
+/**
+* returns number of the pcb, or -1 when the snapshot doesn't number it
+*/
+int pcbNumber(Snapshot_Ptr snapshot, PCB_Ptr pcb);
+
+/**
+* writes the contents of the pcb, its links to other pcbs as their numbers
+*/
+void writeRecord(Snapshot_Ptr snapshot, PCB_Ptr pcb);
+
+/**
+* reads the contents of the pcb written by writeRecord(), it waits on no mutex afterwards
+*/
+void readRecord(Snapshot_Ptr snapshot, PCB_Ptr pcb);
+
+Snapshot_Ptr openSnapshot(const char *fileName, const char *mode) {
+   Snapshot_Ptr snapshot = malloc(sizeof(Snapshot));
+   snapshot->writing = mode[0] == 'w';
+   snapshot->fileName = malloc(strlen(fileName) + 5);
+   snapshot->tempName = malloc(strlen(fileName) + 5);
+   strcpy(snapshot->fileName, fileName);
+   sprintf(snapshot->tempName, "%s.tmp", fileName);
+   // a snapshot is written beside the file and renamed over it once complete
+   snapshot->file = fopen(snapshot->writing ? snapshot->tempName : fileName, mode);
+
+   if (snapshot->file == NULL) {
+      free(snapshot->fileName);
+      free(snapshot->tempName);
+      free(snapshot);
+      return NULL;
+   }
+
+   snapshot->buffer = malloc(SNAPSHOT_BUFFER_SIZE);
+   setvbuf(snapshot->file, snapshot->buffer, _IOFBF, SNAPSHOT_BUFFER_SIZE);
+   snapshot->failed = 0;
+   snapshot->slabs = NULL;
+   snapshot->slabList = NULL;
+   snapshot->slabCount = 0;
+   snapshot->extras = NULL;
+   snapshot->extraCount = 0;
+   return snapshot;
+}
+
+Snapshot_Ptr Snapshot_create(const char *fileName) {
+   Snapshot_Ptr snapshot = openSnapshot(fileName, "wb");
+   SnapshotHeader header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, sizeof(PCB), sizeof(void *)};
+
+   if (snapshot != NULL) {
+      Snapshot_write(snapshot, &header, sizeof(header));
+   }
+
+   return snapshot;
+}
+
+Snapshot_Ptr Snapshot_open(const char *fileName) {
+   Snapshot_Ptr snapshot = openSnapshot(fileName, "rb");
+   SnapshotHeader header;
+
+   if (snapshot == NULL) {
+      return NULL;
+   }
+
+   Snapshot_read(snapshot, &header, sizeof(header));
+
+   if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION || header.pcbSize != sizeof(PCB)
+      || header.pointerSize != sizeof(void *)) {
+      Snapshot_close(snapshot);
+      return NULL;
+   }
+
+   return snapshot;
+}
+
+int Snapshot_close(Snapshot_Ptr snapshot) {
+   int succeeded = fclose(snapshot->file) == 0 && !snapshot->failed;
+
+   if (snapshot->writing) {
+      if (succeeded && rename(snapshot->tempName, snapshot->fileName) != 0) {
+         succeeded = 0;
+      }
+
+      if (!succeeded) {
+         remove(snapshot->tempName);
+      }
+   }
+
+   free(snapshot->fileName);
+   free(snapshot->tempName);
+   free(snapshot->buffer);
+   free(snapshot->slabs);
+   free(snapshot->slabList);
+   free(snapshot);
+   return succeeded;
+}
+
+void Snapshot_write(Snapshot_Ptr snapshot, const void *data, size_t size) {
+   // an empty array may have no memory at all
+   if (size == 0) return;
+
+   if (!snapshot->failed && fwrite(data, 1, size, snapshot->file) != size) {
+      snapshot->failed = 1;
+   }
+}
+
+void Snapshot_read(Snapshot_Ptr snapshot, void *data, size_t size) {
+   if (size == 0) return;
+
+   if (snapshot->failed || fread(data, 1, size, snapshot->file) != size) {
+      snapshot->failed = 1;
+      memset(data, 0, size);
+   }
+}
+
+void Snapshot_fail(Snapshot_Ptr snapshot) {
+   snapshot->failed = 1;
+}
+
+int compareSlabs(const void *one, const void *two) {
+   uintptr_t first = (uintptr_t) ((const SnapshotSlab *) one)->slab;
+   uintptr_t second = (uintptr_t) ((const SnapshotSlab *) two)->slab;
+   return (first > second) - (first < second);
+}
+
+void numberSlabs(Snapshot_Ptr snapshot, PCBSlab **slabList, int slabCount, PCB_Ptr *extras, int extraCount) {
+   int i;
+   snapshot->slabList = slabList;
+   snapshot->slabCount = slabCount;
+   snapshot->slabs = malloc(sizeof(SnapshotSlab) * (slabCount ? slabCount : 1));
+   snapshot->extras = extras;
+   snapshot->extraCount = extraCount;
+
+   for (i = 0; i < slabCount; i++) {
+      snapshot->slabs[i].slab = slabList[i];
+      snapshot->slabs[i].number = i;
+   }
+
+   qsort(snapshot->slabs, slabCount, sizeof(SnapshotSlab), compareSlabs);
+}
+
+int pcbNumber(Snapshot_Ptr snapshot, PCB_Ptr pcb) {
+   int low = 0, high = snapshot->slabCount, middle, i;
+   PCBSlab *slab;
+
+   // finds the last slab that starts at or before the pcb
+   while (high - low > 1) {
+      middle = (low + high) / 2;
+
+      if ((uintptr_t) snapshot->slabs[middle].slab <= (uintptr_t) pcb) {
+         low = middle;
+      } else {
+         high = middle;
+      }
+   }
+
+   if (snapshot->slabCount > 0) {
+      slab = snapshot->slabs[low].slab;
+
+      if ((uintptr_t) pcb >= (uintptr_t) slab->pcbs && (uintptr_t) pcb < (uintptr_t) (slab->pcbs + PCB_SLAB_SIZE)) {
+         return snapshot->slabs[low].number * PCB_SLAB_SIZE + (pcb - slab->pcbs);
+      }
+   }
+
+   for (i = 0; i < snapshot->extraCount; i++) {
+      if (snapshot->extras[i] == pcb) {
+         return snapshot->slabCount * PCB_SLAB_SIZE + i;
+      }
+   }
+
+   return -1;
+}
+
+void writeRecord(Snapshot_Ptr snapshot, PCB_Ptr pcb) {
+   PCB record;
+
+   // pointers mean nothing to another process, the links are written as numbers and
+   // the mutex a pcb waits on is set again when the waiting queue of the mutex is read
+   memcpy(&record, pcb, sizeof(PCB));
+   record.treeParent = NULL;
+   record.treeLeft = NULL;
+   record.treeRight = NULL;
+   record.waitingOn = NULL;
+   record.nextFree = NULL;
+   record.ioTraps = NULL;
+   record.traps = NULL;
+   Snapshot_write(snapshot, &record, sizeof(PCB));
+   Snapshot_writePCB(snapshot, pcb->treeParent);
+   Snapshot_writePCB(snapshot, pcb->treeLeft);
+   Snapshot_writePCB(snapshot, pcb->treeRight);
+   Snapshot_write(snapshot, pcb->ioTraps, sizeof(IoTrap) * pcb->ioTrapCount);
+   Snapshot_write(snapshot, pcb->traps, sizeof(TrapEntry) * pcb->trapCount);
+}
+
+void readRecord(Snapshot_Ptr snapshot, PCB_Ptr pcb) {
+   PCB record;
+   Snapshot_read(snapshot, &record, sizeof(PCB));
+
+   if (record.type >= PCB_TYPES || record.curState > Terminated || record.ioTrapCount < 0
+      || record.ioTrapCount > MAX_IO_TRAPS || record.trapCount < 0 || record.trapCount > record.ioTrapCount + SYN_TRAPS
+      || record.nextTrap < 0 || record.nextTrap > record.trapCount) {
+      Snapshot_fail(snapshot);
+      record.ioTrapCount = 0;
+      record.trapCount = 0;
+      record.nextTrap = 0;
+   }
+
+   // the pcb keeps its own trap arrays, grown to hold those of the record
+   record.ioTraps = pcb->ioTraps;
+   record.traps = pcb->traps;
+   record.trapCapacity = pcb->trapCapacity;
+   *pcb = record;
+   PCB_reserveTraps(pcb, pcb->ioTrapCount);
+   pcb->treeParent = Snapshot_readPCB(snapshot);
+   pcb->treeLeft = Snapshot_readPCB(snapshot);
+   pcb->treeRight = Snapshot_readPCB(snapshot);
+   pcb->waitingOn = NULL;
+   pcb->nextFree = NULL;
+   Snapshot_read(snapshot, pcb->ioTraps, sizeof(IoTrap) * pcb->ioTrapCount);
+   Snapshot_read(snapshot, pcb->traps, sizeof(TrapEntry) * pcb->trapCount);
+}
+
+void Snapshot_writePool(Snapshot_Ptr snapshot, PCBPool_Ptr pool, PCB_Ptr *extras, int extraCount) {
+   PCBSlab *slab, **slabList;
+   PCB_Ptr pcb;
+   int32_t slabCount = 0, freeCount = 0;
+   char *isFree;
+   int i = 0;
+
+   for (slab = pool->slabs; slab != NULL; slab = slab->next) {
+      slabCount++;
+   }
+
+   for (pcb = pool->freeList; pcb != NULL; pcb = pcb->nextFree) {
+      freeCount++;
+   }
+
+   slabList = malloc(sizeof(PCBSlab *) * (slabCount ? slabCount : 1));
+
+   for (slab = pool->slabs; slab != NULL; slab = slab->next) {
+      slabList[i++] = slab;
+   }
+
+   numberSlabs(snapshot, slabList, slabCount, extras, extraCount);
+   isFree = calloc(Snapshot_pcbCount(snapshot), 1);
+   Snapshot_write(snapshot, &slabCount, sizeof(slabCount));
+   Snapshot_write(snapshot, &freeCount, sizeof(freeCount));
+
+   // the free list decides which memory new pcbs get, so it is kept in order
+   for (pcb = pool->freeList; pcb != NULL; pcb = pcb->nextFree) {
+      Snapshot_writePCB(snapshot, pcb);
+      isFree[pcbNumber(snapshot, pcb)] = 1;
+   }
+
+   // free pcbs are reset when they are handed out again, so only the others are written
+   for (i = 0; i < Snapshot_pcbCount(snapshot); i++) {
+      if (!isFree[i]) {
+         writeRecord(snapshot, Snapshot_pcbAt(snapshot, i));
+      }
+   }
+
+   free(isFree);
+}
+
+void Snapshot_readPool(Snapshot_Ptr snapshot, PCBPool_Ptr pool, PCB_Ptr *extras, int extraCount) {
+   PCBSlab **slabList, **tail = &pool->slabs;
+   PCB_Ptr pcb, *freeTail = &pool->freeList;
+   int32_t slabCount, freeCount;
+   char *isFree;
+   int i;
+
+   Snapshot_read(snapshot, &slabCount, sizeof(slabCount));
+   Snapshot_read(snapshot, &freeCount, sizeof(freeCount));
+
+   if (slabCount < 0 || slabCount > (INT32_MAX - extraCount) / PCB_SLAB_SIZE || freeCount < 0
+      || freeCount > slabCount * PCB_SLAB_SIZE) {
+      Snapshot_fail(snapshot);
+      slabCount = 0;
+      freeCount = 0;
+   }
+
+   slabList = malloc(sizeof(PCBSlab *) * (slabCount ? slabCount : 1));
+
+   for (i = 0; i < slabCount; i++) {
+      slabList[i] = PCBSlab_constructor();
+      *tail = slabList[i];
+      tail = &slabList[i]->next;
+   }
+
+   *tail = NULL;
+   numberSlabs(snapshot, slabList, slabCount, extras, extraCount);
+   isFree = calloc(Snapshot_pcbCount(snapshot), 1);
+
+   for (i = 0; i < freeCount; i++) {
+      pcb = Snapshot_readPCB(snapshot);
+
+      // only pcbs of the pool can be free, and one listed twice would make the free list a cycle
+      if (pcb == NULL || pcbNumber(snapshot, pcb) >= slabCount * PCB_SLAB_SIZE || isFree[pcbNumber(snapshot, pcb)]) {
+         Snapshot_fail(snapshot);
+         break;
+      }
+
+      isFree[pcbNumber(snapshot, pcb)] = 1;
+      *freeTail = pcb;
+      freeTail = &pcb->nextFree;
+   }
+
+   *freeTail = NULL;
+
+   for (i = 0; i < Snapshot_pcbCount(snapshot) && !snapshot->failed; i++) {
+      if (!isFree[i]) {
+         readRecord(snapshot, Snapshot_pcbAt(snapshot, i));
+      }
+   }
+
+   free(isFree);
+}
+
+int Snapshot_pcbCount(Snapshot_Ptr snapshot) {
+   return snapshot->slabCount * PCB_SLAB_SIZE + snapshot->extraCount;
+}
+
+PCB_Ptr Snapshot_pcbAt(Snapshot_Ptr snapshot, int number) {
+   if (number >= snapshot->slabCount * PCB_SLAB_SIZE) {
+      return snapshot->extras[number - snapshot->slabCount * PCB_SLAB_SIZE];
+   }
+
+   return &snapshot->slabList[number / PCB_SLAB_SIZE]->pcbs[number % PCB_SLAB_SIZE];
+}
+
+void Snapshot_writePCB(Snapshot_Ptr snapshot, PCB_Ptr pcb) {
+   int32_t number = pcb == NULL ? -1 : pcbNumber(snapshot, pcb);
+
+   if (pcb != NULL && number < 0) {
+      Snapshot_fail(snapshot);
+   }
+
+   Snapshot_write(snapshot, &number, sizeof(number));
+}
+
+PCB_Ptr Snapshot_readPCB(Snapshot_Ptr snapshot) {
+   int32_t number;
+   Snapshot_read(snapshot, &number, sizeof(number));
+
+   if (number < -1 || number >= Snapshot_pcbCount(snapshot)) {
+      Snapshot_fail(snapshot);
+      return NULL;
+   }
+
+   return number < 0 ? NULL : Snapshot_pcbAt(snapshot, number);
+}
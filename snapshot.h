@@ -0,0 +1,128 @@
+/**
+* snapshot.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for the snapshot implementation. A
+* snapshot is a binary file holding the whole state of a simulation, written and read
+* through one large stdio buffer. Pcbs are written as their number in the pcb pool, so
+* every structure refers to them the same way no matter where they are in memory.
+*
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pcb.h"
+
+#define SNAPSHOT_BUFFER_SIZE (1 << 20) // number of bytes buffered between reads or writes of the file
+#define SNAPSHOT_MAGIC 0x504E5353 // "SSNP", first 4 bytes of a snapshot file
+#define SNAPSHOT_VERSION 7
+
+// This defines the header at the start of a snapshot file, structs are written as they are in
+// memory, so a snapshot can only be read by a build with the same layout
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t pcbSize;
+   uint32_t pointerSize;
+} SnapshotHeader;
+
+// This defines a slab of the pcb pool and its place in the list of the pool
+typedef struct {
+   PCBSlab *slab;
+   int number;
+} SnapshotSlab;
+
+// This defines a snapshot type
+typedef struct {
+   FILE *file;
+   char *buffer;
+   char *fileName;
+   char *tempName; // file written until the snapshot is complete, then renamed to fileName
+   int writing; // 1 when the snapshot was created, 0 when it was opened
+   int failed; // 1 once a read or write failed or the file held something invalid
+   SnapshotSlab *slabs; // slabs of the pcb pool sorted by address, pcb i is pcbs[i % PCB_SLAB_SIZE] of slab i / PCB_SLAB_SIZE
+   PCBSlab **slabList; // the same slabs in the order of the list of the pool
+   int slabCount;
+   PCB_Ptr *extras; // pcbs outside the pool, numbered after those of the pool
+   int extraCount;
+} Snapshot;
+
+typedef Snapshot *Snapshot_Ptr;
+
+/**
+* creates a file for writing a snapshot that replaces the file with the given name when it is
+* closed, returns NULL when it can't be created
+*/
+Snapshot_Ptr Snapshot_create(const char *fileName);
+
+/**
+* opens the file with the given name for reading a snapshot, returns NULL when it can't be opened
+* or wasn't written by a build with the same layout
+*/
+Snapshot_Ptr Snapshot_open(const char *fileName);
+
+/**
+* closes the file and frees memory used by the snapshot, returns 1 when every read and
+* write succeeded and 0 otherwise. A snapshot that failed doesn't replace any file.
+*/
+int Snapshot_close(Snapshot_Ptr snapshot);
+
+/**
+* writes size bytes of data
+*/
+void Snapshot_write(Snapshot_Ptr snapshot, const void *data, size_t size);
+
+/**
+* reads size bytes into data, which is zeroed when they can't be read
+*/
+void Snapshot_read(Snapshot_Ptr snapshot, void *data, size_t size);
+
+/**
+* marks the snapshot as failed, used when a value read is out of range
+*/
+void Snapshot_fail(Snapshot_Ptr snapshot);
+
+/**
+* writes the slabs, the free list and the pcbs of the pool followed by the extra pcbs, and
+* numbers them for Snapshot_writePCB()
+*/
+void Snapshot_writePool(Snapshot_Ptr snapshot, PCBPool_Ptr pool, PCB_Ptr *extras, int extraCount);
+
+/**
+* gives the empty pool the slabs, the free list and the pcbs written by Snapshot_writePool(), and
+* reads the extra pcbs, which must exist already. No pcb waits on a mutex afterwards.
+*/
+void Snapshot_readPool(Snapshot_Ptr snapshot, PCBPool_Ptr pool, PCB_Ptr *extras, int extraCount);
+
+/**
+* returns number of pcbs the snapshot numbers, including free ones of the pool
+*/
+int Snapshot_pcbCount(Snapshot_Ptr snapshot);
+
+/**
+* returns the pcb with the given number
+*/
+PCB_Ptr Snapshot_pcbAt(Snapshot_Ptr snapshot, int number);
+
+/**
+* writes the number of the pcb, which may be NULL
+*/
+void Snapshot_writePCB(Snapshot_Ptr snapshot, PCB_Ptr pcb);
+
+/**
+* reads a pcb written by Snapshot_writePCB(), returns NULL for NULL or when the number isn't valid
+*/
+PCB_Ptr Snapshot_readPCB(Snapshot_Ptr snapshot);
+
+#endif
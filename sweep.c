@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include "sweep.h"
+
+// smallest and largest value of each parameter, in Sweep_Param order
+const uint64_t sweepMin[] = {1, 1, 0, 0, 1, 0, 0};
+const uint64_t sweepMax[] = {INT64_MAX, INT32_MAX, UINT32_MAX, INT32_MAX, MAX_CPUS, POLICIES - 1, SYNC_MAX_SLOTS};
+
+// This defines the work shared by the threads of a running sweep
+typedef struct {
+   Sweep_Ptr sweep;
+   Stats_Ptr results; // stats of every run, indexed by run
+   atomic_int nextRun; // index of the next run a thread takes
+   atomic_int failed; // set when a run couldn't be restored, no thread takes another run then
+} SweepJob;
+
+/**
+* This is a sweep thread, it takes runs one by one until none is left
+*/
+void *sweepWorker(void *arg);
+
+/**
+* This prints the averages of the runs of one combination of parameter values
+*/
+void printCombination(Sweep_Ptr sweep, Stats_Ptr results, int combination, FILE *out);
+
+Sweep_Ptr Sweep_constructor(uint64_t firstSeed) {
+   Sweep_Ptr sweep = malloc(sizeof(Sweep));
+   Config config;
+   int i;
+   Config_default(&config, firstSeed);
+
+   sweep->values[Sweep_cycles][0] = config.cycles;
+   sweep->values[Sweep_quantum][0] = config.timerQuantum;
+   sweep->values[Sweep_starvation][0] = config.starvationTime;
+   sweep->values[Sweep_refill][0] = config.refillFrequency;
+   sweep->values[Sweep_cpus][0] = config.cpus;
+   sweep->values[Sweep_policy][0] = config.policy;
+   sweep->values[Sweep_slots][0] = config.bufferSlots;
+   sweep->seeds = 1;
+   sweep->firstSeed = firstSeed;
+   sweep->engine = config.engine;
+   sweep->deadLockProne = config.deadLockProne;
+   sweep->deadLockRecovery = config.deadLockRecovery;
+   sweep->priorityInheritance = config.priorityInheritance;
+   sweep->levels = config.levels;
+   sweep->devices = config.devices;
+   memcpy(sweep->deviceSpecs, config.deviceSpecs, sizeof(config.deviceSpecs));
+   sweep->overhead = config.overhead;
+   sweep->workload = config.workload;
+   sweep->snapshot = NULL;
+   sweep->threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+   for (i = 0; i < SWEEP_PARAMS; i++) {
+      sweep->counts[i] = 1;
+   }
+
+   return sweep;
+}
+
+void Sweep_destructor(Sweep_Ptr sweep) {
+   free(sweep);
+}
+
+int Sweep_setValues(Sweep_Ptr sweep, Sweep_Param param, const char *list) {
+   uint64_t values[SWEEP_MAX_VALUES];
+   int count = 0;
+   char *end;
+
+   do {
+      unsigned long long value;
+
+      if (param == Sweep_policy) {
+         Policy_Ptr policy = Policy_find(list, strcspn(list, ","));
+         end = (char *) list + strcspn(list, ",");
+         value = policy == NULL ? sweepMax[param] + 1ULL : (unsigned long long) (policy - Policy_table);
+      } else {
+         value = strtoull(list, &end, 10);
+      }
+
+      if (end == list || value < sweepMin[param] || value > sweepMax[param] || count == SWEEP_MAX_VALUES) {
+         return 0;
+      }
+
+      values[count++] = value;
+      list = end + 1;
+   } while (*end == ',');
+
+   if (*end != '\0') {
+      return 0;
+   }
+
+   memcpy(sweep->values[param], values, sizeof(uint64_t) * count);
+   sweep->counts[param] = count;
+   return 1;
+}
+
+int Sweep_runs(Sweep_Ptr sweep) {
+   uint64_t runs = sweep->seeds;
+   int i;
+
+   // every factor is below 2^31, so stopping once past the cap keeps the product from overflowing
+   for (i = 0; i < SWEEP_PARAMS && runs <= SWEEP_MAX_RUNS; i++) {
+      runs *= sweep->counts[i];
+   }
+
+   return runs <= SWEEP_MAX_RUNS ? (int) runs : SWEEP_MAX_RUNS + 1;
+}
+
+void Sweep_getConfig(Sweep_Ptr sweep, int run, Config_Ptr config) {
+   uint64_t value[SWEEP_PARAMS];
+   int combination = run / sweep->seeds;
+   int i;
+
+   // the last parameter changes fastest, so the table is ordered by the first one
+   for (i = SWEEP_PARAMS - 1; i >= 0; i--) {
+      value[i] = sweep->values[i][combination % sweep->counts[i]];
+      combination /= sweep->counts[i];
+   }
+
+   Config_default(config, sweep->firstSeed + run % sweep->seeds);
+   config->cycles = value[Sweep_cycles];
+   config->timerQuantum = value[Sweep_quantum];
+   config->starvationTime = value[Sweep_starvation];
+   config->refillFrequency = value[Sweep_refill];
+   config->cpus = value[Sweep_cpus];
+   config->policy = value[Sweep_policy];
+   config->bufferSlots = value[Sweep_slots];
+   config->engine = sweep->engine;
+   config->deadLockProne = sweep->deadLockProne;
+   config->deadLockRecovery = sweep->deadLockRecovery;
+   config->priorityInheritance = sweep->priorityInheritance;
+   config->levels = sweep->levels;
+   config->devices = sweep->devices;
+   memcpy(config->deviceSpecs, sweep->deviceSpecs, sizeof(sweep->deviceSpecs));
+   config->overhead = sweep->overhead;
+   config->workload = sweep->workload;
+}
+
+void *sweepWorker(void *arg) {
+   SweepJob *job = arg;
+   int runs = Sweep_runs(job->sweep);
+   int run;
+   Config config;
+
+   while (!atomic_load(&job->failed) && (run = atomic_fetch_add(&job->nextRun, 1)) < runs) {
+      Sweep_getConfig(job->sweep, run, &config);
+      Simulation_Ptr sim;
+
+      if (job->sweep->snapshot == NULL) {
+         sim = Simulation_constructor(&config, NULL);
+      } else if ((sim = Simulation_restore(job->sweep->snapshot, config.workload)) == NULL
+         || !Simulation_configure(sim, &config)) {
+         // the snapshot changed on disk since the sweep was set up
+         if (sim != NULL) {
+            Simulation_destructor(sim);
+         }
+
+         atomic_store(&job->failed, 1);
+         break;
+      }
+
+      Simulation_run(sim);
+      Simulation_getStats(sim, &job->results[run]);
+      Simulation_destructor(sim);
+   }
+
+   return NULL;
+}
+
+void printCombination(Sweep_Ptr sweep, Stats_Ptr results, int combination, FILE *out) {
+   double processes = 0, ready = 0, io = 0, ioServed = 0, steals = 0, completed = 0, turnaround = 0;
+   double turnaroundP99 = 0, responseP99 = 0, recoveries = 0, inversions = 0, inversionP99 = 0;
+   double items = 0, blocks = 0, user = 0, kernel = 0, context = 0, idle = 0;
+   int i, deadlocked = 0;
+   Config config;
+   Sweep_getConfig(sweep, combination * sweep->seeds, &config);
+
+   for (i = 0; i < sweep->seeds; i++) {
+      Stats_Ptr stats = &results[combination * sweep->seeds + i];
+      processes += stats->processesRun;
+      ready += stats->readyQueue;
+      io += stats->ioWaitQueue;
+      ioServed += stats->ioServed;
+      steals += stats->steals;
+      deadlocked += stats->deadlocks > 0;
+      recoveries += stats->recoveries;
+      inversions += stats->inversions;
+      inversionP99 += stats->inversionP99;
+      items += stats->itemsPerMillion;
+      blocks += stats->blocksPerPair;
+      user += stats->userShare;
+      kernel += stats->kernelShare;
+      context += stats->switchShare;
+      idle += stats->idleShare;
+      completed += stats->completed;
+      turnaround += stats->meanTurnaround;
+      turnaroundP99 += stats->turnaroundP99;
+      responseP99 += stats->responseP99;
+   }
+
+   fprintf(out, "%10" PRIu64 " %7d %10u %6d %4d %6s %5d %5d %10.1f %7.1f %7.1f %9.1f %9d %10.1f %10.1f %8.1f %8.1f %9.1f %10.1f %10.1f %10.1f %9.1f %11.2f %6.1f %6.1f %6.1f %6.1f\n",
+      config.cycles, config.timerQuantum, config.starvationTime, config.refillFrequency, config.cpus,
+      Policy_table[config.policy].name, config.bufferSlots, sweep->seeds, processes / sweep->seeds, ready / sweep->seeds,
+      io / sweep->seeds, ioServed / sweep->seeds, deadlocked, recoveries / sweep->seeds,
+      inversions / sweep->seeds, inversionP99 / sweep->seeds, steals / sweep->seeds,
+      completed / sweep->seeds, turnaround / sweep->seeds, turnaroundP99 / sweep->seeds, responseP99 / sweep->seeds,
+      items / sweep->seeds, blocks / sweep->seeds, user / sweep->seeds, kernel / sweep->seeds, context / sweep->seeds,
+      idle / sweep->seeds);
+}
+
+int Sweep_run(Sweep_Ptr sweep, FILE *out) {
+   int runs = Sweep_runs(sweep);
+   int threads = sweep->threads < runs ? sweep->threads : runs;
+   pthread_t *workers;
+   SweepJob job;
+   int i;
+
+   if (runs > SWEEP_MAX_RUNS) {
+      return 0;
+   }
+
+   workers = malloc(sizeof(pthread_t) * threads);
+   job.sweep = sweep;
+   job.results = malloc(sizeof(Stats) * runs);
+   atomic_init(&job.nextRun, 0);
+   atomic_init(&job.failed, 0);
+
+   for (i = 0; i < threads; i++) {
+      pthread_create(&workers[i], NULL, sweepWorker, &job);
+   }
+
+   for (i = 0; i < threads; i++) {
+      pthread_join(workers[i], NULL);
+   }
+
+   // averages missing runs would look plausible and be wrong
+   if (atomic_load(&job.failed)) {
+      free(job.results);
+      free(workers);
+      return 0;
+   }
+
+   fprintf(out, "%10s %7s %10s %6s %4s %6s %5s %5s %10s %7s %7s %9s %9s %10s %10s %8s %8s %9s %10s %10s %10s %9s %11s %6s %6s %6s %6s\n", "cycles",
+      "quantum", "starvation", "refill", "cpus", "policy", "slots", "runs", "processes", "ready", "io", "io served", "deadlocks", "recoveries",
+      "inversions", "inv p99", "steals", "completed", "turnaround", "turn p99", "resp p99", "items/Mc", "blocks/pair", "user%",
+      "kern%", "swch%", "idle%");
+
+   for (i = 0; i < runs / sweep->seeds; i++) {
+      printCombination(sweep, job.results, i, out);
+   }
+
+   free(job.results);
+   free(workers);
+   return 1;
+}
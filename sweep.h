@@ -0,0 +1,90 @@
+/**
+* sweep.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for the parameter sweep implementation.
+* A sweep runs every combination of the parameter values once for each seed, spreads
+* the runs over a pool of threads, and prints one line of averages per combination.
+*
+*/
+
+#ifndef SWEEP_H
+#define SWEEP_H
+#include <stdio.h>
+#include <stdint.h>
+#include "simulation.h"
+
+#define SWEEP_MAX_VALUES 64 // max number of values a parameter can take in a sweep
+#define SWEEP_MAX_RUNS 1000000 // max number of runs of a sweep
+
+// This defines the parameters that can be swept
+typedef enum {Sweep_cycles, Sweep_quantum, Sweep_starvation, Sweep_refill, Sweep_cpus, Sweep_policy, Sweep_slots,
+   SWEEP_PARAMS} Sweep_Param;
+
+// This defines a sweep type
+typedef struct {
+   uint64_t values[SWEEP_PARAMS][SWEEP_MAX_VALUES]; // values of each parameter
+   int counts[SWEEP_PARAMS]; // number of values of each parameter
+   int seeds; // number of runs of each combination, run i uses seed firstSeed + i
+   uint64_t firstSeed;
+   Engine_Type engine;
+   int deadLockProne; // deadLockProne, deadLockRecovery and priorityInheritance of every run
+   int deadLockRecovery;
+   int priorityInheritance;
+   int levels; // number of priority levels of every run
+   int devices; // devices and deviceSpecs of every run
+   DeviceSpec deviceSpecs[MAX_DEVICES];
+   Overhead overhead; // cycle costs of the kernel in every run
+   Workload_Ptr workload; // processes every run starts from, NULL for the built-in random workload
+   const char *snapshot; // snapshot file every run is restored from, NULL to start every run from scratch
+   int threads; // number of threads running simulations
+} Sweep;
+
+typedef Sweep *Sweep_Ptr;
+
+/**
+* creates a sweep of one run with the default parameters and the given seed, using
+* one thread per online host cpu
+*/
+Sweep_Ptr Sweep_constructor(uint64_t firstSeed);
+
+/**
+* frees memory used by the sweep
+*/
+void Sweep_destructor(Sweep_Ptr sweep);
+
+/**
+* sets the values of a parameter from a comma separated list, returns 0 when
+* the list has a value out of range of the parameter, 1 otherwise. Values of
+* Sweep_policy are policy names.
+*/
+int Sweep_setValues(Sweep_Ptr sweep, Sweep_Param param, const char *list);
+
+/**
+* returns number of runs of the sweep, or SWEEP_MAX_RUNS + 1 when it has more than SWEEP_MAX_RUNS
+*/
+int Sweep_runs(Sweep_Ptr sweep);
+
+/**
+* fills config with the parameters of the given run
+*/
+void Sweep_getConfig(Sweep_Ptr sweep, int run, Config_Ptr config);
+
+/**
+* runs all simulations of the sweep and prints a table with the averages of each combination. Runs
+* restored from a snapshot take every parameter they can't change while running from the config
+* they were saved with, so those must be the same in all runs. Returns 1 on success, 0 without
+* printing the table when the sweep has more than SWEEP_MAX_RUNS runs or a run couldn't be
+* restored, which stops the other runs.
+*/
+int Sweep_run(Sweep_Ptr sweep, FILE *out);
+
+#endif
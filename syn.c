@@ -1,32 +1,69 @@
 #include <stdlib.h>
+#include <limits.h>
 #include "pcb.h"
 #include "queue.h"
 #include "syn.h"
 
+/*
+* This returns the producer consumer pair with the given index, creating the chunks up to
+* it when they don't exist yet, but not the buffer of the pair.
+*/
+PCPair_Ptr pcPairAt(SyncRegistry_Ptr registry, int index);
 
 Mutex_Ptr Mutex_constructor() {
     Mutex_Ptr mutex = malloc(sizeof(Mutex));
+    Mutex_init(mutex);
+    return mutex;
+}
+
+void Mutex_init(Mutex_Ptr mutex) {
     mutex->curPCB = NULL;
     mutex->waitingQueue = Queue_constructor();
     mutex->inUse = 0;
-    return mutex;
+    mutex->waiters = NULL;
 }
 
 void Mutex_deconstructor(Mutex_Ptr mutex) {
-   Queue_destructor(mutex->waitingQueue);
+   Mutex_destroy(mutex);
    free(mutex);
 }
 
+void Mutex_destroy(Mutex_Ptr mutex) {
+   Queue_destructor(mutex->waitingQueue);
+}
+
 int Mutex_lock(Mutex_Ptr mutex, PCB_Ptr pcb) {
-   if (mutex->inUse == 1) {
-      PCB_setCurrentState(pcb, Blocked);
-      Queue_enqueue(mutex->waitingQueue, pcb);
-      return 0;
-   } else {
+   PCB_Ptr owner;
+   
+   if (mutex->inUse == 0) {
       mutex->inUse = 1;
       mutex->curPCB = pcb;
-      return 1;
+      return MUTEX_LOCKED;
    }
+   
+   PCB_setCurrentState(pcb, Blocked);
+   Queue_enqueue(mutex->waitingQueue, pcb);
+   pcb->waitingOn = mutex;
+   
+   if (mutex->waiters != NULL) {
+      (*mutex->waiters)++;
+   }
+   
+   // every pcb waits for at most one mutex, so the pcbs reachable from the new edge are
+   // a chain, and a cycle through it has to come back to pcb. A chain that runs into a
+   // cycle found earlier ends there, those pcbs never wait for anything else.
+   for (owner = mutex->curPCB; owner != pcb; owner = owner->waitingOn->curPCB) {
+      if (owner->waitingOn == NULL || owner->deadLocked) {
+         return MUTEX_BLOCKED;
+      }
+   }
+   
+   do {
+      owner->deadLocked = 1;
+      owner = owner->waitingOn->curPCB;
+   } while (owner != pcb);
+   
+   return MUTEX_DEADLOCKED;
 }
 
 PCB_Ptr Mutex_unlock(Mutex_Ptr mutex) {
@@ -36,20 +73,44 @@ PCB_Ptr Mutex_unlock(Mutex_Ptr mutex) {
       mutex->inUse = 0;
    } else {
       mutex->inUse = 1;
+      mutex->curPCB->waitingOn = NULL;
+      
+      if (mutex->waiters != NULL) {
+         (*mutex->waiters)--;
+      }
    }
    
    return mutex->curPCB;
 }
 
+void Mutex_cancel(PCB_Ptr pcb) {
+   Queue_remove(pcb->waitingOn->waitingQueue, pcb);
+   
+   if (pcb->waitingOn->waiters != NULL) {
+      (*pcb->waitingOn->waiters)--;
+   }
+   
+   pcb->waitingOn = NULL;
+}
+
 CondVar_Ptr CondVar_constructor() {
     CondVar_Ptr condVar = malloc(sizeof(CondVar));   
+    CondVar_init(condVar);
+    return condVar;
+}
+
+void CondVar_init(CondVar_Ptr condVar) {
     condVar->head = NULL;
     condVar->tail = NULL;
     condVar->size = 0;
-    return condVar;
 }
 
 void CondVar_deconstructor(CondVar_Ptr condVar) {
+   CondVar_destroy(condVar);
+   free(condVar);
+}
+
+void CondVar_destroy(CondVar_Ptr condVar) {
    CondVarNode_Ptr node;
    
    while (condVar->size) {
@@ -58,8 +119,6 @@ void CondVar_deconstructor(CondVar_Ptr condVar) {
        condVar->size--;
        free(node);
    }
-   
-   free(condVar);
 }
 
 CondVarNode_Ptr CondVarNode_constructor(Mutex_Ptr mutex, PCB_Ptr pcb) {
@@ -86,7 +145,7 @@ void CondVar_wait(CondVar_Ptr condVar, Mutex_Ptr mutex) {
     Mutex_unlock(mutex);
 }
 
-void CondVar_signal(CondVar_Ptr condVar) { 
+int CondVar_signal(CondVar_Ptr condVar) { 
     if (condVar->size > 0) {
         CondVarNode_Ptr node = condVar->head;
         
@@ -101,8 +160,399 @@ void CondVar_signal(CondVar_Ptr condVar) {
         PCB_Ptr pcb = node->thisPCB;
         Mutex_Ptr mutex = node->thisMutex;
         free(node);
-        Mutex_lock(mutex, pcb);
+        return Mutex_lock(mutex, pcb);
+    }
+    
+    return MUTEX_LOCKED;
+}
+
+Semaphore_Ptr Semaphore_constructor(int value) {
+    Semaphore_Ptr semaphore = malloc(sizeof(Semaphore));
+    Semaphore_init(semaphore, value);
+    return semaphore;
+}
+
+void Semaphore_init(Semaphore_Ptr semaphore, int value) {
+    semaphore->value = value;
+    CondVar_init(&semaphore->waiters);
+}
+
+void Semaphore_deconstructor(Semaphore_Ptr semaphore) {
+   Semaphore_destroy(semaphore);
+   free(semaphore);
+}
+
+void Semaphore_destroy(Semaphore_Ptr semaphore) {
+   CondVar_destroy(&semaphore->waiters);
+}
+
+int Semaphore_wait(Semaphore_Ptr semaphore, Mutex_Ptr mutex) {
+    if (semaphore->value > 0) {
+        semaphore->value--;
+        return 1;
+    }
+    
+    CondVar_wait(&semaphore->waiters, mutex);
+    return 0;
+}
+
+int Semaphore_post(Semaphore_Ptr semaphore) {
+    // the unit goes straight to the waiter, so the value stays 0
+    if (semaphore->waiters.size > 0) {
+        return CondVar_signal(&semaphore->waiters);
+    }
+    
+    semaphore->value++;
+    return MUTEX_LOCKED;
+}
+
+SyncRegistry_Ptr SyncRegistry_constructor(int bufferSlots) {
+    SyncRegistry_Ptr registry = malloc(sizeof(SyncRegistry));
+    registry->pcChunks = NULL;
+    registry->mrChunks = NULL;
+    registry->pcChunkCount = 0;
+    registry->mrChunkCount = 0;
+    registry->pcPairs = 0;
+    registry->mrPairs = 0;
+    registry->mutexWaiters = 0;
+    registry->bufferSlots = bufferSlots;
+    registry->deadLocks = NULL;
+    registry->deadLockCount = 0;
+    registry->deadLockCapacity = 0;
+    return registry;
+}
+
+void SyncRegistry_deconstructor(SyncRegistry_Ptr registry) {
+    int i, j;
+    
+    for (i = 0; i < registry->pcChunkCount; i++) {
+        for (j = 0; j < SYNC_CHUNK_PAIRS; j++) {
+            Mutex_destroy(&registry->pcChunks[i][j].mutex);
+            CondVar_destroy(&registry->pcChunks[i][j].readCondVar);
+            CondVar_destroy(&registry->pcChunks[i][j].writeCondVar);
+            Semaphore_destroy(&registry->pcChunks[i][j].freeSlots);
+            Semaphore_destroy(&registry->pcChunks[i][j].items);
+            free(registry->pcChunks[i][j].slots);
+        }
+        
+        free(registry->pcChunks[i]);
+    }
+    
+    for (i = 0; i < registry->mrChunkCount; i++) {
+        for (j = 0; j < SYNC_CHUNK_PAIRS; j++) {
+            Mutex_destroy(&registry->mrChunks[i][j].resources[0]);
+            Mutex_destroy(&registry->mrChunks[i][j].resources[1]);
+        }
+        
+        free(registry->mrChunks[i]);
+    }
+    
+    free(registry->pcChunks);
+    free(registry->mrChunks);
+    for (i = 0; i < registry->deadLockCount; i++) {
+        free(registry->deadLocks[i].PIDs);
+    }
+    
+    free(registry->deadLocks);
+    free(registry);
+}
+
+PCPair_Ptr SyncRegistry_pcPair(SyncRegistry_Ptr registry, int index) {
+    PCPair_Ptr pair = pcPairAt(registry, index);
+    
+    // a chunk holds many pairs that may never be used, so each buffer waits for its pair
+    if (registry->bufferSlots && pair->slots == NULL) {
+        pair->slots = malloc(sizeof(int) * registry->bufferSlots);
+    }
+    
+    return pair;
+}
+
+PCPair_Ptr pcPairAt(SyncRegistry_Ptr registry, int index) {
+    int i, chunks = index / SYNC_CHUNK_PAIRS + 1;
+    PCPair_Ptr pair;
+    
+    if (chunks > registry->pcChunkCount) {
+        registry->pcChunks = realloc(registry->pcChunks, sizeof(PCPair_Ptr) * chunks);
+        
+        for (; registry->pcChunkCount < chunks; registry->pcChunkCount++) {
+            pair = malloc(sizeof(PCPair) * SYNC_CHUNK_PAIRS);
+            registry->pcChunks[registry->pcChunkCount] = pair;
+            
+            for (i = 0; i < SYNC_CHUNK_PAIRS; i++) {
+                Mutex_init(&pair[i].mutex);
+                pair[i].mutex.waiters = &registry->mutexWaiters;
+                CondVar_init(&pair[i].readCondVar);
+                CondVar_init(&pair[i].writeCondVar);
+                pair[i].sharedInt = 0;
+                pair[i].writable = 1;
+                pair[i].slots = NULL;
+                pair[i].head = 0;
+                pair[i].count = 0;
+                Semaphore_init(&pair[i].freeSlots, registry->bufferSlots);
+                Semaphore_init(&pair[i].items, 0);
+                pair[i].consumed = 0;
+                pair[i].producerBlocks = 0;
+                pair[i].consumerBlocks = 0;
+            }
+        }
+    }
+    
+    if (index >= registry->pcPairs) {
+        registry->pcPairs = index + 1;
+    }
+    
+    return &registry->pcChunks[index / SYNC_CHUNK_PAIRS][index % SYNC_CHUNK_PAIRS];
+}
+
+MRPair_Ptr SyncRegistry_mrPair(SyncRegistry_Ptr registry, int index) {
+    int i, chunks = index / SYNC_CHUNK_PAIRS + 1;
+    MRPair_Ptr pair;
+    
+    if (chunks > registry->mrChunkCount) {
+        registry->mrChunks = realloc(registry->mrChunks, sizeof(MRPair_Ptr) * chunks);
+        
+        for (; registry->mrChunkCount < chunks; registry->mrChunkCount++) {
+            pair = malloc(sizeof(MRPair) * SYNC_CHUNK_PAIRS);
+            registry->mrChunks[registry->mrChunkCount] = pair;
+            
+            for (i = 0; i < SYNC_CHUNK_PAIRS; i++) {
+                Mutex_init(&pair[i].resources[0]);
+                Mutex_init(&pair[i].resources[1]);
+                pair[i].resources[0].waiters = &registry->mutexWaiters;
+                pair[i].resources[1].waiters = &registry->mutexWaiters;
+            }
+        }
+    }
+    
+    if (index >= registry->mrPairs) {
+        registry->mrPairs = index + 1;
     }
+    
+    return &registry->mrChunks[index / SYNC_CHUNK_PAIRS][index % SYNC_CHUNK_PAIRS];
 }
 
+void SyncRegistry_noteDeadLock(SyncRegistry_Ptr registry, PCB_Ptr pcb, uint64_t time) {
+    DeadLock_Ptr deadLock;
+    PCB_Ptr member = pcb;
+    int length = 0;
+    
+    if (registry->deadLockCount == registry->deadLockCapacity) {
+        registry->deadLockCapacity = registry->deadLockCapacity ? 2 * registry->deadLockCapacity : 16;
+        registry->deadLocks = realloc(registry->deadLocks, sizeof(DeadLock) * registry->deadLockCapacity);
+    }
+    
+    do {
+        length++;
+        member = member->waitingOn->curPCB;
+    } while (member != pcb);
+    
+    deadLock = &registry->deadLocks[registry->deadLockCount++];
+    deadLock->PIDs = malloc(sizeof(int) * length);
+    deadLock->length = length;
+    deadLock->time = time;
+    
+    for (length = 0; length < deadLock->length; length++) {
+        deadLock->PIDs[length] = PCB_getProcessID(member);
+        member = member->waitingOn->curPCB;
+    }
+}
 
+void SyncRegistry_bufferTotals(SyncRegistry_Ptr registry, uint64_t *consumed, uint64_t *producerBlocks,
+    uint64_t *consumerBlocks) {
+    PCPair_Ptr pair;
+    int i;
+    
+    *consumed = 0;
+    *producerBlocks = 0;
+    *consumerBlocks = 0;
+    
+    for (i = 0; i < registry->pcPairs; i++) {
+        pair = &registry->pcChunks[i / SYNC_CHUNK_PAIRS][i % SYNC_CHUNK_PAIRS];
+        *consumed += pair->consumed;
+        *producerBlocks += pair->producerBlocks;
+        *consumerBlocks += pair->consumerBlocks;
+    }
+}
+
+void Mutex_save(Mutex_Ptr mutex, Snapshot_Ptr snapshot) {
+    Snapshot_writePCB(snapshot, mutex->curPCB);
+    Snapshot_write(snapshot, &mutex->inUse, sizeof(mutex->inUse));
+    Queue_save(mutex->waitingQueue, snapshot);
+}
+
+void Mutex_restore(Mutex_Ptr mutex, Snapshot_Ptr snapshot) {
+    int i;
+    mutex->curPCB = Snapshot_readPCB(snapshot);
+    Snapshot_read(snapshot, &mutex->inUse, sizeof(mutex->inUse));
+    Queue_restore(mutex->waitingQueue, snapshot);
+    
+    // the waiting queue holds exactly the pcbs whose edge in the wait-for graph ends here
+    for (i = 0; i < Queue_size(mutex->waitingQueue); i++) {
+        Queue_at(mutex->waitingQueue, i)->waitingOn = mutex;
+    }
+    
+    if (mutex->waiters != NULL) {
+        *mutex->waiters += Queue_size(mutex->waitingQueue);
+    }
+}
+
+void CondVar_save(CondVar_Ptr condVar, Snapshot_Ptr snapshot) {
+    CondVarNode_Ptr node;
+    Snapshot_write(snapshot, &condVar->size, sizeof(condVar->size));
+    
+    for (node = condVar->head; node != NULL; node = node->next) {
+        Snapshot_writePCB(snapshot, node->thisPCB);
+    }
+}
+
+void CondVar_restore(CondVar_Ptr condVar, Mutex_Ptr mutex, Snapshot_Ptr snapshot) {
+    CondVarNode_Ptr node;
+    unsigned int size, i;
+    Snapshot_read(snapshot, &size, sizeof(size));
+    
+    for (i = 0; i < size && !snapshot->failed; i++) {
+        node = CondVarNode_constructor(mutex, Snapshot_readPCB(snapshot));
+        
+        if (condVar->size == 0) {
+            condVar->head = node;
+        } else {
+            condVar->tail->next = node;
+        }
+        
+        condVar->tail = node;
+        condVar->size++;
+    }
+}
+
+void Semaphore_save(Semaphore_Ptr semaphore, Snapshot_Ptr snapshot) {
+    Snapshot_write(snapshot, &semaphore->value, sizeof(semaphore->value));
+    CondVar_save(&semaphore->waiters, snapshot);
+}
+
+void Semaphore_restore(Semaphore_Ptr semaphore, Mutex_Ptr mutex, Snapshot_Ptr snapshot) {
+    Snapshot_read(snapshot, &semaphore->value, sizeof(semaphore->value));
+    CondVar_restore(&semaphore->waiters, mutex, snapshot);
+}
+
+void SyncRegistry_save(SyncRegistry_Ptr registry, Snapshot_Ptr snapshot) {
+    PCPair_Ptr pair;
+    MRPair_Ptr resources;
+    DeadLock_Ptr deadLock;
+    int i, hasSlots;
+    
+    Snapshot_write(snapshot, &registry->pcPairs, sizeof(registry->pcPairs));
+    Snapshot_write(snapshot, &registry->mrPairs, sizeof(registry->mrPairs));
+    Snapshot_write(snapshot, &registry->deadLockCount, sizeof(registry->deadLockCount));
+    
+    for (i = 0; i < registry->pcPairs; i++) {
+        pair = pcPairAt(registry, i);
+        hasSlots = pair->slots != NULL;
+        Mutex_save(&pair->mutex, snapshot);
+        CondVar_save(&pair->readCondVar, snapshot);
+        CondVar_save(&pair->writeCondVar, snapshot);
+        Snapshot_write(snapshot, &pair->sharedInt, sizeof(pair->sharedInt));
+        Snapshot_write(snapshot, &pair->writable, sizeof(pair->writable));
+        Snapshot_write(snapshot, &hasSlots, sizeof(hasSlots));
+        
+        if (hasSlots) {
+            Snapshot_write(snapshot, pair->slots, sizeof(int) * registry->bufferSlots);
+        }
+        
+        Snapshot_write(snapshot, &pair->head, sizeof(pair->head));
+        Snapshot_write(snapshot, &pair->count, sizeof(pair->count));
+        Semaphore_save(&pair->freeSlots, snapshot);
+        Semaphore_save(&pair->items, snapshot);
+        Snapshot_write(snapshot, &pair->consumed, sizeof(pair->consumed));
+        Snapshot_write(snapshot, &pair->producerBlocks, sizeof(pair->producerBlocks));
+        Snapshot_write(snapshot, &pair->consumerBlocks, sizeof(pair->consumerBlocks));
+    }
+    
+    for (i = 0; i < registry->mrPairs; i++) {
+        resources = SyncRegistry_mrPair(registry, i);
+        Mutex_save(&resources->resources[0], snapshot);
+        Mutex_save(&resources->resources[1], snapshot);
+    }
+    
+    for (i = 0; i < registry->deadLockCount; i++) {
+        deadLock = &registry->deadLocks[i];
+        Snapshot_write(snapshot, &deadLock->length, sizeof(deadLock->length));
+        Snapshot_write(snapshot, &deadLock->time, sizeof(deadLock->time));
+        Snapshot_write(snapshot, deadLock->PIDs, sizeof(int) * deadLock->length);
+    }
+}
+
+void SyncRegistry_restore(SyncRegistry_Ptr registry, Snapshot_Ptr snapshot) {
+    PCPair_Ptr pair;
+    MRPair_Ptr resources;
+    DeadLock_Ptr deadLock;
+    int i, pcPairs, mrPairs, deadLocks, hasSlots;
+    
+    Snapshot_read(snapshot, &pcPairs, sizeof(pcPairs));
+    Snapshot_read(snapshot, &mrPairs, sizeof(mrPairs));
+    Snapshot_read(snapshot, &deadLocks, sizeof(deadLocks));
+    
+    if (pcPairs < 0 || pcPairs > INT_MAX - SYNC_CHUNK_PAIRS || mrPairs < 0 || mrPairs > INT_MAX - SYNC_CHUNK_PAIRS
+        || deadLocks < 0) {
+        Snapshot_fail(snapshot);
+        return;
+    }
+    
+    // pairs are created one by one, so a snapshot cut short never allocates more than it holds
+    for (i = 0; i < pcPairs && !snapshot->failed; i++) {
+        pair = pcPairAt(registry, i);
+        Mutex_restore(&pair->mutex, snapshot);
+        CondVar_restore(&pair->readCondVar, &pair->mutex, snapshot);
+        CondVar_restore(&pair->writeCondVar, &pair->mutex, snapshot);
+        Snapshot_read(snapshot, &pair->sharedInt, sizeof(pair->sharedInt));
+        Snapshot_read(snapshot, &pair->writable, sizeof(pair->writable));
+        Snapshot_read(snapshot, &hasSlots, sizeof(hasSlots));
+        
+        // only pairs used before the snapshot had buffers
+        if (hasSlots && registry->bufferSlots) {
+            pair = SyncRegistry_pcPair(registry, i);
+            Snapshot_read(snapshot, pair->slots, sizeof(int) * registry->bufferSlots);
+        } else if (hasSlots) {
+            Snapshot_fail(snapshot);
+        }
+        
+        Snapshot_read(snapshot, &pair->head, sizeof(pair->head));
+        Snapshot_read(snapshot, &pair->count, sizeof(pair->count));
+        Semaphore_restore(&pair->freeSlots, &pair->mutex, snapshot);
+        Semaphore_restore(&pair->items, &pair->mutex, snapshot);
+        Snapshot_read(snapshot, &pair->consumed, sizeof(pair->consumed));
+        Snapshot_read(snapshot, &pair->producerBlocks, sizeof(pair->producerBlocks));
+        Snapshot_read(snapshot, &pair->consumerBlocks, sizeof(pair->consumerBlocks));
+        
+        if (pair->head < 0 || pair->head >= (registry->bufferSlots ? registry->bufferSlots : 1) || pair->count < 0
+            || pair->count > registry->bufferSlots) {
+            Snapshot_fail(snapshot);
+        }
+    }
+    
+    for (i = 0; i < mrPairs && !snapshot->failed; i++) {
+        resources = SyncRegistry_mrPair(registry, i);
+        Mutex_restore(&resources->resources[0], snapshot);
+        Mutex_restore(&resources->resources[1], snapshot);
+    }
+    
+    for (i = 0; i < deadLocks && !snapshot->failed; i++) {
+        if (registry->deadLockCount == registry->deadLockCapacity) {
+            registry->deadLockCapacity = registry->deadLockCapacity ? 2 * registry->deadLockCapacity : 16;
+            registry->deadLocks = realloc(registry->deadLocks, sizeof(DeadLock) * registry->deadLockCapacity);
+        }
+        
+        deadLock = &registry->deadLocks[registry->deadLockCount];
+        Snapshot_read(snapshot, &deadLock->length, sizeof(deadLock->length));
+        Snapshot_read(snapshot, &deadLock->time, sizeof(deadLock->time));
+        
+        if (deadLock->length < 1 || deadLock->length > Snapshot_pcbCount(snapshot)) {
+            Snapshot_fail(snapshot);
+            break;
+        }
+        
+        deadLock->PIDs = malloc(sizeof(int) * deadLock->length);
+        Snapshot_read(snapshot, deadLock->PIDs, sizeof(int) * deadLock->length);
+        registry->deadLockCount++;
+    }
+}
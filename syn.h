@@ -18,13 +18,21 @@
 #include "pcb.h"
 #include "queue.h"
 
+#define SYNC_CHUNK_PAIRS 256 // number of pairs allocated at once by a SyncRegistry
+#define SYNC_MAX_SLOTS 4096 // max number of slots of the buffer of a producer consumer pair
+#define MUTEX_BLOCKED 0 // Mutex_lock() put the pcb into the waiting queue
+#define MUTEX_LOCKED 1 // Mutex_lock() gave the mutex to the pcb
+#define MUTEX_DEADLOCKED -1 // Mutex_lock() put the pcb into the waiting queue, which closed a cycle of waiting pcbs
+
 /*
-* This struct defines a Mutex type
+* This struct defines a Mutex type. The owners of all mutexes and the waitingOn field
+* of blocked pcbs form the wait-for graph, in which a pcb points to the pcb it waits for.
 */
-typedef struct {
+typedef struct mutex {
     PCB_Ptr curPCB;
     Queue_Ptr waitingQueue;
     int inUse; // 1 is in use, 0 is not
+    int *waiters; // counter of the pcbs waiting on a group of mutexes this one belongs to, NULL when it isn't counted
 } Mutex;
 
 /*
@@ -57,6 +65,83 @@ typedef struct {
 */
 typedef CondVar *CondVar_Ptr;
 
+/*
+* This struct defines a counting Semaphore type used inside a monitor: a PCB that
+* has to wait gives up the mutex it holds, and takes it again when it is woken.
+*/
+typedef struct {
+    int value; // number of units left
+    CondVar waiters; // PCBs waiting for a unit, with the mutexes they gave up
+} Semaphore;
+
+/*
+* This defines a Semaphore type
+*/
+typedef Semaphore *Semaphore_Ptr;
+
+/*
+* This defines the synchronization objects shared by a producer consumer pair. Without
+* slots the producer and the consumer take turns on one shared integer, with slots the
+* producer runs ahead of the consumer until every slot is full.
+*/
+typedef struct {
+    Mutex mutex;
+    CondVar readCondVar; // signaled by the producer, waited on by the consumer
+    CondVar writeCondVar; // signaled by the consumer, waited on by the producer
+    int sharedInt; // the shared space the producer writes and the consumer reads
+    int writable; // 1 means the shared integer can be written, 0 means it can be read
+    int *slots; // ring buffer of items produced but not consumed yet, NULL without slots or before the pair is used
+    int head; // slot of the oldest item
+    int count; // number of items in the buffer
+    Semaphore freeSlots; // waited on by the producer, posted by the consumer
+    Semaphore items; // waited on by the consumer, posted by the producer
+    uint64_t consumed; // number of items the consumer read
+    int producerBlocks; // number of times the producer waited for the consumer
+    int consumerBlocks; // number of times the consumer waited for the producer
+} PCPair;
+
+typedef PCPair *PCPair_Ptr;
+
+/*
+* This defines the synchronization objects shared by a mutual resource user pair
+*/
+typedef struct {
+    Mutex resources[2];
+} MRPair;
+
+typedef MRPair *MRPair_Ptr;
+
+/*
+* This defines a cycle of the wait-for graph
+*/
+typedef struct {
+    int *PIDs; // PIDs of the pcbs in the cycle, starting with the one whose lock closed it
+    int length;
+    uint64_t time; // system time the cycle was closed
+} DeadLock;
+
+typedef DeadLock *DeadLock_Ptr;
+
+/*
+* This defines a registry of all pairs of a simulation, indexed by pair id / 2. Pairs are
+* stored in chunks that never move, so pointers to their mutexes stay valid as it grows.
+*/
+typedef struct {
+    PCPair_Ptr *pcChunks;
+    MRPair_Ptr *mrChunks;
+    int pcChunkCount;
+    int mrChunkCount;
+    int pcPairs; // number of producer consumer pairs, one more than the highest index used
+    int bufferSlots; // number of slots of the buffer of each producer consumer pair, 0 for one shared integer
+    int mrPairs; // number of mutual resource pairs, one more than the highest index used
+    int mutexWaiters; // number of pcbs in the waiting queues of the mutexes of all pairs
+    DeadLock_Ptr deadLocks; // all cycles found, in the order they were closed
+    int deadLockCount;
+    int deadLockCapacity;
+} SyncRegistry;
+
+typedef SyncRegistry *SyncRegistry_Ptr;
+
 /*
 * This Constructs a Mutex object, and returns a pointer to it.
 */
@@ -67,6 +152,16 @@ Mutex_Ptr Mutex_constructor();
 */
 void Mutex_deconstructor(Mutex_Ptr mutex);
 
+/*
+* This initializes a Mutex stored inside another object, its waiters are not counted.
+*/
+void Mutex_init(Mutex_Ptr mutex);
+
+/*
+* This frees the memory used by a Mutex initialized with Mutex_init().
+*/
+void Mutex_destroy(Mutex_Ptr mutex);
+
 /*
 * This Constructs a Condition Variable object, and returns a pointer to it.
 */
@@ -77,6 +172,16 @@ CondVar_Ptr CondVar_constructor();
 */
 void CondVar_deconstructor(CondVar_Ptr condVar);
 
+/*
+* This initializes a Condition Variable stored inside another object.
+*/
+void CondVar_init(CondVar_Ptr condVar);
+
+/*
+* This frees the memory used by a Condition Variable initialized with CondVar_init().
+*/
+void CondVar_destroy(CondVar_Ptr condVar);
+
 /*
 * This frees the Mutex Lock and puts the PCB into this Condition Variable's 
 * waiting queue to be signaled later.
@@ -84,24 +189,150 @@ void CondVar_deconstructor(CondVar_Ptr condVar);
 void CondVar_wait(CondVar_Ptr condVar, Mutex_Ptr mutexLock);
 
 /*
-* This removes the PCB at the head of this Condition Variable's waiting queue.
+* This removes the PCB at the head of this Condition Variable's waiting queue,
+* which locks its mutex again. It returns what Mutex_lock() returned for that PCB,
+* or MUTEX_LOCKED when the waiting queue is empty.
+*/
+int CondVar_signal(CondVar_Ptr condVar);
+
+
+/*
+* This Constructs a Semaphore object with the given number of units, and returns a pointer to it.
+*/
+Semaphore_Ptr Semaphore_constructor(int value);
+
+/*
+* This destroys a Semaphore object and frees the memory it was using.
+*/
+void Semaphore_deconstructor(Semaphore_Ptr semaphore);
+
+/*
+* This initializes a Semaphore stored inside another object with the given number of units.
+*/
+void Semaphore_init(Semaphore_Ptr semaphore, int value);
+
+/*
+* This frees the memory used by a Semaphore initialized with Semaphore_init().
 */
-void CondVar_signal(CondVar_Ptr condVar);
+void Semaphore_destroy(Semaphore_Ptr semaphore);
 
+/*
+* This takes a unit of the semaphore for the PCB holding the Mutex Lock and returns 1.
+* When no unit is left, it frees the Mutex Lock, puts the PCB into the semaphore's
+* waiting queue as CondVar_wait() does, and returns 0.
+*/
+int Semaphore_wait(Semaphore_Ptr semaphore, Mutex_Ptr mutexLock);
+
+/*
+* This gives a unit back to the semaphore. When a PCB waits for one, the unit goes to
+* the PCB at the head of the waiting queue, which locks its mutex again, and what
+* Mutex_lock() returned for it is returned. Otherwise it returns MUTEX_LOCKED.
+*/
+int Semaphore_post(Semaphore_Ptr semaphore);
 
 /*
 * This puts a lock on the mutex and sets the inUse variable to 1.
 * If the mutex is already in use, the PCB will be sent to the mutex's
-* waiting queue. 
+* waiting queue, and the chain of owners it now waits for is followed to
+* find out whether the new edge closed a cycle. Returns MUTEX_LOCKED,
+* MUTEX_BLOCKED or MUTEX_DEADLOCKED, in which case every PCB of the cycle
+* is marked deadLocked.
 */
 int Mutex_lock(Mutex_Ptr mutex, PCB_Ptr pcb);
 
 
 /*
 * This removes the PCB at the head of this Mutex's waiting queue.
-* That PCB then becomes the current user of this Mutex, and the PCB
-* is returned.
+* That PCB then becomes the current user of this Mutex and stops waiting,
+* and the PCB is returned.
 */
 PCB_Ptr Mutex_unlock(Mutex_Ptr mutex);
 
+/*
+* This takes the PCB out of the waiting queue of the mutex it is blocked on, so it
+* stops waiting without getting the mutex.
+*/
+void Mutex_cancel(PCB_Ptr pcb);
+
+/*
+* This Constructs an empty Sync Registry whose producer consumer pairs have buffers
+* of the given number of slots, and returns a pointer to it.
+*/
+SyncRegistry_Ptr SyncRegistry_constructor(int bufferSlots);
+
+/*
+* This destroys a Sync Registry with all its pairs.
+*/
+void SyncRegistry_deconstructor(SyncRegistry_Ptr registry);
+
+/*
+* This returns the producer consumer pair with the given index, creating it
+* and the pairs before it when they don't exist yet. The buffer of a pair is
+* only allocated the first time the pair itself is returned.
+*/
+PCPair_Ptr SyncRegistry_pcPair(SyncRegistry_Ptr registry, int index);
+
+/*
+* This returns the mutual resource pair with the given index, creating it
+* and the pairs before it when they don't exist yet.
+*/
+MRPair_Ptr SyncRegistry_mrPair(SyncRegistry_Ptr registry, int index);
+
+/*
+* This adds up the items consumed and the times producers and consumers waited
+* over all producer consumer pairs.
+*/
+void SyncRegistry_bufferTotals(SyncRegistry_Ptr registry, uint64_t *consumed, uint64_t *producerBlocks,
+    uint64_t *consumerBlocks);
+
+/*
+* This records the cycle that the PCB closed when Mutex_lock() returned MUTEX_DEADLOCKED
+* for it at the given system time.
+*/
+void SyncRegistry_noteDeadLock(SyncRegistry_Ptr registry, PCB_Ptr pcb, uint64_t time);
+
+/*
+* This writes the owner and the waiting queue of the mutex to the snapshot.
+*/
+void Mutex_save(Mutex_Ptr mutex, Snapshot_Ptr snapshot);
+
+/*
+* This reads what Mutex_save() wrote into a mutex initialized with Mutex_init(),
+* the PCBs in its waiting queue wait on it again.
+*/
+void Mutex_restore(Mutex_Ptr mutex, Snapshot_Ptr snapshot);
+
+/*
+* This writes the PCBs waiting on the Condition Variable to the snapshot.
+*/
+void CondVar_save(CondVar_Ptr condVar, Snapshot_Ptr snapshot);
+
+/*
+* This reads what CondVar_save() wrote into an empty Condition Variable, every
+* PCB in it gave up the given Mutex Lock.
+*/
+void CondVar_restore(CondVar_Ptr condVar, Mutex_Ptr mutexLock, Snapshot_Ptr snapshot);
+
+/*
+* This writes the units and the waiting PCBs of the semaphore to the snapshot.
+*/
+void Semaphore_save(Semaphore_Ptr semaphore, Snapshot_Ptr snapshot);
+
+/*
+* This reads what Semaphore_save() wrote into a semaphore without waiting PCBs,
+* every PCB in it gave up the given Mutex Lock.
+*/
+void Semaphore_restore(Semaphore_Ptr semaphore, Mutex_Ptr mutexLock, Snapshot_Ptr snapshot);
+
+/*
+* This writes all pairs and the cycles found so far to the snapshot.
+*/
+void SyncRegistry_save(SyncRegistry_Ptr registry, Snapshot_Ptr snapshot);
+
+/*
+* This reads what SyncRegistry_save() wrote into an empty Sync Registry with the same
+* number of buffer slots.
+*/
+void SyncRegistry_restore(SyncRegistry_Ptr registry, Snapshot_Ptr snapshot);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include "pcb.h"
+#include "trace.h"
+
+// verbosity level needed by each event, in Trace_Event order
+const Trace_Level levels[] = {Trace_process, Trace_process, Trace_interrupt, Trace_interrupt, Trace_interrupt,
+   Trace_sync, Trace_sync, Trace_sync, Trace_sync, Trace_sync, Trace_sync, Trace_sync, Trace_sync, Trace_sync,
+   Trace_sync, Trace_sync, Trace_sync};
+
+/**
+* This is the writer thread, it drains the buffer until the trace is closing and empty
+*/
+void *writer(void *arg);
+
+/**
+* This adds a record to the buffer, waiting for the writer when the buffer is full
+*/
+void push(Trace_Ptr trace, const TraceRecord *record);
+
+Trace_Ptr Trace_constructor(FILE *out, int binary, Trace_Level level, int cpus) {
+   Trace_Ptr trace = malloc(sizeof(Trace));
+   atomic_init(&trace->head, 0);
+   atomic_init(&trace->tail, 0);
+   atomic_init(&trace->closing, 0);
+   trace->level = level;
+   trace->binary = binary;
+   trace->out = out;
+   trace->cpus = cpus;
+   trace->cpu = 0;
+   pthread_mutex_init(&trace->lock, NULL);
+   pthread_cond_init(&trace->notEmpty, NULL);
+   pthread_cond_init(&trace->notFull, NULL);
+   
+   if (binary) {
+      TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord), cpus};
+      fwrite(&header, sizeof(TraceHeader), 1, out);
+   }
+   
+   pthread_create(&trace->writer, NULL, writer, trace);
+   return trace;
+}
+
+void Trace_destructor(Trace_Ptr trace) {
+   pthread_mutex_lock(&trace->lock);
+   atomic_store(&trace->closing, 1);
+   pthread_cond_signal(&trace->notEmpty);
+   pthread_mutex_unlock(&trace->lock);
+   pthread_join(trace->writer, NULL);
+   fflush(trace->out);
+   
+   pthread_mutex_destroy(&trace->lock);
+   pthread_cond_destroy(&trace->notEmpty);
+   pthread_cond_destroy(&trace->notFull);
+   free(trace);
+}
+
+void push(Trace_Ptr trace, const TraceRecord *record) {
+   unsigned int head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+   
+   if (head - atomic_load_explicit(&trace->tail, memory_order_acquire) == TRACE_BUFFER_SIZE) {
+      pthread_mutex_lock(&trace->lock);
+      
+      while (head - atomic_load_explicit(&trace->tail, memory_order_acquire) == TRACE_BUFFER_SIZE) {
+         pthread_cond_signal(&trace->notEmpty);
+         pthread_cond_wait(&trace->notFull, &trace->lock);
+      }
+      
+      pthread_mutex_unlock(&trace->lock);
+   }
+   
+   trace->buffer[head & (TRACE_BUFFER_SIZE - 1)] = *record;
+   atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+void Trace_setCPU(Trace_Ptr trace, int cpu) {
+   if (trace == NULL) return;
+   
+   trace->cpu = cpu;
+}
+
+void Trace_log(Trace_Ptr trace, Trace_Event event, uint64_t time, int flag, int a, int b, int c) {
+   if (trace == NULL || trace->level < levels[event]) return;
+   
+   TraceRecord record = {time, event, flag, 0, trace->cpu, {a, b, c, 0, 0, 0}, 0};
+   push(trace, &record);
+}
+
+void Trace_logPCB(Trace_Ptr trace, uint64_t time, PCB_Ptr pcb) {
+   if (trace == NULL || trace->level < levels[Process_created]) return;
+   
+   TraceRecord record = {time, Process_created, pcb->type, pcb->curState, trace->cpu,
+      {pcb->PID, pcb->curPriority, pcb->pc, pcb->sw, pcb->terminate, 0}, 0};
+   push(trace, &record);
+}
+
+void *writer(void *arg) {
+   Trace_Ptr trace = arg;
+   char line[TRACE_LINE_LEN];
+   unsigned int head, tail = 0;
+   struct timespec deadline;
+   
+   while (1) {
+      pthread_mutex_lock(&trace->lock);
+      
+      // sleep until records arrive, the buffer fills up, or it is time to flush
+      while (tail == atomic_load_explicit(&trace->head, memory_order_acquire) && !atomic_load(&trace->closing)) {
+         clock_gettime(CLOCK_REALTIME, &deadline);
+         deadline.tv_nsec += TRACE_FLUSH_MS * 1000000L;
+         
+         if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+         }
+         
+         pthread_cond_timedwait(&trace->notEmpty, &trace->lock, &deadline);
+      }
+      
+      pthread_mutex_unlock(&trace->lock);
+      head = atomic_load_explicit(&trace->head, memory_order_acquire);
+      
+      if (tail == head) {
+         break; // closing and nothing left
+      }
+      
+      while (tail != head) {
+         const TraceRecord *record = &trace->buffer[tail & (TRACE_BUFFER_SIZE - 1)];
+         
+         if (trace->binary) {
+            fwrite(record, sizeof(TraceRecord), 1, trace->out);
+         } else {
+            fwrite(line, 1, Trace_format(record, trace->cpus > 1, line), trace->out);
+         }
+         
+         tail++;
+      }
+      
+      pthread_mutex_lock(&trace->lock);
+      atomic_store_explicit(&trace->tail, tail, memory_order_release);
+      pthread_cond_signal(&trace->notFull);
+      pthread_mutex_unlock(&trace->lock);
+   }
+   
+   return NULL;
+}
+
+int Trace_format(const TraceRecord *record, int showCPU, char *line) {
+   const int *args = record->args;
+   const char *mutexKind = record->flag ? "mutual resource" : "producer consumer";
+   const char *condKind = record->flag ? "cond_read" : "cond_write";
+   int prefix = showCPU ? snprintf(line, TRACE_LINE_LEN, "CPU %d: ", record->cpu) : 0;
+   int size = TRACE_LINE_LEN - prefix;
+   int length;
+   
+   line += prefix;
+   
+   switch (record->event) {
+   case Process_created:
+      length = snprintf(line, size, "Process created: PID %d at system time %" PRIu64 "\n PID: %d, Priority: %d, State: %s, PC: %d, SW: %d, Terminatate: %d, Type: %s\n",
+         args[0], record->time, args[0], args[1], PCB_stateNames[record->state], args[2], args[3], args[4], PCB_typeNames[record->flag]);
+      break;
+   case Process_terminated:
+      length = snprintf(line, size, "Process terminated: PID %d at system time %" PRIu64 "\n", args[0], record->time);
+      break;
+   case Timer_event:
+      length = snprintf(line, size, "Timer interrupt: PID %d was running, PID %d dispatched\n", args[0], args[1]);
+      break;
+   case IO_completion_event:
+      length = snprintf(line, size, "I/O completion interrupt: I/O device %d, PID %d is running, PID %d put in ready queue\n",
+         args[0], args[1], args[2]);
+      break;
+   case IO_trap_event:
+      length = snprintf(line, size, "I/O trap request: I/O device %d, PID %d put into waiting queue, PID %d dispatched\n",
+         args[0], args[1], args[2]);
+      break;
+   case Lock_event:
+      if (args[2] < 0) {
+         length = snprintf(line, size, "PID %d: requested lock on %s mutex %d - succeeded\n", args[0], mutexKind, args[1]);
+      } else {
+         length = snprintf(line, size, "PID %d: requested lock on %s mutex %d - blocked by PID %d\n", args[0], mutexKind, args[1], args[2]);
+      }
+      
+      break;
+   case Unlock_event:
+      length = snprintf(line, size, "PID %d: requested unlock on %s mutex %d\n", args[0], mutexKind, args[1]);
+      break;
+   case Wait_event:
+      length = snprintf(line, size, "PID %d requested condition wait on %s %d with mutex %d\n", args[0], condKind, args[1], args[1]);
+      break;
+   case Signal_event:
+      length = snprintf(line, size, "PID %d sent signal on %s %d\n", args[0], condKind, args[1]);
+      break;
+   case Produce_event:
+      length = snprintf(line, size, "Producer of pair %d wrote %d to the share space %d\n", args[0], args[1], args[0]);
+      break;
+   case Consume_event:
+      length = snprintf(line, size, "Consumer of pair %d read %d from the share space %d\n", args[0], args[1], args[0]);
+      break;
+   case Resources_used_event:
+      length = snprintf(line, size, "both resources of mutual resource user pair %d are used\n", args[0]);
+      break;
+   case Deadlock_event:
+      length = snprintf(line, size, "PID %d: waiting for %s mutex %d closed a deadlock of %d processes\n", args[0], mutexKind, args[1], args[2]);
+      break;
+   case Recovery_event:
+      length = snprintf(line, size, "PID %d: chosen as deadlock victim, released its mutexes and rolled back %d cycles\n", args[0], args[1]);
+      break;
+   case Inherit_event:
+      length = snprintf(line, size, "PID %d: inherited priority %d from PID %d waiting for its mutex\n", args[0], args[1], args[2]);
+      break;
+   case Buffer_wait_event:
+      length = snprintf(line, size, "PID %d: buffer of pair %d is %s, waiting for %s\n", args[0], args[1],
+         record->flag ? "empty" : "full", record->flag ? "an item" : "a free slot");
+      break;
+   case Buffer_post_event:
+      length = snprintf(line, size, "PID %d posted %s to the buffer of pair %d\n", args[0],
+         record->flag ? "an item" : "a free slot", args[1]);
+      break;
+   default:
+      length = snprintf(line, size, "unknown event %d at system time %" PRIu64 "\n", record->event, record->time);
+      break;
+   }   
+   // snprintf() returns the length the line would have had without truncation
+   return prefix + (length < size ? length : size - 1);
+}
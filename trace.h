@@ -0,0 +1,125 @@
+/**
+* trace.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for the event trace implementation.
+* Events are stored as fixed-size records in a ring buffer, and a writer thread drains
+* them to a file either as binary records or as the lines the simulator used to print.
+*
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "pcb.h"
+
+#define TRACE_BUFFER_SIZE 8192 // number of records in the ring buffer, a power of 2
+#define TRACE_LINE_LEN 200 // number of chars a formatted record can take
+#define TRACE_MAGIC 0x52545353 // "SSTR", first 4 bytes of a binary trace file
+#define TRACE_VERSION 4
+#define TRACE_FLUSH_MS 50 // the writer drains the buffer at least this often
+
+// This defines verbosity levels, each level also includes events of the levels before it
+typedef enum {Trace_off, Trace_process, Trace_interrupt, Trace_sync} Trace_Level;
+
+// This defines events that can be traced
+typedef enum {Process_created, Process_terminated, Timer_event, IO_completion_event, IO_trap_event,
+   Lock_event, Unlock_event, Wait_event, Signal_event, Produce_event, Consume_event, Resources_used_event,
+   Deadlock_event, Recovery_event, Inherit_event, Buffer_wait_event, Buffer_post_event} Trace_Event;
+
+// This defines a trace record, what args hold depends on the event
+typedef struct {
+   uint64_t time; // system time of the event
+   uint8_t event; // a Trace_Event value
+   uint8_t flag; // 1 for mutual resource mutexes and cond_read, type of the pcb for Process_created
+   uint8_t state; // state of the pcb for Process_created
+   uint8_t cpu; // cpu the event happened on
+   int32_t args[6];
+   uint32_t pad; // always 0, so records hold no stray padding bytes
+} TraceRecord;
+
+// This defines the header at the start of a binary trace file
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t recordSize;
+   uint32_t cpus; // number of simulated cpus
+} TraceHeader;
+
+// This defines a trace of one simulation run
+typedef struct {
+   TraceRecord buffer[TRACE_BUFFER_SIZE];
+   atomic_uint head; // index of the next record the simulation writes
+   atomic_uint tail; // index of the next record the writer drains
+   atomic_int closing; // set when no record will be added anymore
+   Trace_Level level; // events above this level are dropped
+   int binary; // 1 writes binary records, 0 writes formatted lines
+   int cpus; // number of simulated cpus, lines show the cpu only when there are more than 1
+   int cpu; // cpu the next records are tagged with
+   FILE *out;
+   pthread_t writer;
+   pthread_mutex_t lock;
+   pthread_cond_t notEmpty;
+   pthread_cond_t notFull;
+} Trace;
+
+typedef Trace *Trace_Ptr;
+
+// Tracing can be removed at compile time with -DNO_TRACE, sizeof keeps the args
+// counted as used without evaluating them
+#ifdef NO_TRACE
+#define TRACE_LOG(trace, event, time, flag, a, b, c) ((void) sizeof((flag) + (a) + (b) + (c)))
+#define TRACE_LOG_PCB(trace, time, pcb) ((void) sizeof(pcb))
+#else
+#define TRACE_LOG(trace, event, time, flag, a, b, c) Trace_log(trace, event, time, flag, a, b, c)
+#define TRACE_LOG_PCB(trace, time, pcb) Trace_logPCB(trace, time, pcb)
+#endif
+
+/**
+* creates a trace writing to the given file and starts its writer thread. binary selects
+* binary records instead of formatted lines, level is the verbosity, cpus is the number
+* of simulated cpus.
+*/
+Trace_Ptr Trace_constructor(FILE *out, int binary, Trace_Level level, int cpus);
+
+/**
+* drains all records left in the buffer, stops the writer thread and frees the trace.
+* The file is flushed but not closed.
+*/
+void Trace_destructor(Trace_Ptr trace);
+
+/**
+* tags the records added after this call with the given cpu
+*/
+void Trace_setCPU(Trace_Ptr trace, int cpu);
+
+/**
+* adds a record for the event if the level of the trace includes it, a NULL trace drops
+* every record
+*/
+void Trace_log(Trace_Ptr trace, Trace_Event event, uint64_t time, int flag, int a, int b, int c);
+
+/**
+* adds a Process_created record holding the fields PCB_toString() shows
+*/
+void Trace_logPCB(Trace_Ptr trace, uint64_t time, PCB_Ptr pcb);
+
+/**
+* writes the line the simulator prints for the record into line, which holds
+* TRACE_LINE_LEN chars, and returns length of the line. showCPU prefixes the
+* line with the cpu of the record.
+*/
+int Trace_format(const TraceRecord *record, int showCPU, char *line);
+
+#endif
@@ -0,0 +1,52 @@
+/**
+* trace_decode.c
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This tool prints a binary trace file written by the simulator with -t
+* as the lines the simulator prints to stdout.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "trace.h"
+
+int main(int argc, char *argv[]) {
+    TraceHeader header;
+    TraceRecord record;
+    char line[TRACE_LINE_LEN];
+    FILE *in;
+    
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s trace_file\n", argv[0]);
+        return 1;
+    }
+    
+    in = fopen(argv[1], "rb");
+    
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    
+    if (fread(&header, sizeof(TraceHeader), 1, in) != 1 || header.magic != TRACE_MAGIC
+        || header.version != TRACE_VERSION || header.recordSize != sizeof(TraceRecord)) {
+        fprintf(stderr, "%s: not a trace file of this version\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+    
+    while (fread(&record, sizeof(TraceRecord), 1, in) == 1) {
+        fwrite(line, 1, Trace_format(&record, header.cpus > 1, line), stdout);
+    }
+    
+    fclose(in);
+    return 0;
+}
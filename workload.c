@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "workload.h"
+
+/**
+* This returns 1 if pc is a pc a process can reach or -1 for no trap, 0 otherwise
+*/
+int isTrapPC(int pc);
+
+/**
+* This returns 1 if the pc lies between one of the lock and unlock pairs of the record,
+* where the process holds the mutex that a wait or signal needs
+*/
+int isLockedPC(const WorkloadRecord *record, int pc);
+
+Workload_Ptr Workload_constructor(const char *path) {
+   int fd = open(path, O_RDONLY);
+   const WorkloadHeader *header;
+   Workload_Ptr workload;
+   struct stat info;
+   void *map;
+
+   if (fd < 0 || fstat(fd, &info) < 0) {
+      perror(path);
+
+      if (fd >= 0) {
+         close(fd);
+      }
+
+      return NULL;
+   }
+
+   if ((size_t) info.st_size < sizeof(WorkloadHeader)) {
+      fprintf(stderr, "%s: not a workload file\n", path);
+      close(fd);
+      return NULL;
+   }
+
+   map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (map == MAP_FAILED) {
+      perror(path);
+      return NULL;
+   }
+
+   header = map;
+
+   // the traps take up all of the file after the records
+   if (header->magic != WORKLOAD_MAGIC || header->version != WORKLOAD_VERSION
+      || header->recordSize != sizeof(WorkloadRecord) || header->trapSize != sizeof(IoTrap)
+      || header->count > (info.st_size - sizeof(WorkloadHeader)) / sizeof(WorkloadRecord)
+      || header->trapCount > (info.st_size - sizeof(WorkloadHeader)) / sizeof(IoTrap)
+      || (size_t) info.st_size != sizeof(WorkloadHeader) + header->count * sizeof(WorkloadRecord) + header->trapCount * sizeof(IoTrap)) {
+      fprintf(stderr, "%s: not a workload file of this version\n", path);
+      munmap(map, info.st_size);
+      return NULL;
+   }
+
+   // records are read front to back, once
+   madvise(map, info.st_size, MADV_SEQUENTIAL);
+
+   workload = malloc(sizeof(Workload));
+   workload->records = (const WorkloadRecord *) (header + 1);
+   workload->count = header->count;
+   workload->traps = (const IoTrap *) (workload->records + header->count);
+   workload->trapCount = header->trapCount;
+   workload->map = map;
+   workload->length = info.st_size;
+   return workload;
+}
+
+void Workload_destructor(Workload_Ptr workload) {
+   munmap(workload->map, workload->length);
+   free(workload);
+}
+
+int isTrapPC(int pc) {
+   return pc == -1 || (pc > 0 && pc < MAX_PC);
+}
+
+int isLockedPC(const WorkloadRecord *record, int pc) {
+   int i;
+
+   for (i = 0; i < 2; i++) {
+      if (record->lock[i] != -1 && record->lock[i] < pc && pc < record->unlock[i]) {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+const IoTrap *Workload_traps(Workload_Ptr workload, const WorkloadRecord *record) {
+   if (record->ioFirst > workload->trapCount || record->ioCount > workload->trapCount - record->ioFirst) {
+      return NULL;
+   }
+
+   return workload->traps + record->ioFirst;
+}
+
+int Workload_isValid(const WorkloadRecord *record, const IoTrap *traps, int levels) {
+   int i, synchronized = record->type == ProducerConsumer || record->type == MutualResource;
+
+   if (record->type > MutualResource || record->priority >= levels) {
+      return 0;
+   }
+
+   // pair ids must fit the sync object registry of a simulation
+   if (synchronized && (record->pairID < 0 || record->pairID >= 2 * WORKLOAD_PAIRS)) {
+      return 0;
+   }
+
+   // every lock needs an unlock after it, mutual resource users lock both resources
+   for (i = 0; i < 2; i++) {
+      if (!isTrapPC(record->lock[i]) || !isTrapPC(record->unlock[i])
+         || (record->lock[i] == -1) != (record->unlock[i] == -1)
+         || (record->lock[i] != -1 && record->lock[i] >= record->unlock[i])
+         || (record->type == MutualResource && record->lock[i] == -1)) {
+         return 0;
+      }
+   }
+
+   if (traps == NULL) {
+      return 0;
+   }
+
+   for (i = 0; i < record->ioCount; i++) {
+      if (!isTrapPC(traps[i].pc) || traps[i].device >= MAX_DEVICES) {
+         return 0;
+      }
+   }
+
+   // wait and signal need the mutex of the pair held
+   if ((record->wait != -1 && (record->type != ProducerConsumer || !isLockedPC(record, record->wait)))
+      || (record->signal != -1 && (record->type != ProducerConsumer || !isLockedPC(record, record->signal)))) {
+      return 0;
+   }
+
+   return isTrapPC(record->wait) && isTrapPC(record->signal);
+}
+
+int Workload_devices(const WorkloadRecord *record, const IoTrap *traps) {
+   int i, devices = 0;
+
+   if (record->flags & WORKLOAD_RANDOM_IO) {
+      return 0;
+   }
+
+   for (i = 0; i < record->ioCount; i++) {
+      if (traps[i].pc != -1 && traps[i].device >= devices) {
+         devices = traps[i].device + 1;
+      }
+   }
+
+   return devices;
+}
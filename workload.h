@@ -0,0 +1,100 @@
+/**
+* workload.h
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This header file defines the class and methods for the workload file implementation.
+* A workload file holds one fixed-size record per process, sorted by arrival time, followed
+* by the list of io traps the records point into. The file is mapped into memory, so a
+* simulation only touches the records and traps it has reached.
+*
+*/
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+#include <stddef.h>
+#include <stdint.h>
+#include "pcb.h"
+
+#define WORKLOAD_MAGIC 0x4C575353 // "SSWL", first 4 bytes of a workload file
+#define WORKLOAD_VERSION 4
+#define WORKLOAD_RANDOM_IO 1 // record flag, io trap pcs are drawn like those of the built-in workload
+#define WORKLOAD_PAIRS (1 << 20) // max number of producer consumer pairs and of mutual resource pairs
+
+// This defines the description of one process
+typedef struct {
+   uint32_t arrival; // system time the process is put into the new queue
+   uint8_t type; // a PCB_Type value
+   uint8_t priority;
+   uint8_t flags;
+   uint8_t pad0;
+   int32_t pairID; // pair id of ProducerConsumer and MutualResource processes, -1 for others
+   uint16_t terminate; // number of times the pc wraps around before termination, 0 for never
+   int16_t lock[2]; // pcs of sync points, -1 when there is none
+   int16_t unlock[2];
+   int16_t wait;
+   int16_t signal;
+   uint16_t ioCount; // number of io traps of the process
+   uint32_t pad;
+   uint64_t ioFirst; // index of the first io trap of the process in the trap list of the file
+} WorkloadRecord;
+
+// This defines the header at the start of a workload file
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t recordSize;
+   uint32_t trapSize;
+   uint64_t count; // number of records after the header
+   uint64_t trapCount; // number of io traps after the records
+} WorkloadHeader;
+
+// This defines a workload type, one mapping can be shared by any number of simulations
+typedef struct {
+   const WorkloadRecord *records;
+   uint64_t count;
+   const IoTrap *traps;
+   uint64_t trapCount;
+   void *map; // start of the mapping, which begins with the header
+   size_t length; // length of the mapping
+} Workload;
+
+typedef Workload *Workload_Ptr;
+
+/**
+* maps the workload file at the given path and returns pointer of the workload, or NULL
+* with a message on stderr when the file can't be mapped or isn't a workload file
+*/
+Workload_Ptr Workload_constructor(const char *path);
+
+/**
+* unmaps the workload file and frees the workload
+*/
+void Workload_destructor(Workload_Ptr workload);
+
+/**
+* returns the io traps of the described process, or NULL when they aren't all in the trap
+* list of the workload
+*/
+const IoTrap *Workload_traps(Workload_Ptr workload, const WorkloadRecord *record);
+
+/**
+* returns 1 if a simulation with the given number of priority levels can run the described
+* process, whose io traps are traps, 0 otherwise
+*/
+int Workload_isValid(const WorkloadRecord *record, const IoTrap *traps, int levels);
+
+/**
+* returns number of devices a simulation needs to run the described process, which is one
+* more than the highest device its io traps need, or 0 when its io traps are drawn at random
+*/
+int Workload_devices(const WorkloadRecord *record, const IoTrap *traps);
+
+#endif
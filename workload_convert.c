@@ -0,0 +1,278 @@
+/**
+* workload_convert.c
+*
+* Programming Team:
+* Collin Alligood
+* Levi Bingham
+* Qing Bai
+* Sally Budack
+*
+* Date: 02/10/16
+*
+* Description:
+* This tool converts a text workload description into the binary workload file the
+* simulator maps with -w. Every line that isn't empty or a # comment describes one process:
+*
+*    arrival type priority terminate [pair=id] [lock=pc,pc] [unlock=pc,pc] [wait=pc]
+*       [signal=pc] [io1=pc,...] [io2=pc,...] ... [io16=pc,...]
+*
+* type is IO, Compute, ProducerConsumer or MutualResource. Lines must be ordered by arrival.
+* ioN lists the pcs of traps that need I/O device N, a process can have up to 65535 io traps.
+* When no ioN is given the io traps are drawn at random like those of the built-in workload.
+* The io traps of all processes are kept in memory and written after the records.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "priority_queue.h"
+#include "workload.h"
+
+#define LINE_LEN (1 << 20) // max number of chars in a line of the text file
+
+// This defines the io traps of all processes read so far
+typedef struct {
+    IoTrap *traps;
+    uint64_t count;
+    uint64_t capacity;
+} TrapList;
+
+/**
+* This sets length pcs in values to -1, which means no trap
+*/
+void clearPCs(int16_t *values, int length);
+
+/**
+* This parses a comma separated list of at most length pcs into values,
+* unused values are set to -1. Returns 0 when the list isn't valid.
+*/
+int parsePCs(const char *list, int16_t *values, int length);
+
+/**
+* This parses a comma separated list of pcs of traps that need the given device and adds
+* them to the io traps of record at the end of the list. Returns 0 when the list isn't
+* valid or there are too many traps.
+*/
+int parseIOPCs(const char *pcs, WorkloadRecord *record, TrapList *list, int device);
+
+/**
+* This parses one line into record, whose io traps are added to the end of the list.
+* Returns 0 when the line isn't valid.
+*/
+int parseRecord(char *line, WorkloadRecord *record, TrapList *traps);
+
+void clearPCs(int16_t *values, int length) {
+    int i;
+
+    for (i = 0; i < length; i++) {
+        values[i] = -1;
+    }
+}
+
+int parsePCs(const char *list, int16_t *values, int length) {
+    int i;
+    char *end;
+    clearPCs(values, length);
+
+    for (i = 0; i < length; i++) {
+        long pc = strtol(list, &end, 10);
+
+        if (end == list || pc <= 0 || pc >= MAX_PC) {
+            return 0;
+        }
+
+        values[i] = pc;
+
+        if (*end != ',') {
+            return *end == '\0';
+        }
+
+        list = end + 1;
+    }
+
+    return 0;
+}
+
+int parseIOPCs(const char *pcs, WorkloadRecord *record, TrapList *list, int device) {
+    char *end;
+    long pc;
+
+    while (1) {
+        pc = strtol(pcs, &end, 10);
+
+        if (end == pcs || pc <= 0 || pc >= MAX_PC || record->ioCount == MAX_IO_TRAPS) {
+            return 0;
+        }
+
+        if (list->count == list->capacity) {
+            list->capacity *= 2;
+            list->traps = realloc(list->traps, sizeof(IoTrap) * list->capacity);
+        }
+
+        list->traps[list->count].pc = pc;
+        list->traps[list->count].device = device;
+        list->traps[list->count].pad = 0;
+        list->count++;
+        record->ioCount++;
+
+        if (*end != ',') {
+            return *end == '\0';
+        }
+
+        pcs = end + 1;
+    }
+}
+
+int parseRecord(char *line, WorkloadRecord *record, TrapList *traps) {
+    char type[32], *token, *end;
+    unsigned int arrival, priority, terminate;
+    int i, offset, hasIO = 0;
+    long device;
+
+    if (sscanf(line, "%u %31s %u %u %n", &arrival, type, &priority, &terminate, &offset) != 4
+        || priority > 255 || terminate > 65535) {
+        return 0;
+    }
+
+    memset(record, 0, sizeof(WorkloadRecord));
+    record->arrival = arrival;
+    record->type = 255;
+    record->priority = priority;
+    record->terminate = terminate;
+    record->pairID = -1;
+    clearPCs(record->lock, 2);
+    clearPCs(record->unlock, 2);
+    clearPCs(&record->wait, 1);
+    clearPCs(&record->signal, 1);
+    record->ioFirst = traps->count;
+
+    for (i = 0; i <= MutualResource; i++) {
+        if (strcmp(type, PCB_typeNames[i]) == 0) {
+            record->type = i;
+        }
+    }
+
+    for (token = strtok(line + offset, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n")) {
+        char *value = strchr(token, '=');
+        int valid = 0;
+
+        if (value == NULL) {
+            return 0;
+        }
+
+        *value++ = '\0';
+
+        if (strcmp(token, "pair") == 0) {
+            char *end;
+            long pairID = strtol(value, &end, 10);
+            record->pairID = pairID;
+            valid = end != value && *end == '\0' && pairID >= 0 && pairID < 2 * WORKLOAD_PAIRS;
+        } else if (strcmp(token, "lock") == 0) {
+            valid = parsePCs(value, record->lock, 2);
+        } else if (strcmp(token, "unlock") == 0) {
+            valid = parsePCs(value, record->unlock, 2);
+        } else if (strcmp(token, "wait") == 0) {
+            valid = parsePCs(value, &record->wait, 1);
+        } else if (strcmp(token, "signal") == 0) {
+            valid = parsePCs(value, &record->signal, 1);
+        } else if (strncmp(token, "io", 2) == 0) {
+            device = strtol(token + 2, &end, 10);
+            valid = end != token + 2 && *end == '\0' && device >= 1 && device <= MAX_DEVICES
+                && parseIOPCs(value, record, traps, device - 1);
+            hasIO = 1;
+        }
+
+        if (!valid) {
+            return 0;
+        }
+    }
+
+    if (!hasIO) {
+        record->flags |= WORKLOAD_RANDOM_IO;
+    }
+
+    return Workload_isValid(record, traps->traps + record->ioFirst, MAX_PRIORITY_LEVELS);
+}
+
+int main(int argc, char *argv[]) {
+    WorkloadHeader header = {WORKLOAD_MAGIC, WORKLOAD_VERSION, sizeof(WorkloadRecord), sizeof(IoTrap), 0, 0};
+    WorkloadRecord record;
+    TrapList traps;
+    static char line[LINE_LEN];
+    char *start;
+    const char *error;
+    unsigned int lineNum = 0, lastArrival = 0;
+    FILE *in, *out;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s text_file workload_file\n", argv[0]);
+        return 1;
+    }
+
+    in = fopen(argv[1], "r");
+
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    out = fopen(argv[2], "wb");
+
+    if (out == NULL) {
+        perror(argv[2]);
+        fclose(in);
+        return 1;
+    }
+
+    // the counts are filled in once all records are written
+    fwrite(&header, sizeof(WorkloadHeader), 1, out);
+    traps.capacity = 1024;
+    traps.count = 0;
+    traps.traps = malloc(sizeof(IoTrap) * traps.capacity);
+
+    while (fgets(line, LINE_LEN, in) != NULL) {
+        lineNum++;
+        start = line + strspn(line, " \t");
+
+        if (*start == '#' || *start == '\n' || *start == '\r' || *start == '\0') {
+            continue;
+        }
+
+        if (strchr(start, '\n') == NULL && !feof(in)) {
+            error = "line too long";
+        } else if (!parseRecord(start, &record, &traps)) {
+            error = "not a valid process";
+        } else if (record.arrival < lastArrival) {
+            error = "process arrives before the one on the line above";
+        } else {
+            error = NULL;
+        }
+
+        if (error != NULL) {
+            fprintf(stderr, "%s:%u: %s\n", argv[1], lineNum, error);
+            fclose(in);
+            fclose(out);
+            free(traps.traps);
+            return 1;
+        }
+
+        lastArrival = record.arrival;
+        fwrite(&record, sizeof(WorkloadRecord), 1, out);
+        header.count++;
+    }
+
+    fwrite(traps.traps, sizeof(IoTrap), traps.count, out);
+    header.trapCount = traps.count;
+    fseek(out, 0, SEEK_SET);
+    fwrite(&header, sizeof(WorkloadHeader), 1, out);
+    fclose(in);
+    free(traps.traps);
+
+    if (fclose(out) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    printf("%llu processes written to %s\n", (unsigned long long) header.count, argv[2]);
+    return 0;
+}